@@ -4,243 +4,1679 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 #include "calculator.h"
+#include "kernels.h"
+#include "threadpool.h"
+#include "multigrid.h"
+#include "conjugate.h"
+#include "mixed.h"
+#include "measures.h"
+#include "warmstart.h"
+#include "heat_eqn.h"
 
-typedef enum Neighbours
+/**
+ * The state of a calculation: what it was given, its buffers & the state of
+ * its passes. Every function of a calculation gets it, so calculations on
+ * different threads don't share anything.
+ */
+typedef struct
+{
+    int isCyclic;
+    size_t rows;
+    size_t columns;
+    source_point *sources;
+    size_t numOfSources;
+    heat_grid *grid;
+    heat_grid *current; // the grid holding the latest pass (grid or scratch)
+    heat_grid scratch; // the second buffer of the Jacobi sweep
+    stencil_kernel kernel;
+    solver_options options;
+    thread_pool *pool; // runs the rows of the Jacobi & red-black passes
+    compensated_sum *rowSums; // the sum of every row after the latest pass
+    update_norms *rowNorms; // the norms of the latest pass's update of every row
+    double *oldRows; // a row per thread: the row before the pass, for measuring the update
+    bool trackSum; // the current pass sums its rows
+    bool trackNorms; // the current pass measures its update
+    size_t *sourceRowStart; // row r's sources are sourceColumns[sourceRowStart[r] .. sourceRowStart[r + 1])
+    size_t *sourceColumns;
+    bool isMultigrid; // the run is solved by multigrid cycles
+    multigrid multigrid;
+    bool isConjugateGradient; // the run starts by a conjugate gradient solve
+    conjugate_gradient conjugateGradient;
+    bool isMixedPrecision; // the run starts by a mixed precision refinement
+    mixed_precision mixedPrecision;
+    row_kernel colorKernel; // the kernel of the current red-black half pass
+    size_t color; // of the current red-black half pass
+    heat_grid *next; // the grid the current Jacobi pass writes
+    bool isRateKnown; // the passes relax by gaussSeidelRate (estimated or given)
+    double gaussSeidelRate; // the error reduction of a plain in-place pass: Jacobi's spectral radius ^ 2
+    unsigned int relaxedHalfPasses; // the red-black half passes of the Chebyshev sequence so far
+    double relaxation; // the factor of the latest (half) pass
+    bool isAdapting; // the passes measure their update to (re-)estimate the rate
+    unsigned int estimatePasses; // the passes since the latest estimate
+    double lastUpdate; // the l2 norm of the latest pass's update
+    double lastEstimate; // the rate estimated from it
+    bool isTrackingTiles; // the passes skip the tiles which can't change
+    unsigned char *tileChanges; // two flags per tile: changedBefore & changedNow
+    unsigned char *changedBefore; // the tiles which changed in the previous pass
+    unsigned char *changedNow; // the tiles which changed in the current pass (so far)
+} calculation;
+
+/**
+ * The latest calculation of a solver, whose buffers are kept for the next one.
+ */
+struct heat_solver
+{
+    calculation calc;
+    bool hasBuffers;
+};
+
+/**
+ * Frees the source index.
+ */
+void freeSourceIndex(calculation *calc)
+{
+    free(calc->sourceRowStart);
+    free(calc->sourceColumns);
+    calc->sourceRowStart = NULL;
+    calc->sourceColumns = NULL;
+}
+
+/**
+ * Checks weather the source is inside the block of rows x columns cells whose
+ * first cell is (firstRow, firstColumn).
+ * @param source
+ * @param firstRow
+ * @param firstColumn
+ * @param rows
+ * @param columns
+ * @return true if is, false otherwise.
+ */
+static bool isSourceInBlock(const source_point *source, const size_t firstRow, const size_t firstColumn,
+                            const size_t rows, const size_t columns)
+{
+    return source->x >= 0 && source->y >= 0 &&
+           (size_t) source->x >= firstRow && (size_t) source->x - firstRow < rows &&
+           (size_t) source->y >= firstColumn && (size_t) source->y - firstColumn < columns;
+}
+
+/**
+ * qsort comparator of two columns.
+ */
+int compareColumns(const void *first, const void *second)
+{
+    size_t a = *(const size_t *) first;
+    size_t b = *(const size_t *) second;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Sums the row r of 'grid' into calc->rowSums[r]. The passes call it right after
+ * they finish a row, while it is still in cache, so the sum doesn't cost
+ * another read of the grid.
+ * @param grid
+ * @param r
+ */
+void sumRow(calculation *calc, const heat_grid *grid, const size_t r)
+{
+    calc->rowSums[r] = sumCells(heatGridRow(grid, r), calc->columns);
+}
+
+/**
+ * Combines the row sums of the latest pass, in the order of the rows (so the
+ * result doesn't depend on the threads which summed them).
+ * @return the sum of the matrix.
+ */
+double rowSumsTotal(calculation *calc)
+{
+    return totalOfRowSums(calc->rowSums, calc->rows);
+}
+
+/**
+ * Adds the changes of the columns [from, to) of the row r from 'old' to
+ * 'updated' into calc->rowNorms[r].
+ * @param updated the row after (a part of) the pass
+ * @param old the row before it
+ * @param r
+ * @param from the first column
+ * @param to one past the last column
+ */
+void measureCells(calculation *calc, const double *updated, const double *old, const size_t r,
+                  const size_t from, const size_t to)
+{
+    measureChanges(&calc->rowNorms[r], updated, old, from, to);
+}
+
+/**
+ * Adds the changes of the row r from 'old' to 'updated' into calc->rowNorms[r].
+ * @param updated the row after (a part of) the pass
+ * @param old the row before it
+ * @param r
+ */
+void measureRow(calculation *calc, const double *updated, const double *old, const size_t r)
+{
+    measureCells(calc, updated, old, r, 0, calc->columns);
+}
+
+/**
+ * Measures the row r of 'grid', which the current pass has just finished:
+ * its sum and/or its update from 'old', as the pass tracks.
+ * @param grid
+ * @param r
+ * @param old the row before the pass (unused unless the norms are tracked)
+ */
+void finishRow(calculation *calc, const heat_grid *grid, const size_t r, const double *old)
+{
+    if (calc->trackSum)
+    {
+        sumRow(calc, grid, r);
+    }
+    if (calc->trackNorms)
+    {
+        measureRow(calc, heatGridRow(grid, r), old, r);
+    }
+}
+
+/**
+ * Returns the thread's buffer for keeping a row before its update.
+ * @param thread
+ */
+double *oldRow(calculation *calc, const unsigned int thread)
 {
-    RIGHT,
-    LEFT,
-    UP,
-    BOTTOM
-} Neighbour;
+    return calc->oldRows + (size_t) thread * calc->columns;
+}
 
-int gIs_cyclic;
-size_t gRows;
-size_t gColumns;
-source_point *gSources;
-size_t gNumOfSources;
-double **gGrid;
+/**
+ * Combines the row norms of the latest pass, in the order of the rows.
+ * @return the norms of the whole pass (l2 still squared).
+ */
+update_norms rowNormsTotal(calculation *calc)
+{
+    return totalOfRowNorms(calc->rowNorms, calc->rows);
+}
 
 /**
- * calculates the sum of the matrix grid.
+ * calculates the sum of the matrix grid (the passes sum it on the fly;
+ * this is for the grid before the first one).
  * @param grid - the matrix
- * @param y - num of rows
- * @param x - num of columns
  * @param sum output parameter contains the sum.
  */
-void heatSum(double *sum)
+void heatSum(calculation *calc, const heat_grid *grid, double *sum)
 {
-    *sum = 0;
-    for (size_t row = 0; row < gRows; ++row)                                     ////int instead of size_t
+    for (size_t row = 0; row < calc->rows; ++row)
     {
-        for (size_t col = 0; col < gColumns; ++col)                              ////////int instead of size_t
-        {
-            (*sum) += gGrid[row][col];
-        }
+        sumRow(calc, grid, row);
     }
+    *sum = rowSumsTotal(calc);
 }
 
 /**
- * Checls weather the coordinate (x,y) is one of the sources.
- * @param row
- * @param col
- * @return true if is, false otherwise.
+ * Builds the source index of a block: counting sort by row (count, prefix-sum,
+ * then scatter), then every row's columns are sorted & their duplicates dropped.
+ * @return true on success, false (with nothing allocated) if the index could not be allocated.
  */
-bool isSource(const size_t row, const size_t col)
+bool indexSources(const source_point *sources, const size_t num_sources, const size_t first_row,
+                  const size_t first_column, const size_t rows, const size_t columns,
+                  size_t **row_start, size_t **source_columns)
 {
-    for (size_t i = 0; i < gNumOfSources; ++i)                              ////////int instead of size_t
+    size_t *rowStart = calloc(rows + 1, sizeof(size_t));
+    size_t *sourceColumns = malloc((num_sources + 1) * sizeof(size_t));
+    if (rowStart == NULL || sourceColumns == NULL)
+    {
+        free(rowStart);
+        free(sourceColumns);
+        return false;
+    }
+
+    for (size_t i = 0; i < num_sources; ++i)
     {
-        if (gSources[i].x == (int)row && gSources[i].y == (int)col)        ////////casting to int has been added
+        if (isSourceInBlock(&sources[i], first_row, first_column, rows, columns))
         {
-            return true;
+            rowStart[sources[i].x - first_row + 1]++;
+        }
+    }
+    for (size_t r = 0; r < rows; ++r)
+    {
+        rowStart[r + 1] += rowStart[r];
+    }
+    for (size_t i = 0; i < num_sources; ++i)
+    {
+        if (isSourceInBlock(&sources[i], first_row, first_column, rows, columns))
+        {
+            sourceColumns[rowStart[sources[i].x - first_row]++] = (size_t) sources[i].y - first_column;
         }
     }
 
-    return false;
+    // The scatter advanced every start to the next row's start; shift them back,
+    // sorting each row's columns & dropping duplicate sources on the way.
+    size_t from = 0, to = 0;
+    for (size_t r = 0; r < rows; ++r)
+    {
+        size_t end = rowStart[r];
+        rowStart[r] = to;
+        qsort(sourceColumns + from, end - from, sizeof(size_t), compareColumns);
+        for (size_t i = from; i < end; ++i)
+        {
+            if (to == rowStart[r] || sourceColumns[to - 1] != sourceColumns[i])
+            {
+                sourceColumns[to++] = sourceColumns[i];
+            }
+        }
+        from = end;
+    }
+    rowStart[rows] = to;
+
+    *row_start = rowStart;
+    *source_columns = sourceColumns;
+    return true;
 }
 
 /**
- * A custom mod operation uses the floor value instead of rounding to zero.
- * @param numerator is what we has to calculate
- * @param n a filed of the mod we has to calculate as a non-negative number
- * @return MOD(x,N) - the reminder of the division of x / N.
+ * Copies the row 'from' into the halo row 'to' (both without their halo cells).
  */
-size_t mod(const int denominator, const int numerator)
+void copyToHaloRow(calculation *calc, heat_grid *grid, const size_t from, const ptrdiff_t to)
 {
-    return (size_t) (((numerator % denominator) + denominator) % denominator);
+    memcpy(heatGridRow(grid, to), heatGridRow(grid, from), calc->columns * sizeof(double));
 }
 
 /**
- * checks weather the coordinate (col, row) is out of the grid's matrix.
- * @param row
- * @param col
- * @return true if is, false otherwise.
+ * activates the kernel 'kernel' on the cells [from, to) of the row r,
+ * skipping the row's (sorted) sources: reads the row r of 'cells' and its
+ * neighbouring rows, and writes the row r of 'next' (which is 'cells' itself
+ * for an in-place pass).
+ * @param kernel
+ * @param cells the grid to read
+ * @param next the grid to write
+ * @param r the row
+ * @param from the first column
+ * @param to one past the last column
  */
-bool indexOutOfMatrix(const size_t row, const size_t col)
+void activateRow(calculation *calc, const row_kernel kernel, const heat_grid *cells, heat_grid *next,
+                 const size_t r, size_t from, const size_t to)
 {
-    const size_t START_MATRIX_INDEX = 0;
-    return (col < START_MATRIX_INDEX) || (row < START_MATRIX_INDEX) || (col >= gColumns) || (row >= gRows);
+    double *out = heatGridRow(next, r);
+    const double *in = heatGridRow(cells, r);
+    const double *up = heatGridRow(cells, r + 1);
+    const double *down = heatGridRow(cells, (ptrdiff_t) r - 1);
+
+    for (size_t i = calc->sourceRowStart[r]; i < calc->sourceRowStart[r + 1] && from < to; ++i)
+    {
+        size_t source = calc->sourceColumns[i];
+        if (source >= from)
+        {
+            kernel(out, in, up, down, from, source < to ? source : to, &calc->kernel.params);
+            from = source + 1;
+        }
+    }
+    kernel(out, in, up, down, from, to, &calc->kernel.params);
 }
 
+/**
+ * Returns the optimal SOR factor for in-place passes of the rate 'rate'.
+ * @param rate
+ */
+double optimalRelaxation(const double rate)
+{
+    return 2 / (1 + sqrt(1 - rate));
+}
 
 /**
- * Returns the value of the required member.
+ * Returns the rate of plain in-place heat_eqn passes on the grid, ignoring the
+ * sources: the squared spectral radius of Jacobi's, whose slowest mode is a
+ * half wave along each side (between the 0 boundaries, or along the whole
+ * cycle - which the sources pin).
  */
-double getNeighbourValue(size_t row, size_t col, const enum Neighbours neighbour)
+double gridRate(calculation *calc)
 {
-    const int VALUE_FOR_OUT_OF_MATRIX = 0;
+    const double PI = 3.14159265358979323846;
 
-    if (neighbour == RIGHT)
+    double rowWaves = (double) calc->rows + (calc->isCyclic ? 0 : 1);
+    double columnWaves = (double) calc->columns + (calc->isCyclic ? 0 : 1);
+    double radius = (cos(PI / rowWaves) + cos(PI / columnWaves)) / 2;
+    return radius * radius;
+}
+
+/**
+ * Returns the rate which the SOR factor 'omega' is optimal for (0 for a factor
+ * which doesn't over-relax).
+ * @param omega
+ */
+double rateOfRelaxation(const double omega)
+{
+    if (omega <= NO_RELAXATION)
     {
-        col++;
+        return 0;
     }
-    if (neighbour == LEFT)
+
+    double root = 2 / omega - 1;
+    return 1 - root * root;
+}
+
+/**
+ * Starts the relaxation of the run: the rate is known unless it's adapted
+ * (which falls back to the grid's).
+ */
+void startRelaxation(calculation *calc)
+{
+    calc->relaxedHalfPasses = 0;
+    calc->relaxation = NO_RELAXATION;
+    calc->estimatePasses = 0;
+    calc->lastUpdate = 0;
+    calc->lastEstimate = 0;
+    calc->isAdapting = calc->options.omega == OMEGA_ADAPTIVE;
+    calc->isRateKnown = !calc->isAdapting;
+    calc->gaussSeidelRate = (calc->options.omega > OMEGA_FROM_GRID) ? rateOfRelaxation(calc->options.omega) : gridRate(calc);
+}
+
+/**
+ * checks weather the current pass measures its update for adapting the rate.
+ * @return true if it does, otherwise false.
+ */
+bool isAdaptingRate(calculation *calc)
+{
+    return calc->options.relaxation != RELAXATION_NONE && calc->options.order != SWEEP_JACOBI && calc->isAdapting;
+}
+
+/**
+ * Adapts the rate to the l2 norm of a pass's update. The updates of passes
+ * relaxed by omega (1 at first) shrink by a ratio r which settles at the
+ * largest root of (r + omega - 1) ^ 2 = r * omega ^ 2 * rate (as the slowest
+ * mode is left), so once the rate it gives settles it's taken: the passes start
+ * relaxing by the rate's optimal factor, and estimate again. Since a pass which
+ * relaxes less than the optimal factor still leaves a bit of the slowest
+ * mode, the estimates grow towards the true rate; adapting stops at one which
+ * doesn't, or - at first - at MAX_ESTIMATE_PASSES, falling back to the grid's rate.
+ * @param update
+ */
+void estimateRate(calculation *calc, const double update)
+{
+    const unsigned int MIN_ESTIMATE_PASSES = 4;
+    const unsigned int MAX_ESTIMATE_PASSES = 1000;
+    const double SETTLED = 0.01; // of the distance of the rate from 1
+
+    if (calc->lastUpdate > 0 && update > 0)
     {
-        col--;
+        double ratio = update / calc->lastUpdate;
+        double root = ratio + calc->relaxation - 1;
+        double estimate = root * root / (ratio * calc->relaxation * calc->relaxation);
+        bool isSettled = calc->estimatePasses >= MIN_ESTIMATE_PASSES && estimate < 1 &&
+                         fabs(estimate - calc->lastEstimate) < SETTLED * (1 - estimate);
+        if (isSettled && (!calc->isRateKnown || estimate > calc->gaussSeidelRate + SETTLED * (1 - calc->gaussSeidelRate)))
+        {
+            calc->gaussSeidelRate = estimate;
+            calc->isRateKnown = true;
+            calc->estimatePasses = 0;
+        }
+        else if (isSettled || calc->estimatePasses >= MAX_ESTIMATE_PASSES)
+        {
+            calc->isAdapting = false;
+            calc->isRateKnown = true; // with the grid's rate if it's still the first estimate
+        }
+        calc->lastEstimate = estimate;
     }
-    if (neighbour == UP)
+
+    calc->lastUpdate = update;
+    ++calc->estimatePasses;
+}
+
+/**
+ * Returns the relaxation factor of the next in-place pass (or red-black half pass).
+ */
+double nextRelaxation(calculation *calc)
+{
+    if (calc->options.relaxation == RELAXATION_NONE || !calc->isRateKnown)
     {
-        row++;
+        return NO_RELAXATION;
     }
-    if (neighbour == BOTTOM)
+    if (calc->options.relaxation == RELAXATION_SOR && calc->options.omega > OMEGA_FROM_GRID)
     {
-        row--;
+        return calc->options.omega;
     }
-
-    if (gIs_cyclic)
+    if (calc->options.relaxation == RELAXATION_SOR || calc->options.order != SWEEP_RED_BLACK || calc->isAdapting)
     {
-        row = mod((int) gRows, (int) row);
-        col = mod((int) gColumns, (int) col);
+        return optimalRelaxation(calc->gaussSeidelRate); // Chebyshev's factors change too often to adapt by
     }
 
-    if (indexOutOfMatrix(row, col))
+    // Chebyshev: 1, 1 / (1 - rate / 2), then 1 / (1 - rate * previous / 4)
+    double omega = NO_RELAXATION;
+    if (calc->relaxedHalfPasses == 1)
     {
-        return VALUE_FOR_OUT_OF_MATRIX;
+        omega = 1 / (1 - calc->gaussSeidelRate / 2);
     }
-    else
+    else if (calc->relaxedHalfPasses > 1)
     {
-        return gGrid[row][col];
+        omega = 1 / (1 - calc->gaussSeidelRate * calc->relaxation / 4);
     }
+    ++calc->relaxedHalfPasses;
+    return omega;
 }
 
+/**
+ * Returns the kernel of the next in-place (half) pass, setting its relaxation
+ * factor: 'plain', or 'relaxed' if it over-relaxes.
+ * @param plain
+ * @param relaxed
+ */
+row_kernel relaxedKernel(calculation *calc, const row_kernel plain, const row_kernel relaxed)
+{
+    calc->relaxation = nextRelaxation(calc);
+    calc->kernel.params.omega = calc->relaxation;
+    return (calc->relaxation == NO_RELAXATION) ? plain : relaxed;
+}
 
 /**
- * activates the function 'function' on the coordinate (r,c)
- * and calculates the RIGHT, LEFT, TOP, and BOTTOM as well.
- * @param function
+ * activates the red-black kernel on the cells of the colour 'color' (the
+ * parity of row + column) inside the row r, skipping the row's sources.
  * @param r the row
- * @param c the column
+ * @param color RED or BLACK
+ */
+void activateRowColor(calculation *calc, const size_t r, const size_t color)
+{
+    double *cells = heatGridRow(calc->grid, r);
+    const double *up = heatGridRow(calc->grid, r + 1);
+    const double *down = heatGridRow(calc->grid, (ptrdiff_t) r - 1);
+    size_t from = 0;
+
+    for (size_t i = calc->sourceRowStart[r]; i <= calc->sourceRowStart[r + 1]; ++i)
+    {
+        size_t to = (i < calc->sourceRowStart[r + 1]) ? calc->sourceColumns[i] : calc->columns;
+        size_t first = from + ((r + from + color) % 2); // the first cell of the colour
+        calc->colorKernel(cells, cells, up, down, first, to, &calc->kernel.params);
+        from = to + 1;
+    }
+}
+
+/**
+ * The range task of a red-black half pass.
+ * @param from the first row
+ * @param to one past the last row
+ * @param thread the pool's thread
+ * @param context the calculation (whose 'color' is the half pass's)
  */
-void activateFunction(const diff_func function, const size_t r, const size_t c)
+void redBlackRows(const size_t from, const size_t to, const unsigned int thread, void *context)
 {
-    double cell, onRight, onLeft, onTop, onDown;
+    const size_t BLACK = 1;
+
+    calculation *calc = context;
+    double *old = oldRow(calc, thread);
+    for (size_t r = from; r < to; ++r)
+    {
+        if (calc->trackNorms)
+        {
+            memcpy(old, heatGridRow(calc->grid, r), calc->columns * sizeof(double));
+        }
+        activateRowColor(calc, r, calc->color);
+        if (calc->color == BLACK)
+        {
+            finishRow(calc, calc->grid, r, old); // the row is final
+        }
+        else if (calc->trackNorms)
+        {
+            measureRow(calc, heatGridRow(calc->grid, r), old, r);
+        }
+    }
+}
 
-    onRight = getNeighbourValue(r, c, RIGHT);
-    onLeft = getNeighbourValue(r, c, LEFT);
-    onTop = getNeighbourValue(r, c, UP);
-    onDown = getNeighbourValue(r, c, BOTTOM);
-    cell = gGrid[r][c];
+/**
+ * performing the heat activity in red-black order: the red cells, then the
+ * black ones. A cell only reads cells of the other colour (or halo copies),
+ * so the rows of a half pass are independent and run on the pool.
+ */
+void redBlack(calculation *calc)
+{
+    const size_t RED = 0;
+    const size_t BLACK = 1;
 
-    gGrid[r][c] = function(cell, onRight, onTop, onLeft, onDown);
+    for (calc->color = RED; calc->color <= BLACK; ++calc->color)
+    {
+        if (calc->isCyclic)
+        {
+            wrapHeatGridHalo(calc->grid);
+        }
+        calc->colorKernel = relaxedKernel(calc, calc->kernel.redBlack, calc->kernel.sorRedBlack);
+        runParallel(calc->pool, calc->rows, redBlackRows, calc);
+    }
 }
 
 /**
- * performing the heat activity by activates the function
- * 'function' on each one of the matrix.
- * grid-array's cells.
- * @param function.
+ * performing the heat activity by activates the kernel
+ * on each one of the matrix.
+ * grid-array's cells, skipping the sources.
+ *
+ * When cyclic, the halo cells are refreshed from the wrapped-around cells right
+ * before they are read, so every cell sees exactly the values it would see on
+ * the torus: the old value of a wrapped neighbour which is updated after it,
+ * and the new value of one which was already updated in this pass.
  */
-void heat(const diff_func function)
+void heat(calculation *calc)
 {
+    const size_t FIRST = 0;
+    const unsigned int CALLER = 0;
+
+    double *old = oldRow(calc, CALLER);
+    row_kernel kernel = relaxedKernel(calc, calc->kernel.row, calc->kernel.sor);
+    if (calc->isCyclic)
+    {
+        copyToHaloRow(calc, calc->grid, calc->rows - 1, -1);
+        copyToHaloRow(calc, calc->grid, FIRST, (ptrdiff_t) calc->rows);
+    }
 
-    for (size_t r = 0; r < gRows; r++)
+    for (size_t r = 0; r < calc->rows; r++)
     {
-        for (size_t c = 0; c < gColumns; c++)
+        if (calc->trackNorms)
+        {
+            memcpy(old, heatGridRow(calc->grid, r), calc->columns * sizeof(double));
+        }
+
+        if (calc->isCyclic)
         {
-            if (!isSource(r, c))
+            double *cells = heatGridRow(calc->grid, r);
+            cells[-1] = cells[calc->columns - 1];
+            cells[calc->columns] = cells[FIRST];
+            activateRow(calc, kernel, calc->grid, calc->grid, r, FIRST, FIRST + 1);
+            cells[calc->columns] = cells[FIRST];
+            activateRow(calc, kernel, calc->grid, calc->grid, r, FIRST + 1, calc->columns);
+            if (r == FIRST)
             {
-                // activate function on the coordinate (r,c)
-                activateFunction(function, r, c);
+                copyToHaloRow(calc, calc->grid, FIRST, (ptrdiff_t) calc->rows);
             }
         }
+        else
+        {
+            activateRow(calc, kernel, calc->grid, calc->grid, r, FIRST, calc->columns);
+        }
+        finishRow(calc, calc->grid, r, old);
     }
+}
 
+/**
+ * Returns the number of bands of tile rows.
+ */
+size_t tileBands(calculation *calc)
+{
+    return (calc->rows + ACTIVE_TILE_ROWS - 1) / ACTIVE_TILE_ROWS;
 }
 
 /**
- * checks weather we should terminate the
- * loop by iterations or not.
- * @param n_iter
- * @return true if should, otherwise false.
+ * Returns the number of tiles in a band.
  */
-bool isTerminatedByIterations(const int n_iter)
+size_t tilesPerBand(calculation *calc)
 {
-    const int NO_ITERATIONS = 0;
-    return (n_iter > NO_ITERATIONS);
+    return (calc->columns + ACTIVE_TILE_COLUMNS - 1) / ACTIVE_TILE_COLUMNS;
 }
 
 /**
- * Checks weather the precision is good enough
- * by validates the remainder of currSum - prevSum.
- * @param prevSum - the sum of the previous iteration.
- * @param currSum - the sum of the current iteration.
- * @param terminate - the required precision.
- * @return
+ * checks weather the calculation's passes track the active tiles: Gauss-Seidel
+ * or Jacobi passes which aren't over-relaxed, outside of multigrid.
+ * @return true if they do, otherwise false.
  */
-bool isPrecise(const double prevSum, const double currSum, const double terminate)
+bool isTrackingTiles(calculation *calc)
 {
-    return fabs(currSum - prevSum) < terminate;
+    return calc->options.active_tiles && !calc->isMultigrid && calc->options.relaxation == RELAXATION_NONE &&
+           (calc->options.order == SWEEP_GAUSS_SEIDEL || calc->options.order == SWEEP_JACOBI);
 }
 
 /**
- * Calculates the heat and its dissipation according to the source points 'sources',
- *by activating the function 'function' on the matrix grid.
- * @param function the function to activate
- * @param grid the matrix
- * @param n the rows
- * @param m the columns
- * @param sources array of the heat sources points
- * @param num_sources the number of sources
- * @param terminate the 'epsilon' for detecting the required precision
- * @param n_iter num of iterations
- * @param is_cyclic is it should be cyclic
- * @return the heat reminder of the last iteration
+ * Marks every tile changed, so the next pass updates the whole grid (whose
+ * cells the tiles' flags don't tell about: at the start of a calculation).
  */
-double calculate(diff_func function,
-                 double **grid,
-                 size_t n, size_t m, source_point *sources, size_t num_sources,
-                 double terminate, unsigned int n_iter, int is_cyclic)
+void resetTiles(calculation *calc)
 {
-    //............ global variables initialization .......//
-    gIs_cyclic = is_cyclic;
-    gRows = n;
-    gColumns = m;
-    gSources = sources;
-    gNumOfSources = num_sources;
-    gGrid = grid;
+    size_t numOfTiles = tileBands(calc) * tilesPerBand(calc);
+    calc->changedBefore = calc->tileChanges;
+    calc->changedNow = calc->tileChanges + numOfTiles;
+    memset(calc->tileChanges, true, 2 * numOfTiles); // the next pass starts by making 'now' 'before'
+}
 
-    double prevSum;
-    heatSum(&prevSum); // get the heat sum into sum
-    double currSum = prevSum;
-    if (isTerminatedByIterations(n_iter))
+/**
+ * Starts a pass which tracks the tiles: the current pass's changes become the
+ * previous pass's.
+ */
+void startTilePass(calculation *calc)
+{
+    unsigned char *changes = calc->changedBefore;
+    calc->changedBefore = calc->changedNow;
+    calc->changedNow = changes;
+    memset(calc->changedNow, false, tileBands(calc) * tilesPerBand(calc));
+}
+
+/**
+ * checks weather the tile (band, tile) reads a tile which changed since its
+ * neighbour's values it read in its previous update: a tile which the pass
+ * updates before it (the one above & the one to the left in place, none in
+ * Jacobi passes) if it changed in this pass, any other if it changed in the
+ * previous one. In cyclic runs the neighbours wrap around.
+ * @param band
+ * @param tile
+ * @param isInPlace whether the pass is in place (Gauss-Seidel)
+ * @return true if the tile may change, otherwise (its update would give the very same cells) false.
+ */
+bool isTileActive(calculation *calc, const size_t band, const size_t tile, const bool isInPlace)
+{
+    const size_t bands = tileBands(calc);
+    const size_t tiles = tilesPerBand(calc);
+
+    if (calc->changedBefore[band * tiles + tile])
+    {
+        return true;
+    }
+
+    // the neighbours: (band, tile) of the one above, below, to the left & to the right
+    bool hasNeighbour[] = {band > 0 || calc->isCyclic, band + 1 < bands || calc->isCyclic,
+                           tile > 0 || calc->isCyclic, tile + 1 < tiles || calc->isCyclic};
+    size_t neighbourBand[] = {(band + bands - 1) % bands, (band + 1) % bands, band, band};
+    size_t neighbourTile[] = {tile, tile, (tile + tiles - 1) % tiles, (tile + 1) % tiles};
+    const int NUM_OF_NEIGHBOURS = 4;
+
+    for (int i = 0; i < NUM_OF_NEIGHBOURS; ++i)
     {
-        for (unsigned int i = 0; i < n_iter; ++i)
+        size_t index = neighbourBand[i] * tiles + neighbourTile[i];
+        bool isUpdatedBefore = isInPlace && index < band * tiles + tile;
+        if (hasNeighbour[i] && (isUpdatedBefore ? calc->changedNow[index] : calc->changedBefore[index]))
         {
-            prevSum = currSum;
-            heat(function); // activate the heat function
-            heatSum(&currSum); // get the current heat sum into currentSum
+            return true;
         }
     }
+    return false;
+}
+
+/**
+ * Updates the Gauss-Seidel pass's row r within the tile's columns [from, to),
+ * refreshing the cyclic halo cells like heat() does.
+ * @param kernel
+ * @param r
+ * @param from
+ * @param to
+ */
+void activateTileRow(calculation *calc, const row_kernel kernel, const size_t r, const size_t from,
+                     const size_t to)
+{
+    const size_t FIRST = 0;
+
+    if (calc->isCyclic && from == FIRST)
+    {
+        double *cells = heatGridRow(calc->grid, r);
+        cells[-1] = cells[calc->columns - 1];
+        cells[calc->columns] = cells[FIRST];
+        activateRow(calc, kernel, calc->grid, calc->grid, r, FIRST, FIRST + 1);
+        cells[calc->columns] = cells[FIRST];
+        activateRow(calc, kernel, calc->grid, calc->grid, r, FIRST + 1, to);
+    }
     else
     {
-        do
+        if (calc->isCyclic && to == calc->columns)
+        {
+            double *cells = heatGridRow(calc->grid, r);
+            cells[calc->columns] = cells[FIRST]; // the first tile may be skipped
+        }
+        activateRow(calc, kernel, calc->grid, calc->grid, r, from, to);
+    }
+}
+
+/**
+ * heat() over the active tiles: the tiles are updated band after band, each
+ * band tile after tile, which gives every cell the very same neighbours (new
+ * or old) as updating it row after row; a tile which isn't active is skipped.
+ * The rows' sums follow their band.
+ */
+void heatActiveTiles(calculation *calc)
+{
+    const size_t FIRST = 0;
+    const unsigned int CALLER = 0;
+    const size_t tiles = tilesPerBand(calc);
+
+    double *old = oldRow(calc, CALLER);
+    startTilePass(calc);
+    if (calc->isCyclic)
+    {
+        copyToHaloRow(calc, calc->grid, calc->rows - 1, -1);
+        copyToHaloRow(calc, calc->grid, FIRST, (ptrdiff_t) calc->rows);
+    }
+
+    for (size_t band = 0; band < tileBands(calc); ++band)
+    {
+        size_t firstRow = band * ACTIVE_TILE_ROWS;
+        size_t lastRow = (firstRow + ACTIVE_TILE_ROWS < calc->rows) ? firstRow + ACTIVE_TILE_ROWS : calc->rows;
+        for (size_t tile = 0; tile < tiles; ++tile)
+        {
+            if (!isTileActive(calc, band, tile, true))
+            {
+                continue;
+            }
+
+            size_t from = tile * ACTIVE_TILE_COLUMNS;
+            size_t to = (from + ACTIVE_TILE_COLUMNS < calc->columns) ? from + ACTIVE_TILE_COLUMNS : calc->columns;
+            bool isChanged = false;
+            for (size_t r = firstRow; r < lastRow; ++r)
+            {
+                double *cells = heatGridRow(calc->grid, r);
+                memcpy(old + from, cells + from, (to - from) * sizeof(double));
+                activateTileRow(calc, calc->kernel.row, r, from, to);
+                if (calc->isCyclic && r == FIRST)
+                {
+                    // like heat(), the last row reads the first one's new cells (in band 0 too, when it's the only one)
+                    double *halo = heatGridRow(calc->grid, (ptrdiff_t) calc->rows);
+                    memcpy(halo + from, cells + from, (to - from) * sizeof(double));
+                }
+                isChanged = isChanged || memcmp(old + from, cells + from, (to - from) * sizeof(double)) != 0;
+                if (calc->trackNorms)
+                {
+                    measureCells(calc, cells, old, r, from, to);
+                }
+            }
+            calc->changedNow[band * tiles + tile] = isChanged;
+        }
+
+        for (size_t r = firstRow; r < lastRow && calc->trackSum; ++r)
         {
-            prevSum = currSum;
-            heat(function); // activate the heat function
-            heatSum(&currSum); // get the current heat sum into currentSum
-        } while (!isPrecise(prevSum, currSum, terminate));
+            sumRow(calc, calc->grid, r);
+        }
     }
+}
+
+/**
+ * The range task of a Jacobi pass over the active tiles: calculates the tile
+ * bands [from, to) of the calculation's 'next' grid from its current one. A
+ * tile which isn't active holds the same cells in both grids (it didn't change
+ * in its latest update), so skipping it leaves 'next' right.
+ */
+void jacobiActiveBands(const size_t from, const size_t to, const unsigned int thread, void *context)
+{
+    calculation *calc = context;
+    const size_t tiles = tilesPerBand(calc);
 
-    return fabs(currSum - prevSum);
+    (void) thread;
+    for (size_t band = from; band < to; ++band)
+    {
+        size_t firstRow = band * ACTIVE_TILE_ROWS;
+        size_t lastRow = (firstRow + ACTIVE_TILE_ROWS < calc->rows) ? firstRow + ACTIVE_TILE_ROWS : calc->rows;
+        for (size_t tile = 0; tile < tiles; ++tile)
+        {
+            if (!isTileActive(calc, band, tile, false))
+            {
+                continue;
+            }
+
+            size_t first = tile * ACTIVE_TILE_COLUMNS;
+            size_t last = (first + ACTIVE_TILE_COLUMNS < calc->columns) ? first + ACTIVE_TILE_COLUMNS : calc->columns;
+            bool isChanged = false;
+            for (size_t r = firstRow; r < lastRow; ++r)
+            {
+                activateRow(calc, calc->kernel.jacobi, calc->current, calc->next, r, first, last);
+                const double *updated = heatGridRow(calc->next, r);
+                const double *old = heatGridRow(calc->current, r);
+                isChanged = isChanged || memcmp(old + first, updated + first, (last - first) * sizeof(double)) != 0;
+                if (calc->trackNorms)
+                {
+                    measureCells(calc, updated, old, r, first, last);
+                }
+            }
+            calc->changedNow[band * tiles + tile] = isChanged;
+        }
+
+        for (size_t r = firstRow; r < lastRow && calc->trackSum; ++r)
+        {
+            sumRow(calc, calc->next, r);
+        }
+    }
 }
 
+/**
+ * The range task of a Jacobi pass: calculates the rows [from, to) of the
+ * calculation's 'next' grid from its current one.
+ */
+void jacobiRows(const size_t from, const size_t to, const unsigned int thread, void *context)
+{
+    calculation *calc = context;
+
+    (void) thread;
+    for (size_t r = from; r < to; r++)
+    {
+        activateRow(calc, calc->kernel.jacobi, calc->current, calc->next, r, 0, calc->columns);
+        finishRow(calc, calc->next, r, heatGridRow(calc->current, r));
+    }
+}
+
+/**
+ * performing the heat activity in Jacobi order: every cell of the next pass
+ * is calculated from the current pass only, so the rows have no loop-carried
+ * dependency & the vectorized kernels can be used. Swaps calc->current to the
+ * next pass.
+ */
+void jacobi(calculation *calc)
+{
+    calc->next = (calc->current == calc->grid) ? &calc->scratch : calc->grid;
+
+    if (calc->isCyclic)
+    {
+        wrapHeatGridHalo(calc->current);
+    }
+
+    if (calc->isTrackingTiles)
+    {
+        startTilePass(calc);
+        runParallel(calc->pool, tileBands(calc), jacobiActiveBands, calc);
+    }
+    else
+    {
+        runParallel(calc->pool, calc->rows, jacobiRows, calc);
+    }
+    calc->current = calc->next;
+}
+
+/**
+ * Advances 'levels' Jacobi passes at once: a wavefront walks down the rows,
+ * and at every front step the row 'front - s' is advanced to the pass s + 1,
+ * for s = 0 .. levels - 1. The row r of pass s + 1 needs the rows r - 1 .. r + 1
+ * of pass s, which are (just) done by then, so only the ~levels + 2 rows around
+ * the front are touched per step and stay in cache. Passes alternate between the
+ * two buffers; the pass s + 1 may overwrite the row r of the pass s - 1 since the
+ * last reader of it (the row r + 1 of pass s) comes earlier in the same step.
+ * Single threaded, non-cyclic only (the zero halo rows never change).
+ * @param levels the number of passes
+ * @return the heat sum after the last pass.
+ */
+double jacobiWavefront(calculation *calc, const unsigned int levels)
+{
+    heat_grid *buffers[] = {calc->current, (calc->current == calc->grid) ? &calc->scratch : calc->grid};
+    const size_t NUM_OF_BUFFERS = 2;
+
+    for (size_t front = 0; front < calc->rows + levels - 1; ++front)
+    {
+        for (size_t s = 0; s < levels && s <= front; ++s)
+        {
+            size_t r = front - s;
+            if (r < calc->rows)
+            {
+                activateRow(calc, calc->kernel.jacobi, buffers[s % NUM_OF_BUFFERS], buffers[(s + 1) % NUM_OF_BUFFERS],
+                            r, 0, calc->columns);
+                if (s == levels - 1)
+                {
+                    sumRow(calc, buffers[(s + 1) % NUM_OF_BUFFERS], r);
+                }
+            }
+        }
+    }
+
+    calc->current = buffers[levels % NUM_OF_BUFFERS];
+    return rowSumsTotal(calc);
+}
+
+/**
+ * checks weather the fixed-iterations loop advances its passes in time tiles.
+ * @return true if it does, otherwise false.
+ */
+bool isTimeTiled(calculation *calc)
+{
+    const unsigned int NO_TILING = 1;
+    return calc->options.order == SWEEP_JACOBI && calc->options.time_tile > NO_TILING && !calc->isCyclic;
+}
+
+/**
+ * Activates a single pass in the order chosen by the options, measuring the
+ * sum of the grid after it (if calc->trackSum) and the norms of its update
+ * (if calc->trackNorms).
+ * @param sum output parameter: the heat sum after the pass (if tracked).
+ * @param norms output parameter: the norms of the pass's update (if tracked).
+ */
+void sweep(calculation *calc, double *sum, update_norms *norms)
+{
+    if (calc->trackNorms)
+    {
+        memset(calc->rowNorms, 0, calc->rows * sizeof(update_norms));
+    }
+
+    beginPhase(calc->options.profile, PHASE_SWEEP);
+    switch (calc->options.order)
+    {
+        case SWEEP_JACOBI:
+            jacobi(calc);
+            break;
+        case SWEEP_RED_BLACK:
+            redBlack(calc);
+            break;
+        default:
+            if (calc->isTrackingTiles)
+            {
+                heatActiveTiles(calc);
+            }
+            else
+            {
+                heat(calc);
+            }
+    }
+    endPhase(calc->options.profile, PHASE_SWEEP);
+
+    beginPhase(calc->options.profile, PHASE_REDUCTION);
+    if (calc->trackSum)
+    {
+        *sum = rowSumsTotal(calc);
+    }
+    if (calc->trackNorms)
+    {
+        *norms = rowNormsTotal(calc);
+    }
+    endPhase(calc->options.profile, PHASE_REDUCTION);
+}
+
+/**
+ * Prepares the second buffer of the Jacobi sweep (the previous calculation's,
+ * if it's kept): a copy of the grid (so the sources, which are never written,
+ * hold their values in both).
+ * @return true on success, false if it could not be allocated.
+ */
+bool createScratch(calculation *calc)
+{
+    if (calc->scratch.data == NULL && !createHeatGrid(&calc->scratch, calc->rows, calc->columns))
+    {
+        return false;
+    }
+
+    for (size_t r = 0; r < calc->rows; ++r)
+    {
+        memcpy(heatGridRow(&calc->scratch, r), heatGridRow(calc->grid, r), calc->columns * sizeof(double));
+    }
+
+    return true;
+}
+
+/**
+ * Copies the latest pass back into the grid if the second buffer is the one holding it.
+ */
+void finishScratch(calculation *calc)
+{
+    if (calc->current == &calc->scratch)
+    {
+        for (size_t r = 0; r < calc->rows; ++r)
+        {
+            memcpy(heatGridRow(calc->grid, r), heatGridRow(&calc->scratch, r), calc->columns * sizeof(double));
+        }
+        calc->current = calc->grid;
+    }
+}
+
+/**
+ * checks weather we should terminate the
+ * loop by iterations or not.
+ * @param n_iter
+ * @return true if should, otherwise false.
+ */
+bool isTerminatedByIterations(const int n_iter)
+{
+    const int NO_ITERATIONS = 0;
+    return (n_iter > NO_ITERATIONS);
+}
+
+/**
+ * Checks weather the precision is good enough
+ * by validates the monitor of the checked pass.
+ * @param monitor - the monitor's value (e.g. the remainder of currSum - prevSum).
+ * @param terminate - the required precision.
+ * @return
+ */
+bool isPrecise(const double monitor, const double terminate)
+{
+    return monitor < terminate;
+}
+
+/**
+ * checks weather the pass 'iteration' (counted from 1) is checked against terminate:
+ * the last one of a fixed number of iterations, or every check_interval'th one.
+ * @param iteration
+ * @param n_iter
+ * @return true if it is, otherwise false.
+ */
+bool isCheckedIteration(calculation *calc, const unsigned int iteration, const unsigned int n_iter)
+{
+    return isCheckedPass(iteration, n_iter, calc->options.check_interval);
+}
+
+/**
+ * checks weather the pass 'iteration' (counted from 1) is offered to the snapshot writer.
+ * @param iteration
+ * @return true if it is, otherwise false.
+ */
+bool isSnapshotIteration(calculation *calc, const unsigned int iteration)
+{
+    const unsigned int NO_SNAPSHOTS = 0;
+
+    return calc->options.snapshots != NULL && calc->options.snapshot_interval > NO_SNAPSHOTS &&
+           iteration % calc->options.snapshot_interval == 0;
+}
+
+/**
+ * checks weather the pass 'iteration' (counted from 1) is saved into the checkpoint file.
+ * @param iteration
+ * @return true if it is, otherwise false.
+ */
+bool isCheckpointIteration(calculation *calc, const unsigned int iteration)
+{
+    const unsigned int NO_CHECKPOINTS = 0;
+
+    return calc->options.checkpoints != NULL && calc->options.checkpoint_interval > NO_CHECKPOINTS &&
+           iteration % calc->options.checkpoint_interval == 0;
+}
+
+/**
+ * Saves the grid & the state after the pass 'iteration' into the checkpoint file.
+ * @param iteration
+ * @param sum the sum after the pass
+ * @param monitor of the latest checked pass
+ */
+void saveState(calculation *calc, const unsigned int iteration, const double sum, const double monitor)
+{
+    solver_state state = {iteration, sum, monitor, calc->isRateKnown, calc->isAdapting, calc->gaussSeidelRate,
+                          calc->relaxedHalfPasses, calc->relaxation, calc->estimatePasses, calc->lastUpdate, calc->lastEstimate};
+    saveCheckpoint(calc->options.checkpoints, calc->current, calc->options.calculation, &state);
+}
+
+/**
+ * Goes on from a saved state instead of starting the relaxation (the grid is the saved one).
+ * @param state
+ * @param iteration output parameter: the passes done.
+ * @param sum output parameter: the sum after the latest pass.
+ * @param monitor output parameter: the monitor of the latest checked pass.
+ */
+void restoreState(calculation *calc, const solver_state *state, unsigned int *iteration, double *sum, double *monitor)
+{
+    *iteration = state->pass;
+    *sum = state->sum;
+    *monitor = state->monitor;
+    calc->isRateKnown = state->isRateKnown;
+    calc->isAdapting = state->isAdapting;
+    calc->gaussSeidelRate = state->rate;
+    calc->relaxedHalfPasses = state->relaxedHalfPasses;
+    calc->relaxation = state->relaxation;
+    calc->estimatePasses = state->estimatePasses;
+    calc->lastUpdate = state->lastUpdate;
+    calc->lastEstimate = state->lastEstimate;
+}
+
+/**
+ * Returns the options' monitor for a checked pass.
+ * @param prevSum the sum before the pass
+ * @param currSum the sum after the pass
+ * @param norms the norms of the pass's update
+ * @return the monitor's value.
+ */
+double monitorValue(calculation *calc, const double prevSum, const double currSum, const update_norms *norms)
+{
+    return monitorOfPass(calc->options.monitor, prevSum, currSum, norms);
+}
+
+/**
+ * Checks weather the run is solved by the options' solver: a convergence run
+ * of heat_eqn whose options ask for 'solver'.
+ * @param solver
+ * @param kernel
+ * @param n_iter
+ * @return true if it is, false otherwise.
+ */
+bool isSolvedBy(calculation *calc, const solver_method solver, const stencil_kernel *kernel, const unsigned int n_iter)
+{
+    return calc->options.solver == solver && !isTerminatedByIterations(n_iter) && kernel->params.function == heat_eqn;
+}
+
+/**
+ * Runs a multigrid cycle on the grid but for its last pass, which is the
+ * caller's: the pre-smoothing passes, the coarse grid correction & the rest of
+ * the post-smoothing passes. The pass before the last one sums the grid into
+ * 'sum' if the last one is summed.
+ * @param sum
+ */
+void cycleAllButLastPass(calculation *calc, double *sum)
+{
+    const unsigned int PRE_SMOOTHING = 2;
+    const unsigned int POST_SMOOTHING = 2; // with the last pass
+
+    bool trackSum = calc->trackSum;
+    bool trackNorms = calc->trackNorms;
+    update_norms norms;
+
+    calc->trackSum = false;
+    calc->trackNorms = false;
+    for (unsigned int pass = 0; pass < PRE_SMOOTHING; ++pass)
+    {
+        sweep(calc, sum, &norms);
+    }
+
+    correctFromCoarseLevels(&calc->multigrid, calc->current);
+    for (unsigned int pass = 1; pass < POST_SMOOTHING; ++pass)
+    {
+        calc->trackSum = trackSum && pass + 1 == POST_SMOOTHING;
+        sweep(calc, sum, &norms);
+    }
+
+    calc->trackSum = trackSum;
+    calc->trackNorms = trackNorms;
+}
+
+/**
+ * Returns the relaxation factor of the SSOR preconditioner: the options' factor,
+ * if given, otherwise one from the grid's rate. SSOR preconditions best a bit
+ * below SOR's optimal factor: 2 / (1 + 2 * sqrt(1 - rate)) instead of 2 / (1 + sqrt(1 - rate)).
+ */
+double preconditionerRelaxation(calculation *calc)
+{
+    const double MARGIN = 2;
+
+    if (calc->options.omega > OMEGA_FROM_GRID)
+    {
+        return calc->options.omega;
+    }
+    return 2 / (1 + MARGIN * sqrt(1 - gridRate(calc)));
+}
+
+/**
+ * Returns the relaxation factor of the float passes of mixed precision: the
+ * options' factor, if given, otherwise the grid's optimal one.
+ */
+double mixedRelaxation(calculation *calc)
+{
+    return (calc->options.omega > OMEGA_FROM_GRID) ? calc->options.omega : optimalRelaxation(gridRate(calc));
+}
+
+/**
+ * Frees the solvers built on the source index: the multigrid levels, the
+ * conjugate gradient's vectors & the float grids of mixed precision.
+ */
+void freeSourceSolvers(calculation *calc)
+{
+    freeMultigrid(&calc->multigrid);
+    freeConjugateGradient(&calc->conjugateGradient);
+    freeMixedPrecision(&calc->mixedPrecision);
+}
+
+/**
+ * Frees the calculation's buffers (the latest pass ends up in the grid).
+ */
+void releaseBuffers(calculation *calc)
+{
+    destroyThreadPool(calc->pool);
+    calc->pool = NULL;
+    finishScratch(calc);
+    freeHeatGrid(&calc->scratch);
+    freeSourceIndex(calc);
+    free(calc->rowSums);
+    free(calc->rowNorms);
+    free(calc->oldRows);
+    free(calc->tileChanges);
+    freeSourceSolvers(calc);
+    calc->rowSums = NULL;
+    calc->rowNorms = NULL;
+    calc->oldRows = NULL;
+    calc->tileChanges = NULL;
+}
+
+/**
+ * Builds the source index of the whole grid: for every row r, the sorted &
+ * distinct columns of its sources are sourceColumns[sourceRowStart[r] .. sourceRowStart[r + 1]).
+ * Sources outside the grid are ignored (they can't match any cell). The index
+ * of the previous calculation (with the solvers built on it) is kept if its
+ * sources are at the very same cells.
+ * @return true on success, false if the index could not be allocated.
+ */
+bool refreshSourceIndex(calculation *calc)
+{
+    size_t *rowStart;
+    size_t *columns;
+    if (!indexSources(calc->sources, calc->numOfSources, 0, 0, calc->rows, calc->columns, &rowStart, &columns))
+    {
+        return false;
+    }
+
+    if (calc->sourceRowStart != NULL &&
+        memcmp(calc->sourceRowStart, rowStart, (calc->rows + 1) * sizeof(size_t)) == 0 &&
+        memcmp(calc->sourceColumns, columns, rowStart[calc->rows] * sizeof(size_t)) == 0)
+    {
+        free(rowStart);
+        free(columns);
+        return true;
+    }
+
+    freeSourceSolvers(calc);
+    freeSourceIndex(calc);
+    calc->sourceRowStart = rowStart;
+    calc->sourceColumns = columns;
+    return true;
+}
+
+/**
+ * Allocates the calculation's buffers which it didn't keep from the previous
+ * one: the source index, the row measures, the flags of the active tiles, the Jacobi sweep's second buffer,
+ * the multigrid levels, the conjugate gradient's vectors or the float grids of
+ * mixed precision & the thread pool.
+ * @return true on success, false (with nothing allocated) otherwise.
+ */
+bool acquireBuffers(calculation *calc)
+{
+    if (calc->pool == NULL && calc->options.order != SWEEP_GAUSS_SEIDEL && calc->options.threads != 1)
+    {
+        calc->pool = createThreadPool(calc->options.threads);
+        if (calc->pool == NULL)
+        {
+            releaseBuffers(calc);
+            return false;
+        }
+    }
+
+    calc->rowSums = (calc->rowSums != NULL) ? calc->rowSums : malloc(calc->rows * sizeof(compensated_sum));
+    calc->rowNorms = (calc->rowNorms != NULL) ? calc->rowNorms : malloc(calc->rows * sizeof(update_norms));
+    calc->oldRows = (calc->oldRows != NULL) ? calc->oldRows
+                                            : malloc(poolThreads(calc->pool) * calc->columns * sizeof(double));
+    if (calc->isTrackingTiles && calc->tileChanges == NULL)
+    {
+        calc->tileChanges = malloc(2 * tileBands(calc) * tilesPerBand(calc));
+    }
+    if (calc->rowSums == NULL || calc->rowNorms == NULL || calc->oldRows == NULL ||
+        (calc->isTrackingTiles && calc->tileChanges == NULL) || !refreshSourceIndex(calc) ||
+        (calc->options.order == SWEEP_JACOBI && !createScratch(calc)) ||
+        (calc->isMultigrid && calc->multigrid.levels == NULL && !createMultigrid(&calc->multigrid, calc->rows, calc->columns, calc->sourceRowStart, calc->sourceColumns, calc->isCyclic)) ||
+        (calc->isConjugateGradient && calc->conjugateGradient.residual.data == NULL &&
+         !createConjugateGradient(&calc->conjugateGradient, calc->rows, calc->columns, calc->sourceRowStart,
+                                                          calc->sourceColumns, calc->isCyclic, calc->options.preconditioner,
+                                                          preconditionerRelaxation(calc))) ||
+        (calc->isMixedPrecision && calc->mixedPrecision.correction.data == NULL &&
+         !createMixedPrecision(&calc->mixedPrecision, calc->rows, calc->columns, calc->sourceRowStart,
+                                                    calc->sourceColumns, calc->isCyclic, mixedRelaxation(calc))))
+    {
+        releaseBuffers(calc);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Checks weather the buffers of the calculation 'kept' fit the calculation
+ * 'next': one of the same grid & solver, whose passes run on as many threads.
+ * @return true if they do, otherwise false.
+ */
+bool isSameShape(const calculation *kept, const calculation *next)
+{
+    return kept->rows == next->rows && kept->columns == next->columns && kept->isCyclic == next->isCyclic &&
+           kept->isMultigrid == next->isMultigrid && kept->isConjugateGradient == next->isConjugateGradient &&
+           kept->isMixedPrecision == next->isMixedPrecision && kept->options.order == next->options.order &&
+           kept->options.threads == next->options.threads &&
+           kept->options.preconditioner == next->options.preconditioner && kept->options.omega == next->options.omega &&
+           kept->isTrackingTiles == next->isTrackingTiles;
+}
+
+/**
+ * Moves the buffers of the calculation 'kept' to the calculation 'next'.
+ */
+void takeBuffers(calculation *next, const calculation *kept)
+{
+    next->pool = kept->pool;
+    next->rowSums = kept->rowSums;
+    next->rowNorms = kept->rowNorms;
+    next->oldRows = kept->oldRows;
+    next->tileChanges = kept->tileChanges;
+    next->scratch = kept->scratch;
+    next->sourceRowStart = kept->sourceRowStart;
+    next->sourceColumns = kept->sourceColumns;
+    next->multigrid = kept->multigrid;
+    next->conjugateGradient = kept->conjugateGradient;
+    next->mixedPrecision = kept->mixedPrecision;
+}
+
+/**
+ * Calculates the heat and its dissipation according to the source points 'sources',
+ *by activating the kernel 'kernel' on the grid.
+ * @param solver whose buffers the calculation uses (& keeps)
+ * @param kernel the row kernel to activate
+ * @param grid the contiguous grid (its rows & columns are the n, m of the calculation)
+ * @param sources array of the heat sources points
+ * @param num_sources the number of sources
+ * @param terminate the 'epsilon' for detecting the required precision
+ * @param n_iter num of iterations
+ * @param is_cyclic is it should be cyclic
+ * @param options the solver options
+ * @return the monitor of the last checked iteration (by default the heat reminder of
+ * the last iteration), or CALCULATION_FAILED if memory could not be allocated
+ */
+double calculateWithKernel(heat_solver *solver, const stencil_kernel *kernel, heat_grid *grid,
+                           source_point *sources, size_t num_sources,
+                           double terminate, unsigned int n_iter, int is_cyclic,
+                           const solver_options *options)
+{
+    //............ the calculation's state initialization .......//
+    calculation *calc = &solver->calc;
+    calculation kept = *calc; // the previous calculation's buffers
+    memset(calc, 0, sizeof(calculation));
+    calc->kernel = *kernel;
+    calc->options = *options;
+    calc->isCyclic = is_cyclic;
+    calc->rows = grid->rows;
+    calc->columns = grid->columns;
+    calc->sources = sources;
+    calc->numOfSources = num_sources;
+    calc->grid = grid;
+    calc->current = grid;
+    calc->isMultigrid = isSolvedBy(calc, SOLVER_MULTIGRID, kernel, n_iter);
+    calc->isConjugateGradient = isSolvedBy(calc, SOLVER_CG, kernel, n_iter);
+    calc->isMixedPrecision = isSolvedBy(calc, SOLVER_MIXED, kernel, n_iter);
+    if (calc->isMultigrid && calc->options.order == SWEEP_JACOBI)
+    {
+        calc->options.order = SWEEP_RED_BLACK; // Jacobi passes don't smooth the checkerboard error
+    }
+    if (calc->isMultigrid)
+    {
+        calc->options.relaxation = RELAXATION_NONE; // over-relaxed passes don't smooth either
+    }
+    calc->isTrackingTiles = isTrackingTiles(calc);
+
+    if (solver->hasBuffers && isSameShape(&kept, calc))
+    {
+        takeBuffers(calc, &kept);
+    }
+    else if (solver->hasBuffers)
+    {
+        releaseBuffers(&kept);
+    }
+    solver->hasBuffers = acquireBuffers(calc);
+    if (!solver->hasBuffers)
+    {
+        return CALCULATION_FAILED;
+    }
+    if (calc->isTrackingTiles)
+    {
+        resetTiles(calc);
+    }
+
+    if (!calc->isCyclic)
+    {
+        clearHeatGridHalo(calc->grid);
+        if (calc->options.order == SWEEP_JACOBI)
+        {
+            clearHeatGridHalo(&calc->scratch);
+        }
+    }
+
+    if (calc->options.resume == NULL) // a resumed calculation's start is in its saved grid
+    {
+        beginPhase(calc->options.profile, PHASE_START);
+        if (calc->options.warm_cache != NULL && !isTerminatedByIterations(n_iter))
+        {
+            warmStart(calc->options.warm_cache, calc->grid, sources, num_sources, is_cyclic);
+        }
+        if (calc->isMultigrid)
+        {
+            startFromCoarseLevels(&calc->multigrid, calc->current);
+        }
+        if (calc->isConjugateGradient)
+        {
+            solveByConjugateGradient(&calc->conjugateGradient, calc->current, calc->options.monitor, terminate);
+        }
+        if (calc->isMixedPrecision)
+        {
+            solveInMixedPrecision(&calc->mixedPrecision, calc->current, calc->options.monitor, terminate);
+        }
+        startRelaxation(calc);
+        endPhase(calc->options.profile, PHASE_START);
+    }
+
+    double prevSum;
+    beginPhase(calc->options.profile, PHASE_REDUCTION);
+    heatSum(calc, calc->current, &prevSum); // get the heat sum into sum
+    endPhase(calc->options.profile, PHASE_REDUCTION);
+    double currSum = prevSum;
+    update_norms norms = {0, 0, 0};
+    double monitor = 0;
+    unsigned int i = 0;
+    unsigned int restoredPasses = 0;
+    if (calc->options.resume != NULL)
+    {
+        restoreState(calc, calc->options.resume, &i, &currSum, &monitor);
+        restoredPasses = i;
+    }
+
+    if (isTerminatedByIterations(n_iter) && isTimeTiled(calc))
+    {
+        // All but the last pass in tiles; the last one is a plain pass, for the monitor
+        for (unsigned int levels; i + 1 < n_iter; i += levels)
+        {
+            levels = (n_iter - 1 - i < calc->options.time_tile) ? n_iter - 1 - i : calc->options.time_tile;
+            beginPhase(calc->options.profile, PHASE_TILE);
+            currSum = jacobiWavefront(calc, levels);
+            endPhase(calc->options.profile, PHASE_TILE);
+        }
+    }
+
+    for (;;)
+    {
+        ++i;
+        // measure only what the checked passes need (the sum monitor needs the sum before them too)
+        calc->trackNorms = (calc->options.monitor != MONITOR_SUM_DELTA && isCheckedIteration(calc, i, n_iter)) || isAdaptingRate(calc);
+        calc->trackSum = calc->options.monitor == MONITOR_SUM_DELTA &&
+                    (isCheckedIteration(calc, i, n_iter) || isCheckedIteration(calc, i + 1, n_iter));
+        if (calc->isMultigrid)
+        {
+            beginPhase(calc->options.profile, PHASE_CYCLE);
+            cycleAllButLastPass(calc, &currSum);
+            endPhase(calc->options.profile, PHASE_CYCLE);
+        }
+        bool isAdapting = isAdaptingRate(calc);
+        prevSum = currSum;
+        sweep(calc, &currSum, &norms); // activate the heat kernel
+        if (isAdapting)
+        {
+            estimateRate(calc, sqrt(norms.l2));
+        }
+
+        if (isCheckedIteration(calc, i, n_iter))
+        {
+            monitor = monitorValue(calc, prevSum, currSum, &norms);
+            recordMonitor(calc->options.profile, calc->options.calculation, i, monitor);
+        }
+        if (isSnapshotIteration(calc, i))
+        {
+            offerSnapshot(calc->options.snapshots, calc->current, i, monitor);
+        }
+        if (isCheckedIteration(calc, i, n_iter) && (isTerminatedByIterations(n_iter) || isPrecise(monitor, terminate)))
+        {
+            break;
+        }
+        if (isCheckpointIteration(calc, i))
+        {
+            saveState(calc, i, currSum, monitor);
+        }
+    }
+
+    if (calc->options.passes != NULL)
+    {
+        *calc->options.passes = i - restoredPasses; // the ones of this run
+    }
+
+    finishScratch(calc);
+    if (calc->options.warm_cache != NULL && !isTerminatedByIterations(n_iter))
+    {
+        storeSolution(calc->options.warm_cache, calc->grid, sources, num_sources, is_cyclic); // at best effort
+    }
+    return monitor;
+}
+
+/**
+ * Returns the default solver options: in-place Gauss-Seidel passes on a single
+ * thread, with the best SIMD kernels the CPU supports, checking the change of
+ * the heat sum after every pass, without over-relaxation (whose factor is the grid's
+ * optimal one once it's asked for) or active tiles, and without snapshots, checkpoints, a pass count, a profile
+ * or a warm start.
+ */
+solver_options defaultSolverOptions()
+{
+    const unsigned int SINGLE_THREAD = 1;
+    const unsigned int NO_TIME_TILES = 0;
+    const bool NO_ACTIVE_TILES = false;
+    const unsigned int VOLUME_BLOCK_FROM_CACHE = 0;
+    const unsigned int EVERY_PASS = 1;
+    const unsigned int NO_SNAPSHOTS = 0;
+    const unsigned int NO_CHECKPOINTS = 0;
+    const unsigned int FIRST_CALCULATION = 0;
+
+    solver_options options = {SWEEP_GAUSS_SEIDEL, SIMD_AUTO, SINGLE_THREAD, NO_TIME_TILES, NO_ACTIVE_TILES, VOLUME_BLOCK_FROM_CACHE,
+                              MONITOR_SUM_DELTA, EVERY_PASS, SOLVER_PASSES, RELAXATION_NONE, OMEGA_FROM_GRID,
+                              PRECONDITIONER_JACOBI, NO_SNAPSHOTS, NULL, NO_CHECKPOINTS, NULL,
+                              FIRST_CALCULATION, NULL, NULL, NULL, NULL};
+    return options;
+}
+
+/**
+ * Creates a solver without buffers (its first calculation allocates them).
+ * @return the solver, or NULL if it could not be allocated.
+ */
+heat_solver *createHeatSolver()
+{
+    return (heat_solver *) calloc(1, sizeof(heat_solver));
+}
+
+/**
+ * Calculates the heat by activating the function 'function' on the grid
+ * (through its specialized kernel if it's a built-in function), with the solver's buffers.
+ * @return the heat reminder of the last iteration, or CALCULATION_FAILED
+ * if memory could not be allocated
+ */
+double solveHeat(heat_solver *solver, diff_func function, heat_grid *grid,
+                 source_point *sources, size_t num_sources,
+                 double terminate, unsigned int n_iter, int is_cyclic,
+                 const solver_options *options)
+{
+    solver_options defaults = defaultSolverOptions();
+    if (options == NULL)
+    {
+        options = &defaults;
+    }
+
+    stencil_kernel kernel = kernelOf(function, options->simd);
+    return calculateWithKernel(solver, &kernel, grid, sources, num_sources, terminate, n_iter, is_cyclic, options);
+}
+
+/**
+ * Calculates the heat by activating the weighted 5-point stencil 'weights' on
+ * the grid, with the solver's buffers.
+ * @return the heat reminder of the last iteration, or CALCULATION_FAILED
+ * if memory could not be allocated
+ */
+double solveHeatStencil(heat_solver *solver, const stencil_weights *weights, heat_grid *grid,
+                        source_point *sources, size_t num_sources,
+                        double terminate, unsigned int n_iter, int is_cyclic,
+                        const solver_options *options)
+{
+    solver_options defaults = defaultSolverOptions();
+    if (options == NULL)
+    {
+        options = &defaults;
+    }
+
+    stencil_kernel kernel = weightedKernel(weights);
+    return calculateWithKernel(solver, &kernel, grid, sources, num_sources, terminate, n_iter, is_cyclic, options);
+}
+
+/**
+ * Frees the solver's buffers & the solver.
+ * @param solver
+ */
+void destroyHeatSolver(heat_solver *solver)
+{
+    if (solver == NULL)
+    {
+        return;
+    }
+
+    if (solver->hasBuffers)
+    {
+        releaseBuffers(&solver->calc);
+    }
+    free(solver);
+}
+
+/**
+ * Calculates the heat by activating the function 'function' on the grid, with
+ * a solver of its own.
+ * @return the heat reminder of the last iteration, or CALCULATION_FAILED
+ * if memory could not be allocated
+ */
+double calculateGrid(diff_func function, heat_grid *grid,
+                     source_point *sources, size_t num_sources,
+                     double terminate, unsigned int n_iter, int is_cyclic,
+                     const solver_options *options)
+{
+    heat_solver *solver = createHeatSolver();
+    if (solver == NULL)
+    {
+        return CALCULATION_FAILED;
+    }
+
+    double result = solveHeat(solver, function, grid, sources, num_sources, terminate, n_iter, is_cyclic, options);
+    destroyHeatSolver(solver);
+    return result;
+}
+
+/**
+ * Calculates the heat by activating the weighted 5-point stencil 'weights' on
+ * the grid, with a solver of its own.
+ * @return the heat reminder of the last iteration, or CALCULATION_FAILED
+ * if memory could not be allocated
+ */
+double calculateStencil(const stencil_weights *weights, heat_grid *grid,
+                        source_point *sources, size_t num_sources,
+                        double terminate, unsigned int n_iter, int is_cyclic,
+                        const solver_options *options)
+{
+    heat_solver *solver = createHeatSolver();
+    if (solver == NULL)
+    {
+        return CALCULATION_FAILED;
+    }
+
+    double result = solveHeatStencil(solver, weights, grid, sources, num_sources, terminate, n_iter, is_cyclic,
+                                     options);
+    destroyHeatSolver(solver);
+    return result;
+}
+
+/**
+ * Copies the rows of 'grid' into 'contiguous' (toContiguous) or back.
+ */
+static void copyRows(double **grid, heat_grid *contiguous, const bool toContiguous)
+{
+    for (size_t r = 0; r < contiguous->rows; ++r)
+    {
+        double *row = heatGridRow(contiguous, r);
+        if (toContiguous)
+        {
+            memcpy(row, grid[r], contiguous->columns * sizeof(double));
+        }
+        else
+        {
+            memcpy(grid[r], row, contiguous->columns * sizeof(double));
+        }
+    }
+}
+
+/**
+ * The row-pointer version of calculateGrid: copies 'grid' into a contiguous
+ * grid, calculates on it and copies the result back.
+ * @return the heat reminder of the last iteration, or CALCULATION_FAILED
+ * if memory could not be allocated.
+ */
+double calculate(diff_func function,
+                 double **grid,
+                 size_t n, size_t m, source_point *sources, size_t num_sources,
+                 double terminate, unsigned int n_iter, int is_cyclic)
+{
+    heat_grid contiguous;
+    if (!createHeatGrid(&contiguous, n, m))
+    {
+        return CALCULATION_FAILED;
+    }
+
+    copyRows(grid, &contiguous, true);
+    double result = calculateGrid(function, &contiguous, sources, num_sources,
+                                  terminate, n_iter, is_cyclic, NULL);
+    copyRows(grid, &contiguous, false);
+
+    freeHeatGrid(&contiguous);
+    return result;
+}
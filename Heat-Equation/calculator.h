@@ -7,7 +7,12 @@
 #ifndef CALCULATOR_H
 #define CALCULATOR_H
 
+#include <stdbool.h>
 #include <stdlib.h>
+#include "grid.h"
+#include "snapshot.h"
+#include "checkpoint.h"
+#include "profile.h"
 
 /**
  * Structure to hold heat sources.
@@ -18,11 +23,289 @@ typedef struct
 	double value;
 } source_point;
 
+/**
+ * Returned by the calculator functions when memory could not be allocated
+ * (a real heat reminder is never negative).
+ */
+#define CALCULATION_FAILED (-1.0)
+
 /**
  * Useful typedef.
  */
 typedef double (*diff_func)(double cell, double right, double top, double left, double bottom);
 
+/**
+ * The weights of a 5-point stencil:
+ * cell = center * cell + right * right + top * top + left * left + bottom * bottom.
+ */
+typedef struct
+{
+	double center, right, top, left, bottom;
+} stencil_weights;
+
+/**
+ * The order in which a pass updates the cells.
+ * SWEEP_GAUSS_SEIDEL - row by row in place; a cell sees its neighbours which were already updated in this pass.
+ * SWEEP_JACOBI - every cell from the previous pass only; uses the SIMD kernels for heat_eqn.
+ * SWEEP_RED_BLACK - in place, first the cells with an even row + column ("red"), then the odd
+ * ("black") ones, each seeing the other colour only. In cyclic runs the wrapped-around
+ * neighbours are read as they were at the start of the colour's half pass.
+ * Jacobi & red-black passes run on 'threads' threads, with the same result for any number of them.
+ */
+typedef enum
+{
+	SWEEP_GAUSS_SEIDEL,
+	SWEEP_JACOBI,
+	SWEEP_RED_BLACK
+} sweep_order;
+
+/**
+ * The instruction set of the vectorized kernels. SIMD_AUTO picks the best one
+ * the CPU supports; a level the CPU doesn't support falls back to the best one it does.
+ */
+typedef enum
+{
+	SIMD_AUTO,
+	SIMD_SCALAR,
+	SIMD_SSE2,
+	SIMD_AVX2,
+	SIMD_AVX512
+} simd_level;
+
+/**
+ * What the calculator compares to 'terminate'.
+ * MONITOR_SUM_DELTA - the change of the grid's sum in the checked pass (the original criterion).
+ * MONITOR_L1, MONITOR_L2, MONITOR_MAX - the sum, the euclidean norm & the maximum of the
+ * per-cell changes |new - old| in the checked pass.
+ */
+typedef enum
+{
+	MONITOR_SUM_DELTA,
+	MONITOR_L1,
+	MONITOR_L2,
+	MONITOR_MAX
+} convergence_monitor;
+
+/**
+ * How a convergence run (n_iter 0) of heat_eqn gets to the steady state.
+ * SOLVER_PASSES - passes of the options' order until the monitor is below 'terminate'.
+ * SOLVER_MULTIGRID - a full multigrid start (solving on coarser & coarser copies of the
+ * grid, where the sources stay fixed), then cycles whose smoothing passes are of the
+ * options' order (red-black instead of Jacobi, which doesn't smooth); the last pass of
+ * every cycle is the one counted & checked. It needs about the same number of cycles
+ * for any grid size.
+ * SOLVER_CG - preconditioned conjugate gradients (with the sources as fixed values) until
+ * the monitor's norm of the residual - the change a Jacobi pass would make - is below
+ * 'terminate', then passes until the monitor is (usually a single one).
+ * SOLVER_MIXED - iterative refinement: the residual is taken in double precision, and
+ * the correction it calls for is solved for by over-relaxed red-black passes over float
+ * grids (by the options' omega if it's a factor, otherwise by the grid's), which move
+ * half the bytes of double passes; refines like SOLVER_CG solves, then passes.
+ * Runs with a fixed n_iter, and other functions, always use passes.
+ */
+typedef enum
+{
+	SOLVER_PASSES,
+	SOLVER_MULTIGRID,
+	SOLVER_CG,
+	SOLVER_MIXED
+} solver_method;
+
+/**
+ * The preconditioner of SOLVER_CG.
+ * PRECONDITIONER_JACOBI - the diagonal (which is uniform for heat_eqn, so it's plain CG).
+ * PRECONDITIONER_SSOR - a forward & a backward over-relaxed pass, by the options' omega
+ * if it's a factor, otherwise by one estimated from the grid's size.
+ */
+typedef enum
+{
+	PRECONDITIONER_JACOBI,
+	PRECONDITIONER_SSOR
+} preconditioner_kind;
+
+/**
+ * The over-relaxation of the in-place passes (Gauss-Seidel & red-black; Jacobi
+ * passes are never relaxed, nor are the smoothing passes of multigrid).
+ * RELAXATION_NONE - every cell is set to its function's value.
+ * RELAXATION_SOR - successive over-relaxation: every cell moves omega times as
+ * far towards its function's value.
+ * RELAXATION_CHEBYSHEV - red-black passes whose factor changes every half pass
+ * (Chebyshev's semi-iterative sequence: 1, then factors which tend to SOR's optimal
+ * one while keeping the error lower on the way); Gauss-Seidel passes use SOR's optimal factor.
+ */
+typedef enum
+{
+	RELAXATION_NONE,
+	RELAXATION_SOR,
+	RELAXATION_CHEBYSHEV
+} relaxation_method;
+
+/**
+ * Special values of solver_options.omega: the optimal factor for heat_eqn on a
+ * grid of the calculation's size (cyclic or not), or the optimal factor for the
+ * convergence rate of the plain passes which start the run.
+ */
+#define OMEGA_FROM_GRID 0.0
+#define OMEGA_ADAPTIVE (-1.0)
+
+/**
+ * How the calculator solves.
+ */
+typedef struct
+{
+	sweep_order order;
+	simd_level simd;
+	unsigned int threads; // 0 - one per processor
+	/*
+	 * Temporal blocking of Jacobi runs with a fixed n_iter: advances this many passes
+	 * per wavefront over the rows, so the rows are reused from cache instead of
+	 * streaming the whole grid every pass (0 or 1 - off). Gives the very same result as
+	 * plain Jacobi passes; cyclic runs & convergence runs (n_iter 0) don't tile.
+	 */
+	unsigned int time_tile;
+	/*
+	 * Active tiles: the Gauss-Seidel & Jacobi passes split the grid into tiles of
+	 * ACTIVE_TILE_ROWS x ACTIVE_TILE_COLUMNS cells and skip a tile whose update is
+	 * known to change nothing - one which didn't change in its previous update while
+	 * none of the neighbours it reads did either (e.g. the still cold parts of the grid,
+	 * or converged ones). Gives the very same result as full passes. Over-relaxed
+	 * passes, red-black passes & multigrid runs don't track tiles.
+	 */
+	bool active_tiles;
+	/*
+	 * The rows of a block of a 3D pass (see volume.h), which goes through all the
+	 * planes before the next block (0 - as many as fit VOLUME_BLOCK_BYTES; the rows
+	 * of a whole plane - the plain plane order).
+	 */
+	unsigned int volume_block;
+	/*
+	 * The convergence test: 'monitor' is measured inside the passes, on every
+	 * check_interval'th pass only (0 counts as 1), and the run stops at the first
+	 * checked pass whose monitor is below 'terminate'. A fixed n_iter run only
+	 * measures its last pass.
+	 */
+	convergence_monitor monitor;
+	unsigned int check_interval;
+	solver_method solver;
+	/*
+	 * The over-relaxation: 'omega' is SOR's factor (in (0, 2)), OMEGA_FROM_GRID or
+	 * OMEGA_ADAPTIVE. Chebyshev's sequence only needs the convergence rate, which it
+	 * gets the same way (from a given factor - the rate it is optimal for).
+	 */
+	relaxation_method relaxation;
+	double omega;
+	preconditioner_kind preconditioner;
+	/*
+	 * Every snapshot_interval'th pass (0 - none) of a calculation is offered to
+	 * 'snapshots' (with the monitor of the latest checked pass), which writes it in
+	 * the background; the passes inside time tiles are not.
+	 */
+	unsigned int snapshot_interval;
+	snapshot_writer *snapshots;
+	/*
+	 * Every checkpoint_interval'th pass (0 - none) of a calculation but its last is
+	 * saved into 'checkpoints' as the caller's calculation 'calculation'; the passes
+	 * inside time tiles are not. A calculation given 'resume' goes on from that state
+	 * (with the grid it was saved with) instead of starting over.
+	 */
+	unsigned int checkpoint_interval;
+	checkpoint_file *checkpoints;
+	unsigned int calculation;
+	const solver_state *resume;
+	/*
+	 * When not NULL, set to the number of passes the calculation counted (multigrid's
+	 * cycles, each of which counts as its last pass), for measuring it; a resumed
+	 * calculation counts only the passes after its checkpoint.
+	 */
+	unsigned int *passes;
+	/*
+	 * When not NULL, the phases of the calculation are timed into 'profile', and the
+	 * monitor of every checked pass is added to its history (see profile.h).
+	 */
+	solver_profile *profile;
+	/*
+	 * When not NULL, a calculation until the precision (which doesn't resume)
+	 * starts from the nearest solution in 'warm_cache' instead of from the given
+	 * grid, and its solution is kept there (see warmstart.h). The distributed
+	 * calculation doesn't use it.
+	 */
+	struct solution_cache *warm_cache;
+} solver_options;
+
+/**
+ * The size of an active tile (see solver_options.active_tiles).
+ */
+#define ACTIVE_TILE_ROWS 16
+#define ACTIVE_TILE_COLUMNS 128
+
+/**
+ * Returns the default options (Gauss-Seidel passes, SIMD_AUTO, a single thread, no time tiles, no active tiles,
+ * 3D blocks sized to the cache, the sum-change monitor checked on every pass, solving by passes, no over-relaxation,
+ * Jacobi's preconditioner, no snapshots, no checkpoints, no pass count, no profile,
+ * no warm start).
+ */
+solver_options defaultSolverOptions();
+
+/**
+ * A reusable calculator: it owns the buffers of its calculations - the thread
+ * pool, the row measures, the Jacobi sweep's second buffer, the source index &
+ * the solvers built on it - and keeps them from one calculation to the next
+ * while its grid's size, cyclic flag & the options' order, threads, solver,
+ * preconditioner & omega stay the same (the source index & what's built on it
+ * while the sources are at the same cells), so repeated solves don't allocate.
+ * Solvers share nothing, so each thread can use its own; a solver is used by a
+ * single thread at a time.
+ */
+typedef struct heat_solver heat_solver;
+
+/**
+ * Creates a solver (its first calculation allocates the buffers).
+ * @return the solver, or NULL if it could not be allocated.
+ */
+heat_solver *createHeatSolver();
+
+/**
+ * calculateGrid with the solver's buffers.
+ */
+double solveHeat(heat_solver *solver, diff_func function, heat_grid *grid, source_point *sources, size_t num_sources,
+		double terminate, unsigned int n_iter, int is_cyclic, const solver_options *options);
+
+/**
+ * calculateStencil with the solver's buffers.
+ */
+double solveHeatStencil(heat_solver *solver, const stencil_weights *weights, heat_grid *grid, source_point *sources,
+		size_t num_sources, double terminate, unsigned int n_iter, int is_cyclic, const solver_options *options);
+
+/**
+ * Frees the solver & its buffers (NULL is allowed).
+ */
+void destroyHeatSolver(heat_solver *solver);
+
+/**
+ * Calculator function on a contiguous grid (the grid's rows & columns are the n, m of the calculation).
+ * Applies the given function to every point in the grid iteratively for n_iter loops,
+ * or until the cumulative difference is below terminate (if n_iter is 0).
+ * options may be NULL for the default options.
+ * Returns the options' monitor at the last checked pass.
+ */
+double calculateGrid(diff_func function, heat_grid *grid, source_point * sources, size_t num_sources, double terminate, unsigned int n_iter, int is_cyclic, const solver_options *options);
+
+/**
+ * calculateGrid with the weighted 5-point stencil 'weights' instead of a function.
+ */
+double calculateStencil(const stencil_weights *weights, heat_grid *grid, source_point * sources, size_t num_sources, double terminate, unsigned int n_iter, int is_cyclic, const solver_options *options);
+
+/**
+ * Builds the source index of the rows x columns block whose first cell is the
+ * grid's (first_row, first_column): for every row r of the block, the sorted &
+ * distinct block columns of its sources are
+ * (*source_columns)[(*row_start)[r] .. (*row_start)[r + 1]). Sources outside the
+ * block are ignored. The caller frees both arrays.
+ * @return true on success, false (with nothing allocated) if the index could not be allocated.
+ */
+bool indexSources(const source_point *sources, size_t num_sources, size_t first_row, size_t first_column,
+		size_t rows, size_t columns, size_t **row_start, size_t **source_columns);
+
 /**
  * Calculator function. Applies the given function to every point in the grid iteratively for n_iter loops,
  * or until the cumulative difference is below terminate (if n_iter is 0).
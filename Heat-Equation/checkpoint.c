@@ -0,0 +1,316 @@
+/**
+ * @author Roy Ackerman
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC "HEATCKPT"
+#define CHECKPOINT_MAGIC_LENGTH 8
+#define CHECKPOINT_SLOTS 2
+
+/**
+ * The start of the file; the problem's bytes follow it.
+ */
+typedef struct
+{
+    char magic[CHECKPOINT_MAGIC_LENGTH];
+    uint64_t rows, columns;
+    uint64_t problemSize;
+} file_header;
+
+/**
+ * The start of a slot; the cells follow it (row by row, without the halo).
+ * The checksum covers everything after it, up to the end of the slot.
+ */
+typedef struct
+{
+    uint64_t sequence; // 0 - never filled
+    uint64_t checksum;
+    uint64_t calculation;
+    solver_state state;
+} slot_header;
+
+/**
+ * Where the parts of a file lie (every part starts on a GRID_ALIGNMENT boundary).
+ */
+typedef struct
+{
+    size_t problemOffset;
+    size_t slotsOffset;
+    size_t cellsOffset; // inside a slot
+    size_t slotSize;
+    size_t size; // of the whole file
+} file_layout;
+
+struct checkpoint_file
+{
+    int descriptor;
+    unsigned char *map;
+    file_layout layout;
+    size_t rows, columns;
+    uint64_t nextSequence;
+    size_t older; // the slot of the next checkpoint
+    unsigned int syncSeconds;
+    struct timespec lastSync;
+};
+
+/**
+ * Rounds 'size' up to a whole number of GRID_ALIGNMENTs.
+ * @param size
+ * @return the rounded size.
+ */
+static size_t aligned(const size_t size)
+{
+    return (size + GRID_ALIGNMENT - 1) / GRID_ALIGNMENT * GRID_ALIGNMENT;
+}
+
+/**
+ * Lays out the file of rows x columns grids of a problem of 'problemSize' bytes.
+ * @param rows
+ * @param columns
+ * @param problemSize
+ * @return the layout.
+ */
+static file_layout layOut(const size_t rows, const size_t columns, const size_t problemSize)
+{
+    file_layout layout;
+    layout.problemOffset = aligned(sizeof(file_header));
+    layout.slotsOffset = layout.problemOffset + aligned(problemSize);
+    layout.cellsOffset = aligned(sizeof(slot_header));
+    layout.slotSize = layout.cellsOffset + aligned(rows * columns * sizeof(double));
+    layout.size = layout.slotsOffset + CHECKPOINT_SLOTS * layout.slotSize;
+    return layout;
+}
+
+/**
+ * Returns the slot 'index' of a mapped file.
+ */
+static slot_header *slotOf(unsigned char *map, const file_layout *layout, const size_t index)
+{
+    return (slot_header *) (map + layout->slotsOffset + index * layout->slotSize);
+}
+
+/**
+ * FNV-1a over the 64 bit words of a slot, from its calculation to its end.
+ * @param slot
+ * @param layout
+ * @return the checksum.
+ */
+static uint64_t checksumOf(const slot_header *slot, const file_layout *layout)
+{
+    const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+    const uint64_t FNV_PRIME = 1099511628211ULL;
+
+    const uint64_t *word = &slot->calculation;
+    const uint64_t *end = (const uint64_t *) ((const unsigned char *) slot + layout->slotSize);
+    uint64_t hash = FNV_OFFSET;
+    for (; word < end; ++word)
+    {
+        hash = (hash ^ *word) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Finds the slot of the latest complete checkpoint of a mapped file.
+ * @param map
+ * @param layout
+ * @return the slot, or NULL if none is complete.
+ */
+static slot_header *latestSlot(unsigned char *map, const file_layout *layout)
+{
+    slot_header *latest = NULL;
+    for (size_t i = 0; i < CHECKPOINT_SLOTS; ++i)
+    {
+        slot_header *slot = slotOf(map, layout, i);
+        if (slot->sequence > 0 && slot->checksum == checksumOf(slot, layout) &&
+            (latest == NULL || slot->sequence > latest->sequence))
+        {
+            latest = slot;
+        }
+    }
+    return latest;
+}
+
+/**
+ * Checks weather a mapped file of 'size' bytes holds the checkpoints of rows x columns
+ * grids of 'problem'.
+ * @return true if it does, otherwise false.
+ */
+static bool isOfProblem(const unsigned char *map, const size_t size, const size_t rows, const size_t columns,
+                        const void *problem, const size_t problemSize)
+{
+    const file_layout layout = layOut(rows, columns, problemSize);
+    const file_header *header = (const file_header *) map;
+
+    return size == layout.size && memcmp(header->magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LENGTH) == 0 &&
+           header->rows == rows && header->columns == columns && header->problemSize == problemSize &&
+           memcmp(map + layout.problemOffset, problem, problemSize) == 0;
+}
+
+/**
+ * Returns the size of the open file 'descriptor' (0 if it can't tell).
+ */
+static size_t fileSize(const int descriptor)
+{
+    struct stat status;
+    return (fstat(descriptor, &status) == 0) ? (size_t) status.st_size : 0;
+}
+
+/**
+ * Returns the seconds from 'from' to now.
+ */
+static double secondsSince(const struct timespec *from)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - from->tv_sec) + (now.tv_nsec - from->tv_nsec) * 1e-9;
+}
+
+checkpoint_file *createCheckpointFile(const char *path, const size_t rows, const size_t columns,
+                                      const void *problem, const size_t problem_size,
+                                      const unsigned int sync_seconds)
+{
+    checkpoint_file *file = malloc(sizeof(checkpoint_file));
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    file->layout = layOut(rows, columns, problem_size);
+    file->rows = rows;
+    file->columns = columns;
+    file->syncSeconds = sync_seconds;
+    file->descriptor = open(path, O_RDWR | O_CREAT, 0644);
+    if (file->descriptor < 0)
+    {
+        free(file);
+        return NULL;
+    }
+
+    // A file of another size starts over (its zeros leave both slots unfilled)
+    if (fileSize(file->descriptor) != file->layout.size &&
+        (ftruncate(file->descriptor, 0) != 0 || ftruncate(file->descriptor, (off_t) file->layout.size) != 0))
+    {
+        close(file->descriptor);
+        free(file);
+        return NULL;
+    }
+
+    file->map = mmap(NULL, file->layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, file->descriptor, 0);
+    if (file->map == MAP_FAILED)
+    {
+        close(file->descriptor);
+        free(file);
+        return NULL;
+    }
+
+    // So does one of another problem
+    if (!isOfProblem(file->map, file->layout.size, rows, columns, problem, problem_size))
+    {
+        memset(file->map, 0, file->layout.size);
+        file_header *header = (file_header *) file->map;
+        memcpy(header->magic, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LENGTH);
+        header->rows = rows;
+        header->columns = columns;
+        header->problemSize = problem_size;
+        memcpy(file->map + file->layout.problemOffset, problem, problem_size);
+    }
+
+    // The new checkpoints follow the kept ones, in the slot of the older one
+    slot_header *latest = latestSlot(file->map, &file->layout);
+    file->nextSequence = (latest != NULL) ? latest->sequence + 1 : 1;
+    file->older = (latest == slotOf(file->map, &file->layout, 0)) ? 1 : 0;
+    clock_gettime(CLOCK_MONOTONIC, &file->lastSync);
+    return file;
+}
+
+void saveCheckpoint(checkpoint_file *file, const heat_grid *grid, const unsigned int calculation,
+                    const solver_state *state)
+{
+    slot_header *slot = slotOf(file->map, &file->layout, file->older);
+    double *cells = (double *) ((unsigned char *) slot + file->layout.cellsOffset);
+
+    slot->sequence = 0; // incomplete until the checksum matches again
+    slot->calculation = calculation;
+    slot->state = *state;
+    for (size_t r = 0; r < file->rows; ++r)
+    {
+        memcpy(cells + r * file->columns, heatGridRow(grid, r), file->columns * sizeof(double));
+    }
+    slot->checksum = checksumOf(slot, &file->layout);
+    slot->sequence = file->nextSequence++;
+    file->older = (file->older + 1) % CHECKPOINT_SLOTS;
+
+    if (secondsSince(&file->lastSync) >= file->syncSeconds)
+    {
+        msync(file->map, file->layout.size, MS_SYNC);
+        clock_gettime(CLOCK_MONOTONIC, &file->lastSync);
+    }
+}
+
+bool closeCheckpointFile(checkpoint_file *file)
+{
+    if (file == NULL)
+    {
+        return true;
+    }
+
+    bool isSynced = msync(file->map, file->layout.size, MS_SYNC) == 0;
+    munmap(file->map, file->layout.size);
+    close(file->descriptor);
+    free(file);
+    return isSynced;
+}
+
+bool loadCheckpoint(const char *path, const void *problem, const size_t problem_size, heat_grid *grid,
+                    unsigned int *calculation, solver_state *state)
+{
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+
+    const file_layout layout = layOut(grid->rows, grid->columns, problem_size);
+    size_t size = fileSize(descriptor);
+    if (size != layout.size)
+    {
+        close(descriptor);
+        return false;
+    }
+
+    unsigned char *map = mmap(NULL, size, PROT_READ, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    slot_header *latest = NULL;
+    if (isOfProblem(map, size, grid->rows, grid->columns, problem, problem_size))
+    {
+        latest = latestSlot(map, &layout);
+    }
+    if (latest != NULL)
+    {
+        const double *cells = (const double *) ((const unsigned char *) latest + layout.cellsOffset);
+        for (size_t r = 0; r < grid->rows; ++r)
+        {
+            memcpy(heatGridRow(grid, r), cells + r * grid->columns, grid->columns * sizeof(double));
+        }
+        *calculation = (unsigned int) latest->calculation;
+        *state = latest->state;
+    }
+
+    munmap(map, size);
+    return latest != NULL;
+}
@@ -0,0 +1,76 @@
+/*
+ * checkpoint.h
+ *
+ *  Created on: Apr 28, 2018
+ *      Author: OWNER
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stdbool.h>
+#include "grid.h"
+
+/**
+ * What the calculator needs besides the grid to go on with a calculation from
+ * the pass 'pass' exactly as if it never stopped: the sum after that pass, the
+ * monitor of the latest checked pass & the over-relaxation's state.
+ */
+typedef struct
+{
+	unsigned int pass;
+	double sum;
+	double monitor;
+	bool isRateKnown, isAdapting;
+	double rate;
+	unsigned int relaxedHalfPasses;
+	double relaxation;
+	unsigned int estimatePasses;
+	double lastUpdate, lastEstimate;
+} solver_state;
+
+/**
+ * A state file mapped into memory: a header with the problem (the bytes which
+ * identify the calculations - their parameters & sources), and two slots which
+ * take the checkpoints in turn, so the latest complete one survives a checkpoint
+ * cut in the middle. A slot holds a sequence number, a checksum, the number of
+ * the calculation (of the caller's runs), its solver_state & the cells.
+ * A checkpoint is a copy into the mapping - the system writes it back by itself,
+ * so a killed process loses nothing - and the mapping is synced to the disk (against
+ * a crash of the machine) at most once every 'sync_seconds', which bounds its cost.
+ * The file is in the machine's byte order, for the build which wrote it.
+ */
+typedef struct checkpoint_file checkpoint_file;
+
+/**
+ * Maps the file 'path' for the checkpoints of rows x columns grids of 'problem'.
+ * A file of the same problem keeps its checkpoints (which the new ones follow);
+ * any other is overwritten.
+ * @return the file, or NULL if it could not be opened, sized or mapped.
+ */
+checkpoint_file *createCheckpointFile(const char *path, size_t rows, size_t columns, const void *problem,
+		size_t problem_size, unsigned int sync_seconds);
+
+/**
+ * Takes a checkpoint of 'grid' (of the file's size) after the pass state->pass of
+ * the calculation 'calculation': fills the older slot & then marks it the latest.
+ */
+void saveCheckpoint(checkpoint_file *file, const heat_grid *grid, unsigned int calculation,
+		const solver_state *state);
+
+/**
+ * Syncs the latest checkpoint, unmaps & closes the file (NULL is allowed).
+ * @return true on success, false if the sync failed.
+ */
+bool closeCheckpointFile(checkpoint_file *file);
+
+/**
+ * Reads the latest complete checkpoint of the file 'path' into 'grid' (of the
+ * problem's size) & the state.
+ * @return true on success, false if the file could not be read, is of another
+ * problem or size, or holds no complete checkpoint.
+ */
+bool loadCheckpoint(const char *path, const void *problem, size_t problem_size, heat_grid *grid,
+		unsigned int *calculation, solver_state *state);
+
+#endif /* CHECKPOINT_H_ */
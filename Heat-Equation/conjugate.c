@@ -0,0 +1,428 @@
+/**
+ * @author Roy Ackerman
+ */
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "conjugate.h"
+#include "heat_eqn.h"
+
+/**
+ * The weight of a neighbour in heat_eqn's equation of a cell.
+ */
+#define NEIGHBOUR_WEIGHT 0.25
+
+/**
+ * Sets the sources of the row r of 'vector' to 0.
+ * @param cg
+ * @param vector
+ * @param r
+ */
+static void clearSources(const conjugate_gradient *cg, heat_grid *vector, const size_t r)
+{
+    double *cells = heatGridRow(vector, r);
+    for (size_t i = cg->sourceRowStart[r]; i < cg->sourceRowStart[r + 1]; ++i)
+    {
+        cells[cg->sourceColumns[i]] = 0;
+    }
+}
+
+/**
+ * Sets the whole of 'vector' (with its halo) to 0.
+ * @param cg
+ * @param vector
+ */
+static void clearVector(const conjugate_gradient *cg, heat_grid *vector)
+{
+    for (ptrdiff_t r = -1; r <= (ptrdiff_t) cg->rows; ++r)
+    {
+        memset(heatGridRow(vector, r) - 1, 0, (cg->columns + 2) * sizeof(double));
+    }
+}
+
+/**
+ * Refreshes the halo of 'vector' from the wrapped-around cells if the grid is cyclic
+ * (otherwise the halo stays 0).
+ * @param cg
+ * @param vector
+ */
+static void refreshHalo(const conjugate_gradient *cg, heat_grid *vector)
+{
+    if (cg->isCyclic)
+    {
+        wrapHeatGridHalo(vector);
+    }
+}
+
+/**
+ * Sets the residual to b - A * grid: the change of heat_eqn at every free cell.
+ * @param cg
+ * @param grid
+ */
+static void computeResidual(conjugate_gradient *cg, heat_grid *grid)
+{
+    refreshHalo(cg, grid);
+    for (size_t r = 0; r < cg->rows; ++r)
+    {
+        const double *cells = heatGridRow(grid, r);
+        const double *up = heatGridRow(grid, r + 1);
+        const double *down = heatGridRow(grid, (ptrdiff_t) r - 1);
+        double *residual = heatGridRow(&cg->residual, r);
+        for (size_t col = 0; col < cg->columns; ++col)
+        {
+            residual[col] = HEAT_EQN(cells[col], cells[col + 1], up[col], cells[col - 1], down[col]) - cells[col];
+        }
+        clearSources(cg, &cg->residual, r);
+    }
+}
+
+/**
+ * Sets the product to A * direction.
+ * @param cg
+ */
+static void applyOperator(conjugate_gradient *cg)
+{
+    refreshHalo(cg, &cg->direction);
+    for (size_t r = 0; r < cg->rows; ++r)
+    {
+        const double *cells = heatGridRow(&cg->direction, r);
+        const double *up = heatGridRow(&cg->direction, r + 1);
+        const double *down = heatGridRow(&cg->direction, (ptrdiff_t) r - 1);
+        double *product = heatGridRow(&cg->product, r);
+        for (size_t col = 0; col < cg->columns; ++col)
+        {
+            product[col] = cells[col] - HEAT_EQN(cells[col], cells[col + 1], up[col], cells[col - 1], down[col]);
+        }
+        clearSources(cg, &cg->product, r);
+    }
+}
+
+/**
+ * Returns the dot product of two vectors.
+ * @param cg
+ * @param first
+ * @param second
+ */
+static double dot(const conjugate_gradient *cg, const heat_grid *first, const heat_grid *second)
+{
+    double sum = 0;
+    for (size_t r = 0; r < cg->rows; ++r)
+    {
+        const double *a = heatGridRow(first, r);
+        const double *b = heatGridRow(second, r);
+        for (size_t col = 0; col < cg->columns; ++col)
+        {
+            sum += a[col] * b[col];
+        }
+    }
+    return sum;
+}
+
+/**
+ * Sets 'vector' to vector + factor * 'added' (or, if isScaled, to added + factor * vector).
+ * @param cg
+ * @param vector
+ * @param factor
+ * @param added
+ * @param isScaled
+ */
+static void combine(const conjugate_gradient *cg, heat_grid *vector, const double factor, const heat_grid *added,
+                    const bool isScaled)
+{
+    for (size_t r = 0; r < cg->rows; ++r)
+    {
+        double *cells = heatGridRow(vector, r);
+        const double *other = heatGridRow(added, r);
+        for (size_t col = 0; col < cg->columns; ++col)
+        {
+            cells[col] = isScaled ? other[col] + factor * cells[col] : cells[col] + factor * other[col];
+        }
+    }
+}
+
+/**
+ * Returns the 'monitor' norm of the residual (l1 for the sum monitor: the sum
+ * of a nearly solved grid's residual may cancel out long before the grid is solved).
+ * @param cg
+ * @param monitor
+ */
+static double residualNorm(const conjugate_gradient *cg, const convergence_monitor monitor)
+{
+    double norm = 0;
+    for (size_t r = 0; r < cg->rows; ++r)
+    {
+        const double *residual = heatGridRow(&cg->residual, r);
+        double rowNorm = 0;
+        switch (monitor)
+        {
+            case MONITOR_L2:
+                for (size_t col = 0; col < cg->columns; ++col)
+                {
+                    rowNorm += residual[col] * residual[col];
+                }
+                norm += rowNorm;
+                break;
+            case MONITOR_MAX:
+                for (size_t col = 0; col < cg->columns; ++col)
+                {
+                    rowNorm = fmax(rowNorm, fabs(residual[col]));
+                }
+                norm = fmax(norm, rowNorm);
+                break;
+            default:
+                for (size_t col = 0; col < cg->columns; ++col)
+                {
+                    rowNorm += fabs(residual[col]);
+                }
+                norm += rowNorm;
+        }
+    }
+    return (monitor == MONITOR_L2) ? sqrt(norm) : norm;
+}
+
+/**
+ * Relaxes the free cells [from, to) of the row r of 'out', left to right or
+ * (if isBackwards) right to left: cell = omega * (scale * in + neighbours / 4).
+ * Only the neighbour relaxed right before a cell depends on the previous step,
+ * so the rest of the sum is taken apart from it.
+ * @param out
+ * @param in
+ * @param r
+ * @param from
+ * @param to
+ * @param scale
+ * @param omega
+ * @param isBackwards
+ */
+static void relaxCells(heat_grid *out, const heat_grid *in, const size_t r, const size_t from, const size_t to,
+                       const double scale, const double omega, const bool isBackwards)
+{
+    double *cells = heatGridRow(out, r);
+    const double *up = heatGridRow(out, r + 1);
+    const double *down = heatGridRow(out, (ptrdiff_t) r - 1);
+    const double *values = heatGridRow(in, r);
+    const double weight = omega * NEIGHBOUR_WEIGHT;
+    const double valueWeight = omega * scale;
+
+    if (isBackwards)
+    {
+        for (size_t col = to; col-- > from;)
+        {
+            double rest = valueWeight * values[col] + weight * (cells[col - 1] + (up[col] + down[col]));
+            cells[col] = rest + weight * cells[col + 1];
+        }
+    }
+    else
+    {
+        for (size_t col = from; col < to; ++col)
+        {
+            double rest = valueWeight * values[col] + weight * (cells[col + 1] + (up[col] + down[col]));
+            cells[col] = rest + weight * cells[col - 1];
+        }
+    }
+}
+
+/**
+ * Relaxes the free cells of the row r of 'out' (the segments between its
+ * sources), left to right or (if isBackwards) right to left. The neighbours
+ * which weren't relaxed yet are still 0, so a sweep over the rows in the same
+ * order solves a triangular half of SSOR's preconditioner. When cyclic, the
+ * first cell relaxed is copied to the halo cell which the last one reads it from.
+ * @param cg
+ * @param out
+ * @param in
+ * @param scale
+ * @param r
+ * @param isBackwards
+ */
+static void relaxRow(const conjugate_gradient *cg, heat_grid *out, const heat_grid *in, const double scale,
+                     const size_t r, const bool isBackwards)
+{
+    const size_t *sources = cg->sourceColumns + cg->sourceRowStart[r];
+    const size_t numOfSources = cg->sourceRowStart[r + 1] - cg->sourceRowStart[r];
+    double *cells = heatGridRow(out, r);
+
+    for (size_t k = 0; k <= numOfSources; ++k)
+    {
+        size_t i = isBackwards ? numOfSources - k : k; // the segment before the source i
+        size_t from = (i > 0) ? sources[i - 1] + 1 : 0;
+        size_t to = (i < numOfSources) ? sources[i] : cg->columns;
+        bool isFirst = isBackwards ? to == cg->columns : from == 0;
+
+        if (isFirst && from < to && cg->isCyclic)
+        {
+            // relax the row's end cell alone & wrap it, since the other end reads it
+            size_t end = isBackwards ? to - 1 : from;
+            relaxCells(out, in, r, end, end + 1, scale, cg->omega, isBackwards);
+            cells[isBackwards ? -1 : (ptrdiff_t) cg->columns] = cells[end];
+            from = isBackwards ? from : from + 1;
+            to = isBackwards ? to - 1 : to;
+        }
+        relaxCells(out, in, r, from, to, scale, cg->omega, isBackwards);
+    }
+}
+
+/**
+ * Sets the preconditioned residual to M^-1 * residual. Jacobi's M is A's
+ * diagonal D, which for heat_eqn is 1 (so it's plain CG); SSOR's is
+ * omega / (2 - omega) * (D / omega + L) * D^-1 * (D / omega + U), where L & U
+ * are A's weights of the cells before & after a cell in the order of the rows,
+ * i.e. a forward sweep & a backward one.
+ * @param cg
+ */
+static void precondition(conjugate_gradient *cg)
+{
+    const double DIAGONAL = 1;
+    const ptrdiff_t FIRST = 0;
+
+    if (cg->preconditioner == PRECONDITIONER_JACOBI)
+    {
+        for (size_t r = 0; r < cg->rows; ++r)
+        {
+            const double *residual = heatGridRow(&cg->residual, r);
+            double *preconditioned = heatGridRow(&cg->preconditioned, r);
+            for (size_t col = 0; col < cg->columns; ++col)
+            {
+                preconditioned[col] = residual[col] / DIAGONAL;
+            }
+        }
+        return;
+    }
+
+    // (D / omega + L) * forward = residual; when cyclic, the last row reads the first above it
+    const ptrdiff_t last = (ptrdiff_t) cg->rows - 1;
+    clearVector(cg, &cg->forward);
+    for (ptrdiff_t r = FIRST; r <= last; ++r)
+    {
+        relaxRow(cg, &cg->forward, &cg->residual, 1, (size_t) r, false);
+        if (r == FIRST && cg->isCyclic)
+        {
+            memcpy(heatGridRow(&cg->forward, last + 1), heatGridRow(&cg->forward, r), cg->columns * sizeof(double));
+        }
+    }
+
+    // (D / omega + U) * preconditioned = (2 - omega) / omega * D * forward; the first row reads the last below it
+    const double scale = (2 - cg->omega) / cg->omega * DIAGONAL;
+    clearVector(cg, &cg->preconditioned);
+    for (ptrdiff_t r = last; r >= FIRST; --r)
+    {
+        relaxRow(cg, &cg->preconditioned, &cg->forward, scale, (size_t) r, true);
+        if (r == last && cg->isCyclic)
+        {
+            memcpy(heatGridRow(&cg->preconditioned, FIRST - 1), heatGridRow(&cg->preconditioned, r),
+                   cg->columns * sizeof(double));
+        }
+    }
+}
+
+/**
+ * Restarts the iterations from 'grid': its residual & the first direction.
+ * @param cg
+ * @param grid
+ * @return residual * M^-1 * residual.
+ */
+static double restart(conjugate_gradient *cg, heat_grid *grid)
+{
+    computeResidual(cg, grid);
+    precondition(cg);
+    for (size_t r = 0; r < cg->rows; ++r)
+    {
+        memcpy(heatGridRow(&cg->direction, r), heatGridRow(&cg->preconditioned, r), cg->columns * sizeof(double));
+    }
+    return dot(cg, &cg->residual, &cg->preconditioned);
+}
+
+/**
+ * Solves for the steady state of 'grid' by preconditioned conjugate gradients.
+ * The residual is updated by the iterations (which drifts from the true one),
+ * so once it's small enough the true one is computed, and the iterations
+ * restart from it unless it's small enough too - or no smaller than at the
+ * previous restart by STAGNATION, i.e. rounding keeps it from ever being.
+ * @param cg
+ * @param grid
+ * @param monitor
+ * @param tolerance
+ * @return the number of iterations.
+ */
+unsigned int solveByConjugateGradient(conjugate_gradient *cg, heat_grid *grid, const convergence_monitor monitor,
+                                      const double tolerance)
+{
+    const unsigned int ITERATIONS_PER_CELL_OF_SIDE = 20;
+    const double STAGNATION = 0.5;
+
+    unsigned int maxIterations = ITERATIONS_PER_CELL_OF_SIDE * (unsigned int) (cg->rows + cg->columns);
+    unsigned int iteration = 0;
+    double product = restart(cg, grid); // residual * preconditioned
+    double trueNorm = residualNorm(cg, monitor);
+
+    while (iteration < maxIterations && product > 0 && trueNorm >= tolerance)
+    {
+        if (residualNorm(cg, monitor) < tolerance)
+        {
+            double previousNorm = trueNorm;
+            product = restart(cg, grid);
+            trueNorm = residualNorm(cg, monitor);
+            if (trueNorm < tolerance || trueNorm > STAGNATION * previousNorm)
+            {
+                break;
+            }
+        }
+
+        applyOperator(cg);
+        double step = product / dot(cg, &cg->direction, &cg->product);
+        combine(cg, grid, step, &cg->direction, false);
+        combine(cg, &cg->residual, -step, &cg->product, false);
+        precondition(cg);
+
+        double nextProduct = dot(cg, &cg->residual, &cg->preconditioned);
+        combine(cg, &cg->direction, nextProduct / product, &cg->preconditioned, true);
+        product = nextProduct;
+        ++iteration;
+    }
+
+    return iteration;
+}
+
+/**
+ * Allocates the solver's buffers.
+ * @return true on success, false (with nothing allocated) otherwise.
+ */
+bool createConjugateGradient(conjugate_gradient *cg, const size_t rows, const size_t columns,
+                             const size_t *sourceRowStart, const size_t *sourceColumns, const int is_cyclic,
+                             const preconditioner_kind preconditioner, const double omega)
+{
+    const heat_grid NONE = {NULL, 0, 0, 0};
+
+    cg->residual = cg->direction = cg->product = cg->preconditioned = cg->forward = NONE;
+    cg->rows = rows;
+    cg->columns = columns;
+    cg->sourceRowStart = sourceRowStart;
+    cg->sourceColumns = sourceColumns;
+    cg->isCyclic = is_cyclic;
+    cg->preconditioner = preconditioner;
+    cg->omega = omega;
+
+    bool isSsor = preconditioner == PRECONDITIONER_SSOR;
+    if (!createHeatGrid(&cg->residual, rows, columns) || !createHeatGrid(&cg->direction, rows, columns) ||
+        !createHeatGrid(&cg->product, rows, columns) || !createHeatGrid(&cg->preconditioned, rows, columns) ||
+        (isSsor && !createHeatGrid(&cg->forward, rows, columns)))
+    {
+        freeConjugateGradient(cg);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Frees the solver's buffers.
+ * @param cg
+ */
+void freeConjugateGradient(conjugate_gradient *cg)
+{
+    freeHeatGrid(&cg->residual);
+    freeHeatGrid(&cg->direction);
+    freeHeatGrid(&cg->product);
+    freeHeatGrid(&cg->preconditioned);
+    freeHeatGrid(&cg->forward);
+}
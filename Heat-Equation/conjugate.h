@@ -0,0 +1,61 @@
+/*
+ * conjugate.h
+ *
+ *  Created on: Apr 24, 2018
+ *      Author: OWNER
+ */
+
+#ifndef CONJUGATE_H_
+#define CONJUGATE_H_
+
+#include <stdbool.h>
+#include "calculator.h"
+
+/**
+ * The buffers of a preconditioned conjugate gradient solve of heat_eqn's steady
+ * state on a rows x columns grid: cell = (right + top + left + bottom) / 4 at
+ * every cell which isn't a source, i.e. A * grid = b where A is 1 on the
+ * diagonal & -1/4 for every neighbour, and the sources (with the 0 boundary of
+ * a non-cyclic grid) are eliminated into b as fixed values.
+ * Every vector is 0 at the sources, so the products need no special cases.
+ */
+typedef struct
+{
+	heat_grid residual; // b - A * grid
+	heat_grid direction;
+	heat_grid product; // A * direction
+	heat_grid preconditioned; // M^-1 * residual
+	heat_grid forward; // SSOR's forward sweep
+	size_t rows, columns;
+	const size_t *sourceRowStart; // row r's sources are sourceColumns[sourceRowStart[r] .. sourceRowStart[r + 1])
+	const size_t *sourceColumns;
+	int isCyclic;
+	preconditioner_kind preconditioner;
+	double omega; // of SSOR
+} conjugate_gradient;
+
+/**
+ * Allocates the buffers of a rows x columns grid whose (sorted, distinct)
+ * sources are indexed like the calculator's (the index is kept, not copied).
+ * @return true on success, false (with nothing allocated) otherwise.
+ */
+bool createConjugateGradient(conjugate_gradient *cg, size_t rows, size_t columns, const size_t *sourceRowStart,
+		const size_t *sourceColumns, int is_cyclic, preconditioner_kind preconditioner, double omega);
+
+/**
+ * Frees the buffers (safe to call on a solver which was never created).
+ */
+void freeConjugateGradient(conjugate_gradient *cg);
+
+/**
+ * Solves for the steady state of 'grid', starting from its cells, until the
+ * 'monitor' norm of the residual (which is the update a Jacobi pass would make;
+ * the sum monitor uses its l1 norm) is below 'tolerance', until rounding keeps
+ * it from getting there, or until a number of iterations which grows with the grid's size.
+ * The halo of a non-cyclic grid must be 0.
+ * @return the number of iterations.
+ */
+unsigned int solveByConjugateGradient(conjugate_gradient *cg, heat_grid *grid, convergence_monitor monitor,
+		double tolerance);
+
+#endif /* CONJUGATE_H_ */
@@ -0,0 +1,864 @@
+/**
+ * @author Roy Ackerman
+ */
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "distributed.h"
+#include "kernels.h"
+#include "measures.h"
+
+/**
+ * The dimensions of the process grid.
+ */
+#define ROWS 0
+#define COLUMNS 1
+#define DIMENSIONS 2
+
+/**
+ * The halo sides of a block; a message which fills a halo is tagged by its side.
+ * HALO_ABOVE - the row -1, HALO_BELOW - the row 'rows', HALO_LEFT - the column -1,
+ * HALO_RIGHT - the column 'columns'.
+ */
+typedef enum
+{
+    HALO_ABOVE,
+    HALO_BELOW,
+    HALO_LEFT,
+    HALO_RIGHT,
+    NUM_OF_SIDES
+} halo_side;
+
+/**
+ * What a block contributes to the reduction of a pass.
+ */
+typedef struct
+{
+    compensated_sum sum;
+    update_norms norms;
+} block_measures;
+
+static MPI_Comm gCart; // the processes holding blocks (MPI_COMM_NULL at the others)
+static int gDims[DIMENSIONS];
+static int gCoords[DIMENSIONS];
+static int gNeighbours[NUM_OF_SIDES]; // by halo_side (MPI_PROC_NULL out of a non-cyclic grid)
+static int gIs_cyclic;
+static size_t gFirstRow; // the block's first cell in the grid
+static size_t gFirstColumn;
+static size_t gRows; // of the block
+static size_t gColumns;
+static heat_grid gBlock;
+static heat_grid gScratch; // the second buffer of the Jacobi sweep
+static heat_grid *gCurrent; // the block holding the latest pass (gBlock or gScratch)
+static MPI_Datatype gRowType; // a row of the block (without its halo cells)
+static MPI_Datatype gColumnType; // a column of the block, a stride between every two cells
+static size_t *gSourceRowStart; // row r's sources are gSourceColumns[gSourceRowStart[r] .. gSourceRowStart[r + 1])
+static size_t *gSourceColumns;
+static stencil_kernel gKernel;
+static solver_options gOptions;
+static compensated_sum *gRowSums; // the sum of every row after the latest pass
+static update_norms *gRowNorms; // the norms of the latest pass's update of every row
+static double *gOldRow; // the row before the pass, for measuring the update
+static block_measures *gAllMeasures; // of every block, by rank
+static bool gTrackSum; // the current pass sums its rows
+static bool gTrackNorms; // the current pass measures its update
+
+/**
+ * Returns the first of the 'parts' even parts of 'length' (part 'parts' is one past the end).
+ * @param length
+ * @param parts
+ * @param part
+ */
+static size_t partStart(const size_t length, const int parts, const int part)
+{
+    return length * (size_t) part / (size_t) parts;
+}
+
+/**
+ * Chooses the process grid: the most processes whose blocks have a cell at
+ * least, and of those the one with the shortest block sides (the least halo).
+ * @param processes
+ * @param rows of the grid
+ * @param columns of the grid
+ * @param dims output parameter: the processes along the rows & along the columns.
+ */
+static void chooseDims(const int processes, const size_t rows, const size_t columns, int dims[])
+{
+    double bestSides = HUGE_VAL;
+    dims[ROWS] = dims[COLUMNS] = 1;
+
+    for (int across = 1; across <= processes && (size_t) across <= rows; ++across)
+    {
+        int along = processes / across;
+        if ((size_t) along > columns)
+        {
+            along = (int) columns;
+        }
+
+        double sides = (double) rows / across + (double) columns / along;
+        if (across * along > dims[ROWS] * dims[COLUMNS] ||
+            (across * along == dims[ROWS] * dims[COLUMNS] && sides < bestSides))
+        {
+            dims[ROWS] = across;
+            dims[COLUMNS] = along;
+            bestSides = sides;
+        }
+    }
+}
+
+/**
+ * Returns the halo side facing 'side' across the border of two blocks.
+ * @param side
+ */
+static halo_side oppositeSide(const halo_side side)
+{
+    const halo_side OPPOSITES[] = {HALO_BELOW, HALO_ABOVE, HALO_RIGHT, HALO_LEFT}; // by halo_side
+    return OPPOSITES[side];
+}
+
+/**
+ * Returns the first cell of the halo 'side' of 'block'.
+ * @param block
+ * @param side
+ */
+static double *haloStart(const heat_grid *block, const halo_side side)
+{
+    switch (side)
+    {
+        case HALO_ABOVE:
+            return heatGridRow(block, -1);
+        case HALO_BELOW:
+            return heatGridRow(block, (ptrdiff_t) gRows);
+        case HALO_LEFT:
+            return heatGridRow(block, 0) - 1;
+        default:
+            return heatGridRow(block, 0) + gColumns;
+    }
+}
+
+/**
+ * Returns the first cell of the edge of 'block' which lies next to its halo 'side'
+ * (the cells the neighbour on that side reads as its own halo).
+ * @param block
+ * @param side
+ */
+static double *edgeStart(const heat_grid *block, const halo_side side)
+{
+    switch (side)
+    {
+        case HALO_ABOVE:
+            return heatGridRow(block, 0);
+        case HALO_BELOW:
+            return heatGridRow(block, (ptrdiff_t) gRows - 1);
+        case HALO_LEFT:
+            return heatGridRow(block, 0);
+        default:
+            return heatGridRow(block, 0) + gColumns - 1;
+    }
+}
+
+/**
+ * Returns the type of the halo 'side' (and of the edge next to it).
+ * @param side
+ */
+static MPI_Datatype lineType(const halo_side side)
+{
+    return (side == HALO_ABOVE || side == HALO_BELOW) ? gRowType : gColumnType;
+}
+
+/**
+ * Starts receiving the halo 'side' of 'block' from the neighbour on that side.
+ * @param block
+ * @param side
+ * @param request output parameter
+ */
+static void receiveHalo(heat_grid *block, const halo_side side, MPI_Request *request)
+{
+    MPI_Irecv(haloStart(block, side), 1, lineType(side), gNeighbours[side], side, gCart, request);
+}
+
+/**
+ * Starts sending the edge next to the halo 'side' of 'block' to the neighbour
+ * on that side, where it's the opposite halo.
+ * @param block
+ * @param side
+ * @param request output parameter
+ */
+static void sendEdge(const heat_grid *block, const halo_side side, MPI_Request *request)
+{
+    MPI_Isend(edgeStart(block, side), 1, lineType(side), gNeighbours[side], oppositeSide(side), gCart, request);
+}
+
+/**
+ * Exchanges the whole halo ring of 'block' with the neighbours: afterwards every
+ * halo cell holds the neighbour's cell as it is now (0 out of a non-cyclic grid).
+ * @param block
+ */
+static void exchangeHalos(heat_grid *block)
+{
+    MPI_Request requests[2 * NUM_OF_SIDES];
+
+    for (int side = HALO_ABOVE; side < NUM_OF_SIDES; ++side)
+    {
+        receiveHalo(block, (halo_side) side, &requests[side]);
+        sendEdge(block, (halo_side) side, &requests[NUM_OF_SIDES + side]);
+    }
+    MPI_Waitall(2 * NUM_OF_SIDES, requests, MPI_STATUSES_IGNORE);
+}
+
+/**
+ * Sums the row r of 'block' into gRowSums[r].
+ * @param block
+ * @param r
+ */
+static void sumRow(const heat_grid *block, const size_t r)
+{
+    const double *cells = heatGridRow(block, r);
+    compensated_sum sum = {0, 0};
+    for (size_t col = 0; col < gColumns; ++col)
+    {
+        addCompensated(&sum, cells[col]);
+    }
+    gRowSums[r] = sum;
+}
+
+/**
+ * Adds the changes of the row r from 'old' to 'updated' into gRowNorms[r].
+ * @param updated the row after (a part of) the pass
+ * @param old the row before it
+ * @param r
+ */
+static void measureRow(const double *updated, const double *old, const size_t r)
+{
+    update_norms norms = gRowNorms[r];
+    for (size_t col = 0; col < gColumns; ++col)
+    {
+        double change = fabs(updated[col] - old[col]);
+        norms.l1 += change;
+        norms.l2 += change * change;
+        norms.max = (change > norms.max) ? change : norms.max;
+    }
+    gRowNorms[r] = norms;
+}
+
+/**
+ * Measures the row r of 'block', which the current pass has just finished.
+ * @param block
+ * @param r
+ * @param old the row before the pass (unused unless the norms are tracked)
+ */
+static void finishRow(const heat_grid *block, const size_t r, const double *old)
+{
+    if (gTrackSum)
+    {
+        sumRow(block, r);
+    }
+    if (gTrackNorms)
+    {
+        measureRow(heatGridRow(block, r), old, r);
+    }
+}
+
+/**
+ * activates the kernel 'kernel' on the cells [from, to) of the block's row r,
+ * skipping the row's sources (like the calculator's activateRow).
+ * @param kernel
+ * @param cells the block to read
+ * @param next the block to write
+ * @param r the row
+ * @param from the first column
+ * @param to one past the last column
+ */
+static void activateRow(const row_kernel kernel, const heat_grid *cells, heat_grid *next,
+                        const size_t r, size_t from, const size_t to)
+{
+    double *out = heatGridRow(next, r);
+    const double *in = heatGridRow(cells, r);
+    const double *up = heatGridRow(cells, r + 1);
+    const double *down = heatGridRow(cells, (ptrdiff_t) r - 1);
+
+    for (size_t i = gSourceRowStart[r]; i < gSourceRowStart[r + 1] && from < to; ++i)
+    {
+        size_t source = gSourceColumns[i];
+        if (source >= from)
+        {
+            kernel(out, in, up, down, from, source < to ? source : to, &gKernel.params);
+            from = source + 1;
+        }
+    }
+    kernel(out, in, up, down, from, to, &gKernel.params);
+}
+
+/**
+ * Checks weather the edge next to the halo 'side' is sent to its neighbour
+ * after the Gauss-Seidel pass (the neighbour reads it updated) rather than before
+ * it. The cells before a cell in the order of the grid's rows are updated, so a
+ * block's upper & left neighbours read its old edges, unless they only neighbour
+ * it across the wrap-around of a cyclic grid, and the other way round.
+ * @param side
+ */
+static bool isSentUpdated(const halo_side side)
+{
+    switch (side)
+    {
+        case HALO_ABOVE:
+            return gCoords[ROWS] == 0;
+        case HALO_BELOW:
+            return gCoords[ROWS] < gDims[ROWS] - 1;
+        case HALO_LEFT:
+            return gCoords[COLUMNS] == 0;
+        default:
+            return gCoords[COLUMNS] < gDims[COLUMNS] - 1;
+    }
+}
+
+/**
+ * Checks weather the block wraps around its own halo 'side': a cyclic grid with
+ * a single process along that side's dimension.
+ * @param side
+ */
+static bool isWrappedLocally(const halo_side side)
+{
+    int dimension = (side == HALO_ABOVE || side == HALO_BELOW) ? ROWS : COLUMNS;
+    return gIs_cyclic && gDims[dimension] == 1;
+}
+
+/**
+ * Exchanges the edges of a Gauss-Seidel pass which are sent either before or
+ * after it, and (before it) receives the whole halo ring: the halos which read
+ * updated cells arrive once the blocks before this one have passed. The sides
+ * wrapped locally are left to the pass.
+ * @param isAfter
+ */
+static void exchangeGaussSeidelEdges(const bool isAfter)
+{
+    MPI_Request requests[2 * NUM_OF_SIDES];
+    int count = 0;
+
+    for (int side = HALO_ABOVE; side < NUM_OF_SIDES; ++side)
+    {
+        if (isWrappedLocally((halo_side) side))
+        {
+            continue;
+        }
+        if (!isAfter)
+        {
+            receiveHalo(gCurrent, (halo_side) side, &requests[count++]);
+        }
+        if (isSentUpdated((halo_side) side) == isAfter)
+        {
+            sendEdge(gCurrent, (halo_side) side, &requests[count++]);
+        }
+    }
+    MPI_Waitall(count, requests, MPI_STATUSES_IGNORE);
+}
+
+/**
+ * A Gauss-Seidel pass over the block, once the blocks before it have passed
+ * (see exchangeGaussSeidelEdges). A side wrapped locally is refreshed right
+ * before it is read, like the calculator's cyclic pass.
+ */
+static void gaussSeidel()
+{
+    const size_t FIRST = 0;
+
+    exchangeGaussSeidelEdges(false);
+
+    bool wrapsRows = isWrappedLocally(HALO_ABOVE);
+    bool wrapsColumns = isWrappedLocally(HALO_LEFT);
+    if (wrapsRows)
+    {
+        memcpy(heatGridRow(&gBlock, -1), heatGridRow(&gBlock, (ptrdiff_t) gRows - 1), gColumns * sizeof(double));
+        memcpy(heatGridRow(&gBlock, (ptrdiff_t) gRows), heatGridRow(&gBlock, FIRST), gColumns * sizeof(double));
+    }
+
+    for (size_t r = 0; r < gRows; r++)
+    {
+        if (gTrackNorms)
+        {
+            memcpy(gOldRow, heatGridRow(&gBlock, r), gColumns * sizeof(double));
+        }
+
+        if (wrapsColumns)
+        {
+            double *cells = heatGridRow(&gBlock, r);
+            cells[-1] = cells[gColumns - 1];
+            cells[gColumns] = cells[FIRST];
+            activateRow(gKernel.row, &gBlock, &gBlock, r, FIRST, FIRST + 1);
+            cells[gColumns] = cells[FIRST];
+            activateRow(gKernel.row, &gBlock, &gBlock, r, FIRST + 1, gColumns);
+        }
+        else
+        {
+            activateRow(gKernel.row, &gBlock, &gBlock, r, FIRST, gColumns);
+        }
+        if (wrapsRows && r == FIRST)
+        {
+            memcpy(heatGridRow(&gBlock, (ptrdiff_t) gRows), heatGridRow(&gBlock, FIRST), gColumns * sizeof(double));
+        }
+        finishRow(&gBlock, r, gOldRow);
+    }
+
+    exchangeGaussSeidelEdges(true);
+}
+
+/**
+ * A Jacobi pass over the block: exchanges the halos of the latest pass, then
+ * calculates the next one into the other buffer.
+ */
+static void jacobi()
+{
+    heat_grid *next = (gCurrent == &gBlock) ? &gScratch : &gBlock;
+
+    exchangeHalos(gCurrent);
+    for (size_t r = 0; r < gRows; r++)
+    {
+        activateRow(gKernel.jacobi, gCurrent, next, r, 0, gColumns);
+        finishRow(next, r, heatGridRow(gCurrent, r));
+    }
+    gCurrent = next;
+}
+
+/**
+ * A red-black pass over the block, exchanging the halos before every colour.
+ * The colour of a cell is the parity of its row + column in the grid.
+ */
+static void redBlack()
+{
+    const size_t RED = 0;
+    const size_t BLACK = 1;
+
+    for (size_t color = RED; color <= BLACK; ++color)
+    {
+        exchangeHalos(&gBlock);
+        for (size_t r = 0; r < gRows; ++r)
+        {
+            double *cells = heatGridRow(&gBlock, r);
+            const double *up = heatGridRow(&gBlock, r + 1);
+            const double *down = heatGridRow(&gBlock, (ptrdiff_t) r - 1);
+            size_t from = 0;
+
+            if (gTrackNorms)
+            {
+                memcpy(gOldRow, cells, gColumns * sizeof(double));
+            }
+            for (size_t i = gSourceRowStart[r]; i <= gSourceRowStart[r + 1]; ++i)
+            {
+                size_t to = (i < gSourceRowStart[r + 1]) ? gSourceColumns[i] : gColumns;
+                size_t first = from + ((gFirstRow + r + gFirstColumn + from + color) % 2);
+                gKernel.redBlack(cells, cells, up, down, first, to, &gKernel.params);
+                from = to + 1;
+            }
+            if (color == BLACK)
+            {
+                finishRow(&gBlock, r, gOldRow); // the row is final
+            }
+            else if (gTrackNorms)
+            {
+                measureRow(cells, gOldRow, r);
+            }
+        }
+    }
+}
+
+/**
+ * Reduces the measures of the latest pass over all the blocks, combining them in
+ * the order of the ranks (so every rank gets the very same result).
+ * @param sum output parameter: the heat sum of the grid (if tracked).
+ * @param norms output parameter: the norms of the pass's update (if tracked).
+ */
+static void reduceMeasures(double *sum, update_norms *norms)
+{
+    const int MEASURE_DOUBLES = sizeof(block_measures) / sizeof(double);
+
+    block_measures block = {{0, 0}, {0, 0, 0}};
+    for (size_t r = 0; r < gRows; ++r)
+    {
+        if (gTrackSum)
+        {
+            addCompensated(&block.sum, gRowSums[r].sum);
+            addCompensated(&block.sum, gRowSums[r].compensation);
+        }
+        if (gTrackNorms)
+        {
+            block.norms.l1 += gRowNorms[r].l1;
+            block.norms.l2 += gRowNorms[r].l2;
+            block.norms.max = (gRowNorms[r].max > block.norms.max) ? gRowNorms[r].max : block.norms.max;
+        }
+    }
+
+    MPI_Allgather(&block, MEASURE_DOUBLES, MPI_DOUBLE, gAllMeasures, MEASURE_DOUBLES, MPI_DOUBLE, gCart);
+
+    compensated_sum total = {0, 0};
+    update_norms totalNorms = {0, 0, 0};
+    for (int i = 0; i < gDims[ROWS] * gDims[COLUMNS]; ++i)
+    {
+        const block_measures *measures = &gAllMeasures[i];
+        addCompensated(&total, measures->sum.sum);
+        addCompensated(&total, measures->sum.compensation);
+        totalNorms.l1 += measures->norms.l1;
+        totalNorms.l2 += measures->norms.l2;
+        totalNorms.max = (measures->norms.max > totalNorms.max) ? measures->norms.max : totalNorms.max;
+    }
+
+    if (gTrackSum)
+    {
+        *sum = total.sum + total.compensation;
+    }
+    if (gTrackNorms)
+    {
+        *norms = totalNorms;
+    }
+}
+
+/**
+ * Activates a single pass in the order chosen by the options over the block,
+ * then reduces what it tracks.
+ * @param sum output parameter: the heat sum after the pass (if tracked).
+ * @param norms output parameter: the norms of the pass's update (if tracked).
+ */
+static void sweep(double *sum, update_norms *norms)
+{
+    if (gTrackNorms)
+    {
+        memset(gRowNorms, 0, gRows * sizeof(update_norms));
+    }
+
+    beginPhase(gOptions.profile, PHASE_SWEEP);
+    switch (gOptions.order)
+    {
+        case SWEEP_JACOBI:
+            jacobi();
+            break;
+        case SWEEP_RED_BLACK:
+            redBlack();
+            break;
+        default:
+            gaussSeidel();
+    }
+    endPhase(gOptions.profile, PHASE_SWEEP);
+
+    if (gTrackSum || gTrackNorms)
+    {
+        beginPhase(gOptions.profile, PHASE_REDUCTION);
+        reduceMeasures(sum, norms);
+        endPhase(gOptions.profile, PHASE_REDUCTION);
+    }
+}
+
+/**
+ * checks weather the pass 'iteration' (counted from 1) is checked against terminate
+ * (like the calculator's isCheckedIteration).
+ * @param iteration
+ * @param n_iter
+ * @return true if it is, otherwise false.
+ */
+static bool isCheckedIteration(const unsigned int iteration, const unsigned int n_iter)
+{
+    const unsigned int EVERY_PASS = 1;
+
+    if (n_iter > 0)
+    {
+        return iteration == n_iter;
+    }
+
+    unsigned int interval = (gOptions.check_interval > EVERY_PASS) ? gOptions.check_interval : EVERY_PASS;
+    return iteration % interval == 0;
+}
+
+/**
+ * Returns the options' monitor for a checked pass.
+ * @param prevSum the sum before the pass
+ * @param currSum the sum after the pass
+ * @param norms the norms of the pass's update
+ * @return the monitor's value.
+ */
+static double monitorValue(const double prevSum, const double currSum, const update_norms *norms)
+{
+    switch (gOptions.monitor)
+    {
+        case MONITOR_L1:
+            return norms->l1;
+        case MONITOR_L2:
+            return sqrt(norms->l2);
+        case MONITOR_MAX:
+            return norms->max;
+        default:
+            return fabs(currSum - prevSum);
+    }
+}
+
+/**
+ * Returns the type of the rows x columns cells of 'grid' from its cell (0, 0).
+ * @param grid
+ * @param rows
+ * @param columns
+ */
+static MPI_Datatype blockType(const heat_grid *grid, const size_t rows, const size_t columns)
+{
+    MPI_Datatype type;
+    MPI_Type_vector((int) rows, (int) columns, (int) grid->stride, MPI_DOUBLE, &type);
+    MPI_Type_commit(&type);
+    return type;
+}
+
+/**
+ * Moves the blocks between the whole grid at the rank 0 (the root) and the
+ * processes: scatters them into gBlock, or gathers them back from it.
+ * @param grid the whole grid (at the root)
+ * @param rows of the grid
+ * @param columns of the grid
+ * @param isScatter
+ */
+static void moveBlocks(heat_grid *grid, const size_t rows, const size_t columns, const bool isScatter)
+{
+    const int ROOT = 0;
+    const int BLOCK_TAG = NUM_OF_SIDES;
+
+    int rank;
+    MPI_Comm_rank(gCart, &rank);
+    MPI_Datatype ownType = blockType(&gBlock, gRows, gColumns);
+
+    if (rank != ROOT)
+    {
+        if (isScatter)
+        {
+            MPI_Recv(heatGridRow(&gBlock, 0), 1, ownType, ROOT, BLOCK_TAG, gCart, MPI_STATUS_IGNORE);
+        }
+        else
+        {
+            MPI_Send(heatGridRow(&gBlock, 0), 1, ownType, ROOT, BLOCK_TAG, gCart);
+        }
+        MPI_Type_free(&ownType);
+        return;
+    }
+    MPI_Type_free(&ownType);
+
+    for (int process = 0; process < gDims[ROWS] * gDims[COLUMNS]; ++process)
+    {
+        int coords[DIMENSIONS];
+        MPI_Cart_coords(gCart, process, DIMENSIONS, coords);
+        size_t firstRow = partStart(rows, gDims[ROWS], coords[ROWS]);
+        size_t firstColumn = partStart(columns, gDims[COLUMNS], coords[COLUMNS]);
+        size_t blockRows = partStart(rows, gDims[ROWS], coords[ROWS] + 1) - firstRow;
+        size_t blockColumns = partStart(columns, gDims[COLUMNS], coords[COLUMNS] + 1) - firstColumn;
+        double *start = heatGridRow(grid, (ptrdiff_t) firstRow) + firstColumn;
+
+        if (process == ROOT)
+        {
+            for (size_t r = 0; r < blockRows; ++r)
+            {
+                double *cells = heatGridRow(&gBlock, r);
+                if (isScatter)
+                {
+                    memcpy(cells, start + r * grid->stride, blockColumns * sizeof(double));
+                }
+                else
+                {
+                    memcpy(start + r * grid->stride, cells, blockColumns * sizeof(double));
+                }
+            }
+            continue;
+        }
+
+        MPI_Datatype type = blockType(grid, blockRows, blockColumns);
+        if (isScatter)
+        {
+            MPI_Send(start, 1, type, process, BLOCK_TAG, gCart);
+        }
+        else
+        {
+            MPI_Recv(start, 1, type, process, BLOCK_TAG, gCart, MPI_STATUS_IGNORE);
+        }
+        MPI_Type_free(&type);
+    }
+}
+
+/**
+ * Frees the block's buffers & the process grid.
+ */
+static void releaseBlock()
+{
+    freeHeatGrid(&gBlock);
+    freeHeatGrid(&gScratch);
+    free(gSourceRowStart);
+    free(gSourceColumns);
+    free(gRowSums);
+    free(gRowNorms);
+    free(gOldRow);
+    free(gAllMeasures);
+    gSourceRowStart = NULL;
+    gSourceColumns = NULL;
+    gRowSums = NULL;
+    gRowNorms = NULL;
+    gOldRow = NULL;
+    gAllMeasures = NULL;
+    MPI_Type_free(&gRowType);
+    MPI_Type_free(&gColumnType);
+    MPI_Comm_free(&gCart);
+}
+
+/**
+ * Places the block of this process & allocates its buffers.
+ * @param rows of the grid
+ * @param columns of the grid
+ * @param sources
+ * @param num_sources
+ * @return true on success, false (with nothing allocated) otherwise.
+ */
+static bool acquireBlock(const size_t rows, const size_t columns, source_point *sources, const size_t num_sources)
+{
+    const int DIRECTION = 1;
+
+    int rank;
+    MPI_Comm_rank(gCart, &rank);
+    MPI_Cart_coords(gCart, rank, DIMENSIONS, gCoords);
+    MPI_Cart_shift(gCart, ROWS, DIRECTION, &gNeighbours[HALO_ABOVE], &gNeighbours[HALO_BELOW]);
+    MPI_Cart_shift(gCart, COLUMNS, DIRECTION, &gNeighbours[HALO_LEFT], &gNeighbours[HALO_RIGHT]);
+
+    gFirstRow = partStart(rows, gDims[ROWS], gCoords[ROWS]);
+    gFirstColumn = partStart(columns, gDims[COLUMNS], gCoords[COLUMNS]);
+    gRows = partStart(rows, gDims[ROWS], gCoords[ROWS] + 1) - gFirstRow;
+    gColumns = partStart(columns, gDims[COLUMNS], gCoords[COLUMNS] + 1) - gFirstColumn;
+
+    gScratch.data = NULL;
+    gRowSums = malloc(gRows * sizeof(compensated_sum));
+    gRowNorms = malloc(gRows * sizeof(update_norms));
+    gOldRow = malloc(gColumns * sizeof(double));
+    gAllMeasures = malloc((size_t) (gDims[ROWS] * gDims[COLUMNS]) * sizeof(block_measures));
+    bool isAcquired = createHeatGrid(&gBlock, gRows, gColumns) &&
+                      (gOptions.order != SWEEP_JACOBI || createHeatGrid(&gScratch, gRows, gColumns)) &&
+                      gRowSums != NULL && gRowNorms != NULL && gOldRow != NULL && gAllMeasures != NULL &&
+                      indexSources(sources, num_sources, gFirstRow, gFirstColumn, gRows, gColumns,
+                                   &gSourceRowStart, &gSourceColumns);
+
+    MPI_Type_contiguous((int) gColumns, MPI_DOUBLE, &gRowType);
+    MPI_Type_commit(&gRowType);
+    MPI_Type_vector((int) gRows, 1, (int) gBlock.stride, MPI_DOUBLE, &gColumnType);
+    MPI_Type_commit(&gColumnType);
+
+    if (!isAcquired)
+    {
+        releaseBlock();
+    }
+    return isAcquired;
+}
+
+/**
+ * Runs the passes over the block (scattered already) until the run is done.
+ * @param terminate
+ * @param n_iter
+ * @return the monitor of the last checked pass.
+ */
+static double runPasses(const double terminate, const unsigned int n_iter)
+{
+    if (gOptions.order == SWEEP_JACOBI)
+    {
+        for (size_t r = 0; r < gRows; ++r)
+        {
+            memcpy(heatGridRow(&gScratch, r), heatGridRow(&gBlock, r), gColumns * sizeof(double));
+        }
+    }
+    gCurrent = &gBlock;
+
+    double prevSum = 0;
+    update_norms norms = {0, 0, 0};
+    gTrackSum = true;
+    gTrackNorms = false;
+    for (size_t r = 0; r < gRows; ++r)
+    {
+        sumRow(&gBlock, r);
+    }
+    reduceMeasures(&prevSum, &norms);
+
+    double currSum = prevSum;
+    double monitor = 0;
+    for (unsigned int i = 1;; ++i)
+    {
+        gTrackNorms = gOptions.monitor != MONITOR_SUM_DELTA && isCheckedIteration(i, n_iter);
+        gTrackSum = gOptions.monitor == MONITOR_SUM_DELTA &&
+                    (isCheckedIteration(i, n_iter) || isCheckedIteration(i + 1, n_iter));
+        prevSum = currSum;
+        sweep(&currSum, &norms);
+
+        if (isCheckedIteration(i, n_iter))
+        {
+            monitor = monitorValue(prevSum, currSum, &norms);
+            recordMonitor(gOptions.profile, gOptions.calculation, i, monitor);
+            if (n_iter > 0 || monitor < terminate)
+            {
+                if (gOptions.passes != NULL)
+                {
+                    *gOptions.passes = i;
+                }
+                break;
+            }
+        }
+    }
+
+    if (gCurrent == &gScratch)
+    {
+        for (size_t r = 0; r < gRows; ++r)
+        {
+            memcpy(heatGridRow(&gBlock, r), heatGridRow(&gScratch, r), gColumns * sizeof(double));
+        }
+    }
+    return monitor;
+}
+
+/**
+ * calculateGrid over the processes of 'comm' (see distributed.h).
+ * @param function
+ * @param grid the whole grid (at the rank 0 of 'comm' only)
+ * @param rows of the grid
+ * @param columns of the grid
+ * @param sources array of the heat sources points
+ * @param num_sources the number of sources
+ * @param terminate the 'epsilon' for detecting the required precision
+ * @param n_iter num of iterations
+ * @param is_cyclic is it should be cyclic
+ * @param options the solver options (NULL for the default ones)
+ * @param comm
+ * @return the monitor of the last checked iteration, or CALCULATION_FAILED.
+ */
+double calculateDistributed(diff_func function, heat_grid *grid, const size_t rows, const size_t columns,
+                            source_point *sources, const size_t num_sources, const double terminate,
+                            const unsigned int n_iter, const int is_cyclic, const solver_options *options,
+                            MPI_Comm comm)
+{
+    const int ROOT = 0;
+    const int REORDER = 0; // the root stays the rank 0 of the process grid
+
+    int processes;
+    MPI_Comm_size(comm, &processes);
+    gOptions = (options != NULL) ? *options : defaultSolverOptions();
+    gKernel = kernelOf(function, gOptions.simd);
+    gIs_cyclic = is_cyclic;
+
+    chooseDims(processes, rows, columns, gDims);
+    int periods[DIMENSIONS] = {is_cyclic, is_cyclic};
+    MPI_Cart_create(comm, DIMENSIONS, gDims, periods, REORDER, &gCart);
+
+    int isFailed = gCart != MPI_COMM_NULL && !acquireBlock(rows, columns, sources, num_sources);
+    MPI_Allreduce(MPI_IN_PLACE, &isFailed, 1, MPI_INT, MPI_LOR, comm);
+    if (isFailed)
+    {
+        if (gCart != MPI_COMM_NULL) // its own block was acquired
+        {
+            releaseBlock();
+        }
+        return CALCULATION_FAILED;
+    }
+
+    double monitor = 0;
+    if (gCart != MPI_COMM_NULL)
+    {
+        moveBlocks(grid, rows, columns, true);
+        monitor = runPasses(terminate, n_iter);
+        moveBlocks(grid, rows, columns, false);
+        releaseBlock();
+    }
+
+    MPI_Bcast(&monitor, 1, MPI_DOUBLE, ROOT, comm);
+    return monitor;
+}
@@ -0,0 +1,37 @@
+/*
+ * distributed.h
+ *
+ *  Created on: Apr 26, 2018
+ *      Author: OWNER
+ */
+
+#ifndef DISTRIBUTED_H_
+#define DISTRIBUTED_H_
+
+#include <mpi.h>
+#include "calculator.h"
+
+/**
+ * calculateGrid over the processes of 'comm': the grid is split into 2D blocks
+ * over a Cartesian grid of processes (periodic when cyclic), every one of them
+ * passes over its block, exchanging a one-cell halo with its neighbours, and the
+ * monitor is reduced over all of them. A process with nothing to hold (more
+ * processes than the grid has cells to split into) waits for the result.
+ *
+ * The passes give the very same cells as calculateGrid's passes of the options'
+ * order: red-black & Jacobi blocks exchange their halos before every (half)
+ * pass, and Gauss-Seidel blocks run as a wavefront, where a block starts its
+ * pass once the blocks above & to its left have finished theirs. Only the
+ * order, the SIMD level, the monitor & its interval apply; the other options
+ * (threads, solvers, over-relaxation) are calculateGrid's alone.
+ *
+ * 'grid' is the whole rows x columns grid at the rank 0 of 'comm' (which scatters
+ * it, and gathers the result back into it) and is ignored at the other ranks.
+ * Every rank returns the monitor of the last checked pass, or CALCULATION_FAILED
+ * (at every rank) if a block could not be allocated.
+ */
+double calculateDistributed(diff_func function, heat_grid *grid, size_t rows, size_t columns,
+		source_point *sources, size_t num_sources, double terminate, unsigned int n_iter, int is_cyclic,
+		const solver_options *options, MPI_Comm comm);
+
+#endif /* DISTRIBUTED_H_ */
@@ -0,0 +1,106 @@
+/**
+ * @author Roy Ackerman
+ *
+ * Writes a synthetic parameter file to the standard output, for benchmarks:
+ * gen_input <rows> <columns> <source density> <is cyclic> [iterations] [precision] [seed]
+ * Every cell is a source with the probability 'source density' (in [0, 1]), of a
+ * heat in [-MAX_HEAT, MAX_HEAT]; the same arguments always give the same file.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// ........................................ Messages ............................... //
+const char *USAGE_MSG = "Usage: gen_input <rows> <columns> <source density> <is cyclic> "
+                        "[iterations] [precision] [seed]\n";
+
+// ........................................ Constants ............................... //
+const int MIN_ARGS = 5;
+const int ITERATIONS_ARG = 5;
+const int PRECISION_ARG = 6;
+const int SEED_ARG = 7;
+const unsigned long DEFAULT_ITERATIONS = 0; // until the precision
+const double DEFAULT_PRECISION = 1e-3;
+const uint64_t DEFAULT_SEED = 1;
+const double MAX_HEAT = 10.0;
+
+/**
+ * The state of a xorshift64* generator (never 0).
+ */
+uint64_t gState;
+
+/**
+ * Returns the next random number in [0, 1).
+ */
+double nextRandom()
+{
+    const int BITS = 53; // of a double's mantissa
+
+    gState ^= gState >> 12;
+    gState ^= gState << 25;
+    gState ^= gState >> 27;
+    uint64_t number = gState * 0x2545F4914F6CDD1DULL;
+    return (double) (number >> (64 - BITS)) / (double) (1ULL << BITS);
+}
+
+/**
+ * Reads the unsigned integer 'text' into 'number'.
+ * @return true on success, false if it isn't one.
+ */
+bool parseUnsigned(const char *text, unsigned long *number)
+{
+    char *end;
+    *number = strtoul(text, &end, 10);
+    return *text >= '0' && *text <= '9' && *end == '\0';
+}
+
+/**
+ * Reads the number 'text' into 'number'.
+ * @return true on success, false if it isn't one.
+ */
+bool parseNumber(const char *text, double *number)
+{
+    char *end;
+    *number = strtod(text, &end);
+    return *text != '\0' && *end == '\0';
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long rows, columns, isCyclic;
+    unsigned long iterations = DEFAULT_ITERATIONS;
+    unsigned long seed = DEFAULT_SEED;
+    double density;
+    double precision = DEFAULT_PRECISION;
+
+    bool isValid = argc >= MIN_ARGS && argc <= SEED_ARG + 1 &&
+                   parseUnsigned(argv[1], &rows) && rows > 0 &&
+                   parseUnsigned(argv[2], &columns) && columns > 0 &&
+                   parseNumber(argv[3], &density) && density >= 0 && density <= 1 &&
+                   parseUnsigned(argv[4], &isCyclic) && isCyclic <= 1;
+    isValid = isValid && (argc <= ITERATIONS_ARG || parseUnsigned(argv[ITERATIONS_ARG], &iterations));
+    isValid = isValid && (argc <= PRECISION_ARG || (parseNumber(argv[PRECISION_ARG], &precision) && precision > 0));
+    isValid = isValid && (argc <= SEED_ARG || parseUnsigned(argv[SEED_ARG], &seed));
+    if (!isValid)
+    {
+        fprintf(stderr, "%s", USAGE_MSG);
+        return EXIT_FAILURE;
+    }
+
+    gState = (seed == 0) ? DEFAULT_SEED : seed;
+    printf("%lu, %lu\n----\n", rows, columns);
+    for (unsigned long x = 0; x < rows; ++x)
+    {
+        for (unsigned long y = 0; y < columns; ++y)
+        {
+            if (nextRandom() < density)
+            {
+                printf("%lu, %lu, %.2f\n", x, y, (2 * nextRandom() - 1) * MAX_HEAT);
+            }
+        }
+    }
+    printf("----\n%g\n%lu\n%lu\n", precision, iterations, isCyclic);
+
+    return (fflush(stdout) == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,201 @@
+/**
+ * @author Roy Ackerman
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <string.h>
+#include "grid.h"
+
+/**
+ * Returns the padded row length (in cells of 'cellSize' bytes) for 'columns' cells
+ * plus their halo cells: a whole cache line in front (see GRID_ROW_PAD), and the
+ * row rounded up to a whole number of cache lines. A stride which
+ * is a multiple of the page size gets an extra line so that vertically
+ * adjacent cells don't all map to the same cache set.
+ * @param columns
+ * @param cellSize
+ * @return the stride.
+ */
+static size_t paddedStride(const size_t columns, const size_t cellSize)
+{
+    const size_t CELLS_PER_LINE = GRID_ALIGNMENT / cellSize;
+    const size_t PAGE_SIZE = 4096;
+
+    const size_t RIGHT_HALO = 1;
+
+    size_t stride = CELLS_PER_LINE + (columns + RIGHT_HALO + CELLS_PER_LINE - 1) / CELLS_PER_LINE * CELLS_PER_LINE;
+    if ((stride * cellSize) % PAGE_SIZE == 0)
+    {
+        stride += CELLS_PER_LINE;
+    }
+
+    return stride;
+}
+
+/**
+ * Allocates a zero-filled aligned block of 'rows' rows & their halo rows.
+ * @param rows
+ * @param stride
+ * @param cellSize
+ * @return the block, or NULL if the allocation failed.
+ */
+static void *allocateBlock(const size_t rows, const size_t stride, const size_t cellSize)
+{
+    const size_t HALO_ROWS = 2;
+
+    void *block = NULL;
+    size_t bytes = (rows + HALO_ROWS) * stride * cellSize;
+    if (posix_memalign(&block, GRID_ALIGNMENT, bytes) != 0)
+    {
+        return NULL;
+    }
+
+    memset(block, 0, bytes);
+    return block;
+}
+
+/**
+ * Allocates the grid (with its halo rows) as a single aligned block
+ * & initializes it to 0.
+ * @param grid
+ * @param rows
+ * @param columns
+ * @return true on success, false otherwise.
+ */
+bool createHeatGrid(heat_grid *grid, const size_t rows, const size_t columns)
+{
+    size_t stride = paddedStride(columns, sizeof(double));
+    double *block = allocateBlock(rows, stride, sizeof(double));
+
+    grid->data = NULL;
+    grid->rows = rows;
+    grid->columns = columns;
+    grid->stride = stride;
+
+    if (block == NULL)
+    {
+        return false;
+    }
+
+    grid->data = block + stride + GRID_ROW_PAD; // skip the top halo row
+    return true;
+}
+
+/**
+ * Frees the grid's block.
+ * @param grid
+ */
+void freeHeatGrid(heat_grid *grid)
+{
+    if (grid->data != NULL)
+    {
+        free(grid->data - grid->stride - GRID_ROW_PAD);
+        grid->data = NULL;
+    }
+}
+
+/**
+ * Allocates the volume: the grid of its planes one after the other.
+ * @param volume
+ * @param planes
+ * @param rows
+ * @param columns
+ * @return true on success, false otherwise.
+ */
+bool createHeatVolume(heat_volume *volume, const size_t planes, const size_t rows, const size_t columns)
+{
+    volume->planes = planes;
+    volume->rows = rows;
+    volume->columns = columns;
+    return createHeatGrid(&volume->grid, planes * rows, columns);
+}
+
+/**
+ * Frees the volume's block.
+ * @param volume
+ */
+void freeHeatVolume(heat_volume *volume)
+{
+    freeHeatGrid(&volume->grid);
+}
+
+/**
+ * Allocates the float grid (with its halo rows) as a single aligned block
+ * & initializes it to 0.
+ * @param grid
+ * @param rows
+ * @param columns
+ * @return true on success, false otherwise.
+ */
+bool createFloatGrid(float_grid *grid, const size_t rows, const size_t columns)
+{
+    size_t stride = paddedStride(columns, sizeof(float));
+    float *block = allocateBlock(rows, stride, sizeof(float));
+
+    grid->data = NULL;
+    grid->rows = rows;
+    grid->columns = columns;
+    grid->stride = stride;
+
+    if (block == NULL)
+    {
+        return false;
+    }
+
+    grid->data = block + stride + FLOAT_GRID_ROW_PAD; // skip the top halo row
+    return true;
+}
+
+/**
+ * Frees the float grid's block.
+ * @param grid
+ */
+void freeFloatGrid(float_grid *grid)
+{
+    if (grid->data != NULL)
+    {
+        free(grid->data - grid->stride - FLOAT_GRID_ROW_PAD);
+        grid->data = NULL;
+    }
+}
+
+/**
+ * Sets the halo ring to 0.
+ * @param grid
+ */
+void clearHeatGridHalo(heat_grid *grid)
+{
+    const double VALUE_FOR_OUT_OF_MATRIX = 0;
+
+    for (ptrdiff_t r = -1; r <= (ptrdiff_t) grid->rows; ++r)
+    {
+        double *cells = heatGridRow(grid, r);
+        cells[-1] = VALUE_FOR_OUT_OF_MATRIX;
+        cells[grid->columns] = VALUE_FOR_OUT_OF_MATRIX;
+        if (r == -1 || r == (ptrdiff_t) grid->rows)
+        {
+            for (size_t c = 0; c < grid->columns; ++c)
+            {
+                cells[c] = VALUE_FOR_OUT_OF_MATRIX;
+            }
+        }
+    }
+}
+
+/**
+ * Sets the halo ring from the wrapped-around cells: the halo rows are copies
+ * of the last & first rows, then every row's halo cells (the halo rows' too)
+ * are copies of its last & first cells.
+ * @param grid
+ */
+void wrapHeatGridHalo(heat_grid *grid)
+{
+    memcpy(heatGridRow(grid, -1), heatGridRow(grid, (ptrdiff_t) grid->rows - 1), grid->columns * sizeof(double));
+    memcpy(heatGridRow(grid, (ptrdiff_t) grid->rows), heatGridRow(grid, 0), grid->columns * sizeof(double));
+    for (ptrdiff_t r = -1; r <= (ptrdiff_t) grid->rows; ++r)
+    {
+        double *cells = heatGridRow(grid, r);
+        cells[-1] = cells[grid->columns - 1];
+        cells[grid->columns] = cells[0];
+    }
+}
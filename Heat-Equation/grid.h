@@ -0,0 +1,133 @@
+/*
+ * grid.h
+ *
+ *  Created on: Apr 18, 2018
+ *      Author: OWNER
+ */
+
+#ifndef GRID_H_
+#define GRID_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/**
+ * Alignment (in bytes) of the grid's block and of every row inside it.
+ */
+#define GRID_ALIGNMENT 64
+
+/**
+ * Doubles in front of every row: a whole cache line, so the row itself stays
+ * aligned while its left halo cell sits right before it.
+ */
+#define GRID_ROW_PAD (GRID_ALIGNMENT / sizeof(double))
+
+/**
+ * A rows x columns matrix of doubles kept in one aligned block, surrounded by
+ * a one-cell halo ring: rows -1 and 'rows', and columns -1 and 'columns' are
+ * valid cells which aren't part of the matrix.
+ * Row r starts at data + r * stride; stride is padded so every row begins on
+ * a GRID_ALIGNMENT boundary.
+ */
+typedef struct
+{
+	double *data;
+	size_t rows, columns;
+	size_t stride;
+} heat_grid;
+
+/**
+ * The single precision version of heat_grid (half the memory & bandwidth):
+ * the same layout, with FLOAT_GRID_ROW_PAD floats in front of every row.
+ */
+#define FLOAT_GRID_ROW_PAD (GRID_ALIGNMENT / sizeof(float))
+
+typedef struct
+{
+	float *data;
+	size_t rows, columns;
+	size_t stride;
+} float_grid;
+
+/**
+ * A planes x rows x columns volume (the k, n, m of a 3D calculation): its
+ * planes one after the other in a single heat_grid of planes * rows rows - the
+ * row x of the plane z is the grid's row z * rows + x - so every row keeps its
+ * halo cells & alignment, and the volume prints like its grid.
+ */
+typedef struct
+{
+	heat_grid grid;
+	size_t planes, rows, columns;
+} heat_volume;
+
+/**
+ * Allocates a zero-filled grid of rows x columns cells.
+ * @return true on success, false if the allocation failed.
+ */
+bool createHeatGrid(heat_grid *grid, size_t rows, size_t columns);
+
+/**
+ * Frees the grid's block (safe to call on a grid that was never created).
+ */
+void freeHeatGrid(heat_grid *grid);
+
+/**
+ * Allocates a zero-filled volume of planes x rows x columns cells.
+ * @return true on success, false if the allocation failed.
+ */
+bool createHeatVolume(heat_volume *volume, size_t planes, size_t rows, size_t columns);
+
+/**
+ * Frees the volume's block (safe to call on a volume that was never created).
+ */
+void freeHeatVolume(heat_volume *volume);
+
+/**
+ * Allocates a zero-filled float grid of rows x columns cells.
+ * @return true on success, false if the allocation failed.
+ */
+bool createFloatGrid(float_grid *grid, size_t rows, size_t columns);
+
+/**
+ * Frees the float grid's block (safe to call on a grid that was never created).
+ */
+void freeFloatGrid(float_grid *grid);
+
+/**
+ * Sets the whole halo ring to 0 (the cells out of a non-cyclic matrix).
+ */
+void clearHeatGridHalo(heat_grid *grid);
+
+/**
+ * Sets the whole halo ring from the wrapped-around cells (a cyclic matrix).
+ */
+void wrapHeatGridHalo(heat_grid *grid);
+
+/**
+ * Returns a pointer to the first cell of the row 'row' (-1 and grid->rows are
+ * the halo rows).
+ */
+static inline double *heatGridRow(const heat_grid *grid, ptrdiff_t row)
+{
+	return grid->data + row * (ptrdiff_t) grid->stride;
+}
+
+/**
+ * Returns a pointer to the first cell of the row 'row' of the plane 'plane'.
+ */
+static inline double *heatVolumeRow(const heat_volume *volume, size_t plane, size_t row)
+{
+	return heatGridRow(&volume->grid, (ptrdiff_t) (plane * volume->rows + row));
+}
+
+/**
+ * Returns a pointer to the first cell of the row 'row' of a float grid.
+ */
+static inline float *floatGridRow(const float_grid *grid, ptrdiff_t row)
+{
+	return grid->data + row * (ptrdiff_t) grid->stride;
+}
+
+#endif /* GRID_H_ */
@@ -5,6 +5,7 @@
  *      Author: OWNER
  */
 
+#include "heat_eqn.h"
 
 /**
  * A discrete form of the heat equation.
@@ -13,9 +14,21 @@ double heat_eqn(double cell, double right, double top, double left, double botto
 {
 	/*
 	 * For simplicity, we have set D = dt = dx = 1;
+	 * (right + left) is dphiDx and (top + bottom) is dphiDy, each without its - 2 * cell
 	 */
-	double dphiDx = right + left; // - 2 * cell
-	double dphiDy = top + bottom; // - 2 * cell
-	return (dphiDx + dphiDy) / 4; // + cell - cancels out.
+	(void) cell; // + cell - cancels out.
+	return HEAT_EQN(cell, right, top, left, bottom);
 }
 
+
+/**
+ * A discrete form of the heat equation in 3D.
+ */
+double heat_eqn3(double cell, double right, double top, double left, double bottom, double front, double back)
+{
+	/*
+	 * (front + back) is dphiDz, without its - 2 * cell
+	 */
+	(void) cell; // + cell - cancels out.
+	return HEAT_EQN3(cell, right, top, left, bottom, front, back);
+}
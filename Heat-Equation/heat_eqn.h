@@ -8,7 +8,23 @@
 #ifndef HEAT_EQN_H_
 #define HEAT_EQN_H_
 
+/**
+ * The discrete heat equation as an expression, shared by heat_eqn() and the
+ * calculator's specialized kernels (so both give the very same doubles).
+ * For simplicity, we have set D = dt = dx = 1; the cell cancels out.
+ */
+#define HEAT_EQN(cell, right, top, left, bottom) ((((right) + (left)) + ((top) + (bottom))) / 4)
+
+/**
+ * The 3D version (the 7-point stencil): 'front' & 'back' are the cell's
+ * neighbours in the previous & the next planes.
+ */
+#define HEAT_EQN3(cell, right, top, left, bottom, front, back) \
+	(((((right) + (left)) + ((top) + (bottom))) + ((front) + (back))) / 6)
+
 double heat_eqn(double cell, double right, double top, double left, double bottom);
 
+double heat_eqn3(double cell, double right, double top, double left, double bottom, double front, double back);
+
 #endif /* HEAT_EQN_H_ */
 
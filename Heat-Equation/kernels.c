@@ -0,0 +1,125 @@
+/**
+ * @author Roy Ackerman
+ */
+#include "kernels.h"
+#include "heat_eqn.h"
+
+/**
+ * The new value of a cell whose stencil gives 'value': the value itself, or
+ * (over-)relaxed by params->omega, i.e. moved omega times as far from 'cell'.
+ */
+#define PLAIN_UPDATE(cell, value) (value)
+#define RELAXED_UPDATE(cell, value) ((cell) + params->omega * ((value) - (cell)))
+
+/**
+ * Defines the kernel 'name', setting every STEP'th cell from 'from' to
+ * UPDATE(cell, STENCIL): STENCIL is an expression of cell, right, top, left &
+ * bottom (and params), which is inlined into the loop. When in place, 'left'
+ * was already written by the previous step (for STEP 1).
+ */
+#define DEFINE_KERNEL_LOOP(name, STEP, STENCIL, UPDATE) \
+static void name(double *next, const double *cells, const double *up, const double *down, \
+                 size_t from, const size_t to, const kernel_params *params) \
+{ \
+    (void) params; \
+    for (; from < to; from += STEP) \
+    { \
+        const double cell = cells[from]; \
+        const double right = cells[from + 1]; \
+        const double top = up[from]; \
+        const double left = cells[from - 1]; \
+        const double bottom = down[from]; \
+        (void) cell; \
+        next[from] = UPDATE(cell, (STENCIL)); \
+    } \
+}
+
+/**
+ * Defines the row kernel 'name' (every cell) and its red-black kernel
+ * 'nameRedBlack' (every second cell, i.e. the cells of a single colour),
+ * and their over-relaxed versions 'nameSor' & 'nameSorRedBlack'.
+ */
+#define DEFINE_ROW_KERNEL(name, STENCIL) \
+    DEFINE_KERNEL_LOOP(name, 1, STENCIL, PLAIN_UPDATE) \
+    DEFINE_KERNEL_LOOP(name##RedBlack, 2, STENCIL, PLAIN_UPDATE) \
+    DEFINE_KERNEL_LOOP(name##Sor, 1, STENCIL, RELAXED_UPDATE) \
+    DEFINE_KERNEL_LOOP(name##SorRedBlack, 2, STENCIL, RELAXED_UPDATE)
+
+/**
+ * The built-in functions which have a specialized kernel: X(function, STENCIL).
+ */
+#define BUILTIN_KERNELS(X) \
+    X(heat_eqn, HEAT_EQN(cell, right, top, left, bottom))
+
+/*
+ * The generic kernel (any diff_func, called once per cell) and the weighted
+ * 5-point stencil kernel.
+ */
+DEFINE_ROW_KERNEL(genericRow, params->function(cell, right, top, left, bottom))
+DEFINE_ROW_KERNEL(weightedRow, params->weights.center * cell + params->weights.right * right +
+                               params->weights.top * top + params->weights.left * left +
+                               params->weights.bottom * bottom)
+
+// The built-in kernels: heat_eqnRow, ...
+#define DEFINE_BUILTIN_KERNEL(function, STENCIL) DEFINE_ROW_KERNEL(function##Row, STENCIL)
+BUILTIN_KERNELS(DEFINE_BUILTIN_KERNEL)
+
+/**
+ * The kernels registry: the built-in functions & their specialized kernels.
+ */
+static const struct
+{
+    diff_func function;
+    row_kernel row;
+    row_kernel redBlack;
+    row_kernel sor;
+    row_kernel sorRedBlack;
+} gRegistry[] = {
+#define REGISTER_BUILTIN_KERNEL(function, STENCIL) \
+    {function, function##Row, function##RowRedBlack, function##RowSor, function##RowSorRedBlack},
+    BUILTIN_KERNELS(REGISTER_BUILTIN_KERNEL)
+};
+
+/**
+ * Returns the kernel of 'function'.
+ * @param function
+ * @param level the SIMD level of the vectorized kernels
+ * @return the specialized kernel if registered, the generic one otherwise.
+ */
+stencil_kernel kernelOf(diff_func function, const simd_level level)
+{
+    stencil_kernel kernel = {genericRow, genericRow, genericRowRedBlack, genericRowSor, genericRowSorRedBlack,
+                             {function, {0, 0, 0, 0, 0}, NO_RELAXATION}};
+
+    for (size_t i = 0; i < sizeof(gRegistry) / sizeof(gRegistry[0]); ++i)
+    {
+        if (gRegistry[i].function == function)
+        {
+            kernel.row = gRegistry[i].row;
+            kernel.jacobi = gRegistry[i].row;
+            kernel.redBlack = gRegistry[i].redBlack;
+            kernel.sor = gRegistry[i].sor;
+            kernel.sorRedBlack = gRegistry[i].sorRedBlack;
+        }
+    }
+
+    row_kernel vectorized = heatJacobiKernel(level);
+    if (function == heat_eqn && vectorized != NULL)
+    {
+        kernel.jacobi = vectorized;
+    }
+
+    return kernel;
+}
+
+/**
+ * Returns the kernel of the weighted stencil.
+ * @param weights
+ * @return the weighted kernel.
+ */
+stencil_kernel weightedKernel(const stencil_weights *weights)
+{
+    stencil_kernel kernel = {weightedRow, weightedRow, weightedRowRedBlack, weightedRowSor, weightedRowSorRedBlack,
+                             {NULL, *weights, NO_RELAXATION}};
+    return kernel;
+}
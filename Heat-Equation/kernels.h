@@ -0,0 +1,79 @@
+/*
+ * kernels.h
+ *
+ *  Created on: Apr 19, 2018
+ *      Author: OWNER
+ */
+
+#ifndef KERNELS_H_
+#define KERNELS_H_
+
+#include <stdlib.h>
+#include "calculator.h"
+
+/**
+ * The relaxation factor of a plain (Gauss-Seidel or Jacobi) update.
+ */
+#define NO_RELAXATION 1.0
+
+/**
+ * What a row kernel needs besides the rows: the callback of the generic
+ * kernel, or the weights of the weighted stencil kernel, and the relaxation
+ * factor of the over-relaxed kernels.
+ */
+typedef struct
+{
+	diff_func function;
+	stencil_weights weights;
+	double omega;
+} kernel_params;
+
+/**
+ * A row kernel: writes the cells [from, to) of 'next' (left to right) from the
+ * row 'cells', where 'up' is the row r + 1 and 'down' is the row r - 1. The
+ * neighbours out of the matrix are read from the halo cells.
+ * 'next' is 'cells' itself for an in-place (Gauss-Seidel) pass.
+ */
+typedef void (*row_kernel)(double *next, const double *cells, const double *up, const double *down,
+		size_t from, size_t to, const kernel_params *params);
+
+/**
+ * A kernel & its parameters: 'row' is the in-place kernel, 'jacobi' is one for
+ * 'next' != 'cells' only (possibly vectorized), and 'redBlack' updates in place
+ * every second cell of [from, to) only. 'sor' & 'sorRedBlack' are 'row' &
+ * 'redBlack' over-relaxed by params.omega.
+ */
+typedef struct
+{
+	row_kernel row;
+	row_kernel jacobi;
+	row_kernel redBlack;
+	row_kernel sor;
+	row_kernel sorRedBlack;
+	kernel_params params;
+} stencil_kernel;
+
+/**
+ * Returns the kernel of 'function': a specialized one (with the stencil inlined)
+ * if 'function' is one of the built-in functions, otherwise the generic kernel
+ * which calls 'function' for every cell. 'level' picks the vectorized kernels.
+ */
+stencil_kernel kernelOf(diff_func function, simd_level level);
+
+/**
+ * Returns the specialized kernel of the weighted stencil 'weights'.
+ */
+stencil_kernel weightedKernel(const stencil_weights *weights);
+
+/**
+ * Returns the best SIMD level the CPU supports (detected once, with cpuid).
+ */
+simd_level detectSimdLevel();
+
+/**
+ * Returns the vectorized Jacobi kernel of heat_eqn for 'level' (SIMD_AUTO, or a
+ * level above the CPU's, means the CPU's level), or NULL for SIMD_SCALAR.
+ */
+row_kernel heatJacobiKernel(simd_level level);
+
+#endif /* KERNELS_H_ */
@@ -0,0 +1,175 @@
+/*
+ * measures.h
+ *
+ *  Created on: Apr 26, 2018
+ *      Author: OWNER
+ */
+
+#ifndef MEASURES_H_
+#define MEASURES_H_
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "calculator.h"
+
+/**
+ * A sum with its running compensation (Neumaier's variant of Kahan's
+ * summation): the true sum is sum + compensation, up to the error of a
+ * couple of additions rather than of one per added value.
+ */
+typedef struct
+{
+	double sum;
+	double compensation;
+} compensated_sum;
+
+/**
+ * The norms of a pass's per-cell changes, inside a single row.
+ */
+typedef struct
+{
+	double l1; // sum of |new - old|
+	double l2; // sum of (new - old) ^ 2
+	double max; // max of |new - old|
+} update_norms;
+
+/**
+ * Adds 'value' to the compensated sum 'sum'.
+ * @param sum
+ * @param value
+ */
+static inline void addCompensated(compensated_sum *sum, const double value)
+{
+	double total = sum->sum + value;
+	if (fabs(sum->sum) >= fabs(value))
+	{
+		sum->compensation += (sum->sum - total) + value; // the low bits of 'value' which were lost
+	}
+	else
+	{
+		sum->compensation += (value - total) + sum->sum; // the low bits of 'sum' which were lost
+	}
+	sum->sum = total;
+}
+
+/**
+ * Returns the compensated sum of the cells [0, columns) of a row.
+ * @param cells
+ * @param columns
+ */
+static inline compensated_sum sumCells(const double *cells, const size_t columns)
+{
+	compensated_sum sum = {0, 0};
+	for (size_t col = 0; col < columns; ++col)
+	{
+		addCompensated(&sum, cells[col]);
+	}
+	return sum;
+}
+
+/**
+ * Adds the changes of the cells [from, to) of a row from 'old' to 'updated' into 'norms'.
+ * @param norms
+ * @param updated the row after (a part of) the pass
+ * @param old the row before it
+ * @param from the first column
+ * @param to one past the last column
+ */
+static inline void measureChanges(update_norms *norms, const double *updated, const double *old, const size_t from,
+		const size_t to)
+{
+	update_norms sums = *norms; // in registers, since the rows could alias 'norms'
+	for (size_t col = from; col < to; ++col)
+	{
+		double change = fabs(updated[col] - old[col]);
+		sums.l1 += change;
+		sums.l2 += change * change;
+		sums.max = (change > sums.max) ? change : sums.max;
+	}
+	*norms = sums;
+}
+
+/**
+ * Combines the sums of the rows, in the order of the rows (so the result
+ * doesn't depend on the threads which summed them).
+ * @param rowSums
+ * @param rows
+ * @return the sum of the grid.
+ */
+static inline double totalOfRowSums(const compensated_sum *rowSums, const size_t rows)
+{
+	compensated_sum total = {0, 0};
+	for (size_t row = 0; row < rows; ++row)
+	{
+		addCompensated(&total, rowSums[row].sum);
+		addCompensated(&total, rowSums[row].compensation);
+	}
+	return total.sum + total.compensation;
+}
+
+/**
+ * Combines the norms of the rows, in the order of the rows.
+ * @param rowNorms
+ * @param rows
+ * @return the norms of the whole pass (l2 still squared).
+ */
+static inline update_norms totalOfRowNorms(const update_norms *rowNorms, const size_t rows)
+{
+	update_norms total = {0, 0, 0};
+	for (size_t row = 0; row < rows; ++row)
+	{
+		total.l1 += rowNorms[row].l1;
+		total.l2 += rowNorms[row].l2;
+		total.max = (rowNorms[row].max > total.max) ? rowNorms[row].max : total.max;
+	}
+	return total;
+}
+
+/**
+ * checks weather the pass 'pass' (counted from 1) is checked against terminate:
+ * the last one of a fixed number of iterations (n_iter), or every
+ * check_interval'th one of a run until the precision (n_iter 0).
+ * @param pass
+ * @param n_iter
+ * @param check_interval
+ * @return true if it is, otherwise false.
+ */
+static inline bool isCheckedPass(const unsigned int pass, const unsigned int n_iter, const unsigned int check_interval)
+{
+	const unsigned int EVERY_PASS = 1;
+
+	if (n_iter > 0)
+	{
+		return pass == n_iter;
+	}
+
+	unsigned int interval = (check_interval > EVERY_PASS) ? check_interval : EVERY_PASS;
+	return pass % interval == 0;
+}
+
+/**
+ * Returns the value of 'monitor' for a checked pass.
+ * @param monitor
+ * @param prevSum the sum before the pass
+ * @param currSum the sum after the pass
+ * @param norms the norms of the pass's update (l2 squared)
+ * @return the monitor's value.
+ */
+static inline double monitorOfPass(const convergence_monitor monitor, const double prevSum, const double currSum,
+		const update_norms *norms)
+{
+	switch (monitor)
+	{
+		case MONITOR_L1:
+			return norms->l1;
+		case MONITOR_L2:
+			return sqrt(norms->l2);
+		case MONITOR_MAX:
+			return norms->max;
+		default:
+			return fabs(currSum - prevSum);
+	}
+}
+
+#endif /* MEASURES_H_ */
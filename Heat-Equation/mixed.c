@@ -0,0 +1,264 @@
+/**
+ * @author Roy Ackerman
+ */
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "mixed.h"
+#include "heat_eqn.h"
+
+/**
+ * Sets the halo ring of a float grid from the wrapped-around cells (like wrapHeatGridHalo).
+ * @param grid
+ */
+static void wrapHalo(float_grid *grid)
+{
+    memcpy(floatGridRow(grid, -1), floatGridRow(grid, (ptrdiff_t) grid->rows - 1), grid->columns * sizeof(float));
+    memcpy(floatGridRow(grid, (ptrdiff_t) grid->rows), floatGridRow(grid, 0), grid->columns * sizeof(float));
+    for (ptrdiff_t r = -1; r <= (ptrdiff_t) grid->rows; ++r)
+    {
+        float *cells = floatGridRow(grid, r);
+        cells[-1] = cells[grid->columns - 1];
+        cells[grid->columns] = cells[0];
+    }
+}
+
+/**
+ * Sets the whole of a float grid (with its halo) to 0.
+ * @param grid
+ */
+static void clearFloatGrid(float_grid *grid)
+{
+    for (ptrdiff_t r = -1; r <= (ptrdiff_t) grid->rows; ++r)
+    {
+        memset(floatGridRow(grid, r) - 1, 0, (grid->columns + 2) * sizeof(float));
+    }
+}
+
+/**
+ * Sets the residual to the change heat_eqn makes at every free cell of 'grid'
+ * (in double precision, stored as float), and returns its 'monitor' norm:
+ * l1 (also for the sum monitor), l2 or max.
+ * @param mp
+ * @param grid
+ * @param monitor
+ * @return the norm.
+ */
+static double computeResidual(mixed_precision *mp, heat_grid *grid, const convergence_monitor monitor)
+{
+    if (mp->isCyclic)
+    {
+        wrapHeatGridHalo(grid);
+    }
+
+    double norm = 0;
+    for (size_t r = 0; r < mp->rows; ++r)
+    {
+        const double *cells = heatGridRow(grid, r);
+        const double *up = heatGridRow(grid, r + 1);
+        const double *down = heatGridRow(grid, (ptrdiff_t) r - 1);
+        float *residual = floatGridRow(&mp->residual, r);
+        size_t from = 0;
+
+        for (size_t i = mp->sourceRowStart[r]; i <= mp->sourceRowStart[r + 1]; ++i)
+        {
+            size_t to = (i < mp->sourceRowStart[r + 1]) ? mp->sourceColumns[i] : mp->columns;
+            for (size_t col = from; col < to; ++col)
+            {
+                double change = HEAT_EQN(cells[col], cells[col + 1], up[col], cells[col - 1], down[col]) - cells[col];
+                residual[col] = (float) change;
+                change = fabs(change);
+                switch (monitor)
+                {
+                    case MONITOR_L2:
+                        norm += change * change;
+                        break;
+                    case MONITOR_MAX:
+                        norm = fmax(norm, change);
+                        break;
+                    default:
+                        norm += change;
+                }
+            }
+            from = to + 1;
+        }
+    }
+    return (monitor == MONITOR_L2) ? sqrt(norm) : norm;
+}
+
+/**
+ * Relaxes every second cell of [first, to) of the row r of the correction:
+ * correction = (neighbours / 4 + residual), over-relaxed by omega.
+ * @param mp
+ * @param r
+ * @param first
+ * @param to
+ * @param size in & output parameter: the largest size of a relaxed cell.
+ * @return the largest change.
+ */
+static float relaxCells(mixed_precision *mp, const size_t r, const size_t first, const size_t to, float *size)
+{
+    const float NEIGHBOUR_WEIGHT = 0.25f;
+
+    float *cells = floatGridRow(&mp->correction, r);
+    const float *up = floatGridRow(&mp->correction, r + 1);
+    const float *down = floatGridRow(&mp->correction, (ptrdiff_t) r - 1);
+    const float *residual = floatGridRow(&mp->residual, r);
+    float largest = 0;
+    float largestSize = *size;
+
+    for (size_t col = first; col < to; col += 2)
+    {
+        float value = NEIGHBOUR_WEIGHT * ((cells[col + 1] + cells[col - 1]) + (up[col] + down[col])) + residual[col];
+        float change = mp->omega * (value - cells[col]);
+        cells[col] += change;
+        largest = fmaxf(largest, fabsf(change));
+        largestSize = fmaxf(largestSize, fabsf(cells[col]));
+    }
+
+    *size = largestSize;
+    return largest;
+}
+
+/**
+ * A red-black pass over the correction, skipping the sources (which stay 0).
+ * @param mp
+ * @param size output parameter: the largest size of a cell.
+ * @return the largest change.
+ */
+static float relaxPass(mixed_precision *mp, float *size)
+{
+    const size_t RED = 0;
+    const size_t BLACK = 1;
+
+    float largest = 0;
+    *size = 0;
+    for (size_t color = RED; color <= BLACK; ++color)
+    {
+        if (mp->isCyclic)
+        {
+            wrapHalo(&mp->correction);
+        }
+
+        for (size_t r = 0; r < mp->rows; ++r)
+        {
+            size_t from = 0;
+            for (size_t i = mp->sourceRowStart[r]; i <= mp->sourceRowStart[r + 1]; ++i)
+            {
+                size_t to = (i < mp->sourceRowStart[r + 1]) ? mp->sourceColumns[i] : mp->columns;
+                size_t first = from + ((r + from + color) % 2); // the first cell of the colour
+                largest = fmaxf(largest, relaxCells(mp, r, first, to, size));
+                from = to + 1;
+            }
+        }
+    }
+    return largest;
+}
+
+/**
+ * Solves for the correction of the residual in single precision: passes until
+ * their change is PRECISION of the largest cell (a float's digits don't go much
+ * further), or until a number of passes which grows with the grid's size.
+ * @param mp
+ */
+static void solveCorrection(mixed_precision *mp)
+{
+    const float PRECISION = 1e-5f;
+    const unsigned int PASSES_PER_CELL_OF_SIDE = 20;
+
+    unsigned int maxPasses = PASSES_PER_CELL_OF_SIDE * (unsigned int) (mp->rows + mp->columns);
+    clearFloatGrid(&mp->correction);
+
+    float size;
+    for (unsigned int pass = 0; pass < maxPasses; ++pass)
+    {
+        if (relaxPass(mp, &size) <= PRECISION * size)
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * Adds the correction to 'grid' (in double precision).
+ * @param mp
+ * @param grid
+ */
+static void addCorrection(const mixed_precision *mp, heat_grid *grid)
+{
+    for (size_t r = 0; r < mp->rows; ++r)
+    {
+        double *cells = heatGridRow(grid, r);
+        const float *correction = floatGridRow(&mp->correction, r);
+        for (size_t col = 0; col < mp->columns; ++col)
+        {
+            cells[col] += correction[col];
+        }
+    }
+}
+
+/**
+ * Refines 'grid' in mixed precision.
+ * @param mp
+ * @param grid
+ * @param monitor
+ * @param tolerance
+ * @return the number of refinements.
+ */
+unsigned int solveInMixedPrecision(mixed_precision *mp, heat_grid *grid, const convergence_monitor monitor,
+                                   const double tolerance)
+{
+    const double STAGNATION = 0.5;
+
+    unsigned int refinements = 0;
+    double norm = computeResidual(mp, grid, monitor);
+    double previousNorm = 2 * norm / STAGNATION;
+
+    while (norm >= tolerance && norm <= STAGNATION * previousNorm)
+    {
+        solveCorrection(mp);
+        addCorrection(mp, grid);
+        ++refinements;
+
+        previousNorm = norm;
+        norm = computeResidual(mp, grid, monitor);
+    }
+
+    return refinements;
+}
+
+/**
+ * Allocates the buffers.
+ * @return true on success, false (with nothing allocated) otherwise.
+ */
+bool createMixedPrecision(mixed_precision *mp, const size_t rows, const size_t columns, const size_t *sourceRowStart,
+                          const size_t *sourceColumns, const int is_cyclic, const double omega)
+{
+    const float_grid NONE = {NULL, 0, 0, 0};
+
+    mp->correction = mp->residual = NONE;
+    mp->rows = rows;
+    mp->columns = columns;
+    mp->sourceRowStart = sourceRowStart;
+    mp->sourceColumns = sourceColumns;
+    mp->isCyclic = is_cyclic;
+    mp->omega = (float) omega;
+
+    if (!createFloatGrid(&mp->correction, rows, columns) || !createFloatGrid(&mp->residual, rows, columns))
+    {
+        freeMixedPrecision(mp);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Frees the buffers.
+ * @param mp
+ */
+void freeMixedPrecision(mixed_precision *mp)
+{
+    freeFloatGrid(&mp->correction);
+    freeFloatGrid(&mp->residual);
+}
@@ -0,0 +1,57 @@
+/*
+ * mixed.h
+ *
+ *  Created on: Apr 25, 2018
+ *      Author: OWNER
+ */
+
+#ifndef MIXED_H_
+#define MIXED_H_
+
+#include <stdbool.h>
+#include "calculator.h"
+
+/**
+ * The buffers of a mixed precision solve of heat_eqn's steady state on a
+ * rows x columns grid: iterative refinement, where the residual of the (double)
+ * grid is taken in double precision, and the correction it calls for is solved
+ * for in single precision by over-relaxed red-black passes over float grids
+ * (half the memory traffic of double passes), then added to the grid in double.
+ * Every refinement gains the digits a float solve can give, so a few of them
+ * bring the grid to any precision a double solve could.
+ */
+typedef struct
+{
+	float_grid correction; // 0 at the sources
+	float_grid residual;
+	size_t rows, columns;
+	const size_t *sourceRowStart; // row r's sources are sourceColumns[sourceRowStart[r] .. sourceRowStart[r + 1])
+	const size_t *sourceColumns;
+	int isCyclic;
+	float omega; // of the passes
+} mixed_precision;
+
+/**
+ * Allocates the buffers of a rows x columns grid whose (sorted, distinct)
+ * sources are indexed like the calculator's (the index is kept, not copied).
+ * @return true on success, false (with nothing allocated) otherwise.
+ */
+bool createMixedPrecision(mixed_precision *mp, size_t rows, size_t columns, const size_t *sourceRowStart,
+		const size_t *sourceColumns, int is_cyclic, double omega);
+
+/**
+ * Frees the buffers (safe to call on one which was never created).
+ */
+void freeMixedPrecision(mixed_precision *mp);
+
+/**
+ * Refines 'grid' until the 'monitor' norm of its residual (the update a Jacobi
+ * pass would make; the sum monitor uses its l1 norm) is below 'tolerance', or
+ * until a refinement doesn't halve it (rounding keeps it from getting there).
+ * The halo of a non-cyclic grid must be 0.
+ * @return the number of refinements.
+ */
+unsigned int solveInMixedPrecision(mixed_precision *mp, heat_grid *grid, convergence_monitor monitor,
+		double tolerance);
+
+#endif /* MIXED_H_ */
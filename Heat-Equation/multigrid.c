@@ -0,0 +1,831 @@
+/**
+ * @author Roy Ackerman
+ */
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "multigrid.h"
+
+/**
+ * Frees a level's buffers.
+ * @param level
+ */
+static void freeLevel(multigrid_level *level)
+{
+    freeHeatGrid(&level->solution);
+    freeHeatGrid(&level->rhs);
+    free(level->specialRowStart);
+    free(level->specialColumns);
+    free(level->specialStencils);
+    free(level->rowNeighbours);
+    free(level->columnNeighbours);
+    level->specialRowStart = NULL;
+    level->specialColumns = NULL;
+    level->specialStencils = NULL;
+    level->rowNeighbours = NULL;
+    level->columnNeighbours = NULL;
+}
+
+/**
+ * Checks weather a rows x columns level can be halved.
+ * @param rows
+ * @param columns
+ * @param is_cyclic
+ * @return true if it can, false otherwise.
+ */
+static bool isCoarsenable(const size_t rows, const size_t columns, const int is_cyclic)
+{
+    const size_t MIN_SIDE = 2; // of the coarser level
+
+    if (is_cyclic && (rows % 2 != 0 || columns % 2 != 0))
+    {
+        return false; // the coarser cells wouldn't wrap around
+    }
+
+    return rows / 2 >= MIN_SIDE && columns / 2 >= MIN_SIDE;
+}
+
+/**
+ * Sets the coarser neighbours of every one of a finer level's 'size' rows (or columns).
+ * @param neighbours
+ * @param size
+ * @param coarseSize
+ * @param is_cyclic
+ */
+static void setCoarseNeighbours(coarse_neighbours *neighbours, const size_t size, const size_t coarseSize,
+                                const int is_cyclic)
+{
+    const double ON = 1;
+    const double HALFWAY = 0.5;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        coarse_neighbours *own = &neighbours[i];
+        own->count = 0;
+        if (i % 2 == 1)
+        {
+            own->index[own->count] = i / 2;
+            own->weight[own->count++] = ON;
+            continue;
+        }
+
+        if (i > 0 || is_cyclic)
+        {
+            own->index[own->count] = (i > 0) ? i / 2 - 1 : coarseSize - 1;
+            own->weight[own->count++] = HALFWAY;
+        }
+        if (i / 2 < coarseSize)
+        {
+            own->index[own->count] = i / 2;
+            own->weight[own->count++] = HALFWAY;
+        }
+    }
+}
+
+/**
+ * Returns the coarser neighbours of the finer index i (-2 .. 2) of an unbounded
+ * grid, where the coarser cell 0 lies on the finer cell 0; the indices are
+ * shifted by 1 (0 .. 2), like a stencil's.
+ * @param i
+ * @return the neighbours.
+ */
+static coarse_neighbours relativeNeighbours(const int i)
+{
+    const double ON = 1;
+    const double HALFWAY = 0.5;
+
+    coarse_neighbours neighbours = {1, {(size_t) (i / 2 + 1), 0}, {ON, 0}};
+    if (i % 2 != 0)
+    {
+        neighbours.count = 2;
+        neighbours.index[0] = (size_t) ((i - 1) / 2 + 1);
+        neighbours.index[1] = (size_t) ((i + 1) / 2 + 1);
+        neighbours.weight[0] = HALFWAY;
+        neighbours.weight[1] = HALFWAY;
+    }
+
+    return neighbours;
+}
+
+/**
+ * Checks weather a stencil is a fixed cell's.
+ */
+static inline bool isFixedStencil(const level_stencil *stencil)
+{
+    return stencil->weight[1][1] == 0;
+}
+
+/**
+ * Returns the stencil of the cell (r, c).
+ * @param level
+ * @param r
+ * @param c
+ * @return the cell's special stencil, or the level's one.
+ */
+static const level_stencil *stencilOf(const multigrid_level *level, const size_t r, const size_t c)
+{
+    size_t low = level->specialRowStart[r];
+    size_t high = level->specialRowStart[r + 1];
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (level->specialColumns[middle] < c)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low < level->specialRowStart[r + 1] && level->specialColumns[low] == c)
+    {
+        return &level->specialStencils[low];
+    }
+    return &level->stencil;
+}
+
+/**
+ * Moves the index i into [0, size), wrapping it around when cyclic.
+ * @param i
+ * @param size
+ * @param is_cyclic
+ * @return false if it is out of a non-cyclic matrix (on the boundary), true otherwise.
+ */
+static bool wrapIndex(ptrdiff_t *i, const size_t size, const int is_cyclic)
+{
+    if (*i >= 0 && (size_t) *i < size)
+    {
+        return true;
+    }
+    if (!is_cyclic)
+    {
+        return false;
+    }
+
+    *i += (*i < 0) ? (ptrdiff_t) size : -(ptrdiff_t) size;
+    return true;
+}
+
+/**
+ * Returns the stencil index (0 .. 2) of the coarser index k in the stencil of i.
+ * @param k
+ * @param i
+ * @param size the side of the (maybe cyclic) coarser level
+ */
+static size_t stencilIndex(const size_t k, const size_t i, const size_t size)
+{
+    ptrdiff_t offset = (ptrdiff_t) k - (ptrdiff_t) i;
+    if (offset > 1)
+    {
+        offset -= (ptrdiff_t) size;
+    }
+    else if (offset < -1)
+    {
+        offset += (ptrdiff_t) size;
+    }
+
+    return (size_t) (offset + 1);
+}
+
+/**
+ * Sets 'coarse' to the Galerkin product of the stencil 'fine' on an unbounded grid.
+ * @param fine
+ * @param coarse
+ */
+static void coarsenStencil(const level_stencil *fine, level_stencil *coarse)
+{
+    memset(coarse, 0, sizeof(level_stencil));
+    for (int ir = -1; ir <= 1; ++ir)
+    {
+        for (int ic = -1; ic <= 1; ++ic)
+        {
+            // the weight of the coarser cell 0 in the interpolation of the finer cell (ir, ic)
+            coarse_neighbours ownRows = relativeNeighbours(ir);
+            coarse_neighbours ownColumns = relativeNeighbours(ic);
+            double interpolated = ownRows.weight[ir != 0] * ownColumns.weight[ic != 0];
+            for (int dr = -1; dr <= 1; ++dr)
+            {
+                for (int dc = -1; dc <= 1; ++dc)
+                {
+                    double weight = fine->weight[dr + 1][dc + 1];
+                    coarse_neighbours rows = relativeNeighbours(ir + dr);
+                    coarse_neighbours columns = relativeNeighbours(ic + dc);
+                    for (size_t k = 0; k < rows.count && weight != 0; ++k)
+                    {
+                        for (size_t l = 0; l < columns.count; ++l)
+                        {
+                            coarse->weight[rows.index[k]][columns.index[l]] +=
+                                    interpolated * weight * rows.weight[k] * columns.weight[l];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Sets 'stencil' to the Galerkin product at the cell (row, column) of the
+ * level index + 1: sums the finer stencils of the cells interpolated from it,
+ * leaving out the fixed cells & the boundary.
+ * @param mg
+ * @param index the finer level
+ * @param row
+ * @param column
+ * @param stencil
+ */
+static void coarsenStencilAt(const multigrid *mg, const size_t index, const size_t row, const size_t column,
+                             level_stencil *stencil)
+{
+    const double ON = 1;
+    const double HALFWAY = 0.5;
+
+    const multigrid_level *fine = &mg->levels[index];
+    const multigrid_level *coarse = &mg->levels[index + 1];
+
+    memset(stencil, 0, sizeof(level_stencil));
+    for (int ir = -1; ir <= 1; ++ir)
+    {
+        for (int ic = -1; ic <= 1; ++ic)
+        {
+            ptrdiff_t i = (ptrdiff_t) (2 * row + 1) + ir;
+            ptrdiff_t j = (ptrdiff_t) (2 * column + 1) + ic;
+            if (!wrapIndex(&i, fine->rows, mg->isCyclic) || !wrapIndex(&j, fine->columns, mg->isCyclic))
+            {
+                continue;
+            }
+
+            const level_stencil *own = stencilOf(fine, (size_t) i, (size_t) j);
+            double interpolated = (ir == 0 ? ON : HALFWAY) * (ic == 0 ? ON : HALFWAY);
+            for (int dr = -1; dr <= 1 && !isFixedStencil(own); ++dr)
+            {
+                for (int dc = -1; dc <= 1; ++dc)
+                {
+                    ptrdiff_t r = i + dr;
+                    ptrdiff_t c = j + dc;
+                    double weight = own->weight[dr + 1][dc + 1];
+                    if (weight == 0 || !wrapIndex(&r, fine->rows, mg->isCyclic) ||
+                        !wrapIndex(&c, fine->columns, mg->isCyclic) ||
+                        isFixedStencil(stencilOf(fine, (size_t) r, (size_t) c)))
+                    {
+                        continue;
+                    }
+
+                    const coarse_neighbours *rows = &fine->rowNeighbours[r];
+                    const coarse_neighbours *columns = &fine->columnNeighbours[c];
+                    for (size_t k = 0; k < rows->count; ++k)
+                    {
+                        for (size_t l = 0; l < columns->count; ++l)
+                        {
+                            stencil->weight[stencilIndex(rows->index[k], row, coarse->rows)]
+                                           [stencilIndex(columns->index[l], column, coarse->columns)] +=
+                                    interpolated * weight * rows->weight[k] * columns->weight[l];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Checks weather two stencils differ by more than rounding.
+ * @param first
+ * @param second
+ * @return true if they do, false otherwise.
+ */
+static bool isDifferentStencil(const level_stencil *first, const level_stencil *second)
+{
+    const double ROUNDING = 1e-12; // relative to the centre
+
+    double tolerance = ROUNDING * fabs(second->weight[1][1]);
+    for (size_t r = 0; r < 3; ++r)
+    {
+        for (size_t c = 0; c < 3; ++c)
+        {
+            if (fabs(first->weight[r][c] - second->weight[r][c]) > tolerance)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Marks the cells of the level index + 1 whose stencil may differ from the
+ * level's one: those around the finer level's special cells, and the last row
+ * (column) when a non-cyclic finer side is even - its boundary doesn't lie on a
+ * coarser one.
+ * @param mg
+ * @param index the finer level
+ * @param isMarked the coarser level's flags
+ */
+static void markSpecialCandidates(const multigrid *mg, const size_t index, unsigned char *isMarked)
+{
+    const ptrdiff_t BELOW = 2, ABOVE = 1; // coarser cells whose stencils read a finer cell
+
+    const multigrid_level *fine = &mg->levels[index];
+    const multigrid_level *coarse = &mg->levels[index + 1];
+
+    for (size_t r = 0; r < fine->rows; ++r)
+    {
+        for (size_t i = fine->specialRowStart[r]; i < fine->specialRowStart[r + 1]; ++i)
+        {
+            ptrdiff_t c = (ptrdiff_t) fine->specialColumns[i];
+            for (ptrdiff_t row = (ptrdiff_t) r / 2 - BELOW; row <= (ptrdiff_t) r / 2 + ABOVE; ++row)
+            {
+                for (ptrdiff_t column = c / 2 - BELOW; column <= c / 2 + ABOVE; ++column)
+                {
+                    ptrdiff_t k = row, l = column;
+                    if (wrapIndex(&k, coarse->rows, mg->isCyclic) && wrapIndex(&l, coarse->columns, mg->isCyclic))
+                    {
+                        isMarked[(size_t) k * coarse->columns + (size_t) l] = 1;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!mg->isCyclic && fine->rows % 2 == 0)
+    {
+        memset(isMarked + (coarse->rows - 1) * coarse->columns, 1, coarse->columns);
+    }
+    if (!mg->isCyclic && fine->columns % 2 == 0)
+    {
+        for (size_t r = 0; r < coarse->rows; ++r)
+        {
+            isMarked[r * coarse->columns + coarse->columns - 1] = 1;
+        }
+    }
+}
+
+/**
+ * Sets the stencils of the level index + 1 from the level 'index'.
+ * @param mg
+ * @param index the finer level
+ * @return true on success, false otherwise.
+ */
+static bool coarsenStencils(multigrid *mg, const size_t index)
+{
+    const multigrid_level *fine = &mg->levels[index];
+    multigrid_level *coarse = &mg->levels[index + 1];
+
+    coarsenStencil(&fine->stencil, &coarse->stencil);
+
+    unsigned char *isMarked = calloc(coarse->rows * coarse->columns, sizeof(unsigned char));
+    coarse->specialRowStart = calloc(coarse->rows + 1, sizeof(size_t));
+    if (isMarked == NULL || coarse->specialRowStart == NULL)
+    {
+        free(isMarked);
+        return false;
+    }
+
+    markSpecialCandidates(mg, index, isMarked);
+    size_t candidates = 0;
+    for (size_t i = 0; i < coarse->rows * coarse->columns; ++i)
+    {
+        candidates += isMarked[i];
+    }
+
+    coarse->specialColumns = malloc((candidates + 1) * sizeof(size_t));
+    coarse->specialStencils = malloc((candidates + 1) * sizeof(level_stencil));
+    if (coarse->specialColumns == NULL || coarse->specialStencils == NULL)
+    {
+        free(isMarked);
+        return false;
+    }
+
+    size_t count = 0;
+    for (size_t r = 0; r < coarse->rows; ++r)
+    {
+        coarse->specialRowStart[r] = count;
+        for (size_t c = 0; c < coarse->columns; ++c)
+        {
+            if (isMarked[r * coarse->columns + c])
+            {
+                coarsenStencilAt(mg, index, r, c, &coarse->specialStencils[count]);
+                if (isDifferentStencil(&coarse->specialStencils[count], &coarse->stencil))
+                {
+                    coarse->specialColumns[count++] = c;
+                }
+            }
+        }
+    }
+    coarse->specialRowStart[coarse->rows] = count;
+
+    free(isMarked);
+    return true;
+}
+
+/**
+ * Sets the stencils of level 0: heat_eqn's, with its sources fixed.
+ * @param level
+ * @param sourceRowStart
+ * @param sourceColumns
+ * @return true on success, false otherwise.
+ */
+static bool setGridStencils(multigrid_level *level, const size_t *sourceRowStart, const size_t *sourceColumns)
+{
+    const double CELL = 1;
+    const double NEIGHBOUR = -0.25; // HEAT_EQN's average of the 4 neighbours
+
+    size_t numOfSources = sourceRowStart[level->rows];
+    level->stencil = (level_stencil) {{{0, NEIGHBOUR, 0}, {NEIGHBOUR, CELL, NEIGHBOUR}, {0, NEIGHBOUR, 0}}};
+    level->specialRowStart = malloc((level->rows + 1) * sizeof(size_t));
+    level->specialColumns = malloc((numOfSources + 1) * sizeof(size_t));
+    level->specialStencils = calloc(numOfSources + 1, sizeof(level_stencil)); // all fixed
+    if (level->specialRowStart == NULL || level->specialColumns == NULL || level->specialStencils == NULL)
+    {
+        return false;
+    }
+
+    memcpy(level->specialRowStart, sourceRowStart, (level->rows + 1) * sizeof(size_t));
+    memcpy(level->specialColumns, sourceColumns, numOfSources * sizeof(size_t));
+    return true;
+}
+
+/**
+ * Allocates the levels.
+ * @param mg
+ * @param rows
+ * @param columns
+ * @param sourceRowStart
+ * @param sourceColumns
+ * @param is_cyclic
+ * @return true on success, false otherwise.
+ */
+bool createMultigrid(multigrid *mg, const size_t rows, const size_t columns, const size_t *sourceRowStart,
+                     const size_t *sourceColumns, const int is_cyclic)
+{
+    size_t numOfLevels = 1;
+    for (size_t r = rows, c = columns; isCoarsenable(r, c, is_cyclic); r /= 2, c /= 2)
+    {
+        numOfLevels++;
+    }
+
+    mg->numOfLevels = 0;
+    mg->isCyclic = is_cyclic;
+    mg->levels = calloc(numOfLevels, sizeof(multigrid_level));
+    if (mg->levels == NULL)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < numOfLevels; ++i)
+    {
+        multigrid_level *level = &mg->levels[i];
+        level->rows = (i == 0) ? rows : mg->levels[i - 1].rows / 2;
+        level->columns = (i == 0) ? columns : mg->levels[i - 1].columns / 2;
+        mg->numOfLevels++;
+
+        bool isCreated = true;
+        if (i + 1 < numOfLevels)
+        {
+            level->rowNeighbours = malloc(level->rows * sizeof(coarse_neighbours));
+            level->columnNeighbours = malloc(level->columns * sizeof(coarse_neighbours));
+            isCreated = level->rowNeighbours != NULL && level->columnNeighbours != NULL;
+            if (isCreated)
+            {
+                setCoarseNeighbours(level->rowNeighbours, level->rows, level->rows / 2, is_cyclic);
+                setCoarseNeighbours(level->columnNeighbours, level->columns, level->columns / 2, is_cyclic);
+            }
+        }
+
+        if (i == 0)
+        {
+            isCreated = isCreated && setGridStencils(level, sourceRowStart, sourceColumns);
+        }
+        else
+        {
+            isCreated = isCreated && createHeatGrid(&level->solution, level->rows, level->columns) &&
+                        createHeatGrid(&level->rhs, level->rows, level->columns) && coarsenStencils(mg, i - 1);
+        }
+
+        if (!isCreated)
+        {
+            freeMultigrid(mg);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Frees the levels.
+ * @param mg
+ */
+void freeMultigrid(multigrid *mg)
+{
+    for (size_t i = 0; i < mg->numOfLevels; ++i)
+    {
+        freeLevel(&mg->levels[i]);
+    }
+    free(mg->levels);
+    mg->levels = NULL;
+    mg->numOfLevels = 0;
+}
+
+/**
+ * Refreshes the halo ring of a level's grid: the wrapped-around cells when
+ * cyclic; a non-cyclic halo is 0 from its creation & never written.
+ * @param mg
+ * @param grid
+ */
+static void refreshHalo(const multigrid *mg, heat_grid *grid)
+{
+    if (mg->isCyclic)
+    {
+        wrapHeatGridHalo(grid);
+    }
+}
+
+/**
+ * Zeroes the rows of a level's grid.
+ * @param grid
+ */
+static void clearRows(heat_grid *grid)
+{
+    for (size_t r = 0; r < grid->rows; ++r)
+    {
+        memset(heatGridRow(grid, r), 0, grid->columns * sizeof(double));
+    }
+}
+
+/**
+ * Returns stencil * solution at the column c, where 'down', 'cells' & 'up' are
+ * the rows r - 1, r & r + 1 of the solution.
+ */
+static inline double applyStencil(const level_stencil *stencil, const double *down, const double *cells,
+                                  const double *up, const size_t c)
+{
+    const double *rows[3] = {down, cells, up};
+    double sum = 0;
+    for (size_t r = 0; r < 3; ++r)
+    {
+        sum += stencil->weight[r][0] * rows[r][c - 1] + stencil->weight[r][1] * rows[r][c] +
+               stencil->weight[r][2] * rows[r][c + 1];
+    }
+
+    return sum;
+}
+
+/**
+ * A Gauss-Seidel pass over the row r of a coarse level: solves every cell's
+ * equation for the cell.
+ * @param level
+ * @param r
+ */
+static void smoothRow(multigrid_level *level, const size_t r)
+{
+    double *cells = heatGridRow(&level->solution, r);
+    const double *up = heatGridRow(&level->solution, r + 1);
+    const double *down = heatGridRow(&level->solution, (ptrdiff_t) r - 1);
+    const double *rhs = heatGridRow(&level->rhs, r);
+    const double center = level->stencil.weight[1][1];
+    size_t from = 0;
+
+    for (size_t i = level->specialRowStart[r]; i <= level->specialRowStart[r + 1]; ++i)
+    {
+        bool isSpecial = i < level->specialRowStart[r + 1];
+        size_t to = isSpecial ? level->specialColumns[i] : level->columns;
+        for (size_t c = from; c < to; ++c)
+        {
+            cells[c] += (rhs[c] - applyStencil(&level->stencil, down, cells, up, c)) / center;
+        }
+
+        const level_stencil *special = &level->specialStencils[i];
+        if (isSpecial && !isFixedStencil(special))
+        {
+            cells[to] += (rhs[to] - applyStencil(special, down, cells, up, to)) / special->weight[1][1];
+        }
+        from = to + 1;
+    }
+}
+
+/**
+ * Gauss-Seidel passes over a coarse level.
+ * @param mg
+ * @param index the level
+ * @param passes
+ */
+static void smooth(const multigrid *mg, const size_t index, const unsigned int passes)
+{
+    multigrid_level *level = &mg->levels[index];
+
+    for (unsigned int pass = 0; pass < passes; ++pass)
+    {
+        refreshHalo(mg, &level->solution);
+        for (size_t r = 0; r < level->rows; ++r)
+        {
+            smoothRow(level, r);
+        }
+    }
+}
+
+/**
+ * Adds 'value' of the finer cell (r, c) to the coarser cells it's interpolated
+ * from, in proportion to their weights.
+ * @param fine
+ * @param coarse the coarser grid
+ * @param r
+ * @param c
+ * @param value
+ */
+static inline void scatter(const multigrid_level *fine, heat_grid *coarse, const size_t r, const size_t c,
+                           const double value)
+{
+    const coarse_neighbours *rows = &fine->rowNeighbours[r];
+    const coarse_neighbours *columns = &fine->columnNeighbours[c];
+
+    for (size_t i = 0; i < rows->count; ++i)
+    {
+        double *cells = heatGridRow(coarse, rows->index[i]);
+        for (size_t j = 0; j < columns->count; ++j)
+        {
+            cells[columns->index[j]] += rows->weight[i] * columns->weight[j] * value;
+        }
+    }
+}
+
+/**
+ * Sets the problem of the level index + 1 to the error equation of the level
+ * 'index' (whose solution is 'grid'): its rhs is the residual, restricted by
+ * the transposed interpolation, and its initial solution is 0.
+ * @param mg
+ * @param index the finer level
+ * @param grid the finer level's solution
+ */
+static void restrictResidual(const multigrid *mg, const size_t index, heat_grid *grid)
+{
+    const multigrid_level *fine = &mg->levels[index];
+    multigrid_level *coarse = &mg->levels[index + 1];
+
+    clearRows(&coarse->rhs);
+    clearRows(&coarse->solution);
+
+    refreshHalo(mg, grid);
+    for (size_t r = 0; r < fine->rows; ++r)
+    {
+        const double *cells = heatGridRow(grid, r);
+        const double *up = heatGridRow(grid, r + 1);
+        const double *down = heatGridRow(grid, (ptrdiff_t) r - 1);
+        const double *rhs = (index > 0) ? heatGridRow(&fine->rhs, r) : NULL; // the grid's rhs is 0
+        size_t from = 0;
+
+        for (size_t i = fine->specialRowStart[r]; i <= fine->specialRowStart[r + 1]; ++i)
+        {
+            bool isSpecial = i < fine->specialRowStart[r + 1];
+            size_t to = isSpecial ? fine->specialColumns[i] : fine->columns;
+            for (size_t c = from; c < to; ++c)
+            {
+                double residual = (rhs != NULL ? rhs[c] : 0) - applyStencil(&fine->stencil, down, cells, up, c);
+                scatter(fine, &coarse->rhs, r, c, residual);
+            }
+
+            const level_stencil *special = &fine->specialStencils[i];
+            if (isSpecial && !isFixedStencil(special))
+            {
+                double residual = (rhs != NULL ? rhs[to] : 0) - applyStencil(special, down, cells, up, to);
+                scatter(fine, &coarse->rhs, r, to, residual);
+            }
+            from = to + 1;
+        }
+    }
+}
+
+/**
+ * Interpolates the solution of the level index + 1 into the cells of the
+ * level 'index' (whose solution is 'grid') which aren't fixed: adds it, or
+ * sets them to it.
+ * @param mg
+ * @param index the finer level
+ * @param grid the finer level's solution
+ * @param isAdded
+ */
+static void prolong(const multigrid *mg, const size_t index, heat_grid *grid, const bool isAdded)
+{
+    const multigrid_level *fine = &mg->levels[index];
+    const heat_grid *coarse = &mg->levels[index + 1].solution;
+
+    for (size_t r = 0; r < fine->rows; ++r)
+    {
+        double *cells = heatGridRow(grid, r);
+        const coarse_neighbours *rows = &fine->rowNeighbours[r];
+        size_t next = fine->specialRowStart[r]; // the next special cell
+
+        for (size_t c = 0; c < fine->columns; ++c)
+        {
+            if (next < fine->specialRowStart[r + 1] && fine->specialColumns[next] == c)
+            {
+                if (isFixedStencil(&fine->specialStencils[next++]))
+                {
+                    continue;
+                }
+            }
+
+            const coarse_neighbours *columns = &fine->columnNeighbours[c];
+            double value = 0;
+            for (size_t i = 0; i < rows->count; ++i)
+            {
+                const double *coarseCells = heatGridRow(coarse, rows->index[i]);
+                for (size_t j = 0; j < columns->count; ++j)
+                {
+                    value += rows->weight[i] * columns->weight[j] * coarseCells[columns->index[j]];
+                }
+            }
+            cells[c] = isAdded ? cells[c] + value : value;
+        }
+    }
+}
+
+/**
+ * Solves the coarsest level: a side of it may still be long, so it gets a
+ * number of passes that grows with its size.
+ * @param mg
+ */
+static void solveCoarsest(const multigrid *mg)
+{
+    const unsigned int PASSES_PER_CELL_OF_SIDE = 8;
+
+    const multigrid_level *coarsest = &mg->levels[mg->numOfLevels - 1];
+    smooth(mg, mg->numOfLevels - 1, PASSES_PER_CELL_OF_SIDE * (unsigned int) (coarsest->rows + coarsest->columns));
+}
+
+/**
+ * A W-cycle on the coarse level 'index': smooths, corrects twice by the coarser
+ * levels & smooths again. Visiting the coarser levels twice keeps the rate the same
+ * for any size even when a few point sources are all that pins a cyclic grid
+ * (a V-cycle slows down there), and still costs a bounded multiple of the level,
+ * since each coarser one is a quarter of it.
+ * @param mg
+ * @param index
+ */
+static void wCycle(const multigrid *mg, const size_t index)
+{
+    const unsigned int PRE_SMOOTHING = 2;
+    const unsigned int POST_SMOOTHING = 2;
+
+    if (index + 1 == mg->numOfLevels)
+    {
+        solveCoarsest(mg);
+        return;
+    }
+
+    heat_grid *solution = &mg->levels[index].solution;
+    smooth(mg, index, PRE_SMOOTHING);
+    restrictResidual(mg, index, solution);
+    wCycle(mg, index + 1);
+    wCycle(mg, index + 1);
+    prolong(mg, index, solution, true);
+    smooth(mg, index, POST_SMOOTHING);
+}
+
+/**
+ * Full multigrid start of 'grid'.
+ * @param mg
+ * @param grid
+ */
+void startFromCoarseLevels(multigrid *mg, heat_grid *grid)
+{
+    if (mg->numOfLevels < 2)
+    {
+        return;
+    }
+
+    // The residual all the way down (the coarse solutions are 0, so their residual is their rhs)
+    restrictResidual(mg, 0, grid);
+    for (size_t i = 1; i + 1 < mg->numOfLevels; ++i)
+    {
+        restrictResidual(mg, i, &mg->levels[i].solution);
+    }
+
+    solveCoarsest(mg);
+    for (size_t i = mg->numOfLevels - 2; i > 0; --i)
+    {
+        prolong(mg, i, &mg->levels[i].solution, false);
+        wCycle(mg, i);
+    }
+    prolong(mg, 0, grid, true);
+}
+
+/**
+ * Coarse grid correction of 'grid'.
+ * @param mg
+ * @param grid
+ */
+void correctFromCoarseLevels(multigrid *mg, heat_grid *grid)
+{
+    if (mg->numOfLevels < 2)
+    {
+        return;
+    }
+
+    restrictResidual(mg, 0, grid);
+    wCycle(mg, 1);
+    prolong(mg, 0, grid, true);
+}
@@ -0,0 +1,99 @@
+/*
+ * multigrid.h
+ *
+ *  Created on: Apr 22, 2018
+ *      Author: OWNER
+ */
+
+#ifndef MULTIGRID_H_
+#define MULTIGRID_H_
+
+#include <stdbool.h>
+#include "calculator.h"
+
+/**
+ * The coarser rows (or columns) a row of a finer level is interpolated from,
+ * with their weights: an odd row i lies on the coarser row i / 2, and an even
+ * one halfway between the coarser rows i / 2 - 1 and i / 2 (a neighbour out of
+ * a non-cyclic matrix is the 0 boundary, so it's left out).
+ */
+typedef struct
+{
+	size_t count;
+	size_t index[2];
+	double weight[2];
+} coarse_neighbours;
+
+/**
+ * A 9-point stencil of a level's error equation: weight[1 + dr][1 + dc] is the
+ * weight of the cell (r + dr, c + dc) in the equation of the cell (r, c).
+ * All 0 for a fixed cell (a source, whose error is always 0).
+ */
+typedef struct
+{
+	double weight[3][3];
+} level_stencil;
+
+/**
+ * A level of the error equation: stencil * solution = rhs at every cell which isn't fixed.
+ * Level 0 is the calculator's grid: 1 for the cell & -1/4 for each neighbour
+ * (heat_eqn's update is the cell's solution), with the sources fixed.
+ * The cell (i, j) of level k + 1 lies on the cell (2i + 1, 2j + 1) of level k, and its
+ * stencil is the Galerkin product (interpolation^T * stencil of level k * interpolation),
+ * so sources & boundaries carry over exactly. Most cells share the stencil of an
+ * unbounded grid; the others ("special" - near the sources, or along an edge
+ * which doesn't halve evenly) are kept per row, like the calculator's sources.
+ */
+typedef struct
+{
+	heat_grid solution; // a correction of the finer level (none for level 0)
+	heat_grid rhs;
+	size_t rows, columns;
+	level_stencil stencil; // of the cells which aren't special
+	size_t *specialRowStart; // row r's special cells are specialColumns[specialRowStart[r] .. specialRowStart[r + 1])
+	size_t *specialColumns;
+	level_stencil *specialStencils;
+	coarse_neighbours *rowNeighbours; // of every row in the coarser level (none for the coarsest)
+	coarse_neighbours *columnNeighbours;
+} multigrid_level;
+
+/**
+ * The levels of a rows x columns calculation.
+ */
+typedef struct
+{
+	multigrid_level *levels;
+	size_t numOfLevels;
+	int isCyclic;
+} multigrid;
+
+/**
+ * Allocates the levels of a rows x columns grid whose (sorted, distinct) sources
+ * are indexed like the calculator's: row r's in sourceColumns[sourceRowStart[r] ..
+ * sourceRowStart[r + 1]). Halves the grid until a side would be shorter than
+ * 2 cells, or (when cyclic) a side is odd.
+ * @return true on success, false (with nothing allocated) otherwise.
+ */
+bool createMultigrid(multigrid *mg, size_t rows, size_t columns, const size_t *sourceRowStart,
+		const size_t *sourceColumns, int is_cyclic);
+
+/**
+ * Frees the levels (safe to call on one which was never created).
+ */
+void freeMultigrid(multigrid *mg);
+
+/**
+ * Full multigrid start: restricts the residual of 'grid' down to the coarsest
+ * level & solves there, then interpolates the correction to every finer level
+ * & improves it there with a W-cycle, and finally adds it to the free cells of 'grid'.
+ */
+void startFromCoarseLevels(multigrid *mg, heat_grid *grid);
+
+/**
+ * Coarse grid correction of 'grid': restricts its residual to level 1, solves
+ * for the error there with a W-cycle & adds it back (interpolated) to the free cells.
+ * The passes on 'grid' itself - the smoothing around it - are the caller's.
+ */
+void correctFromCoarseLevels(multigrid *mg, heat_grid *grid);
+
+#endif /* MULTIGRID_H_ */
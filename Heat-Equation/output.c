@@ -0,0 +1,189 @@
+/**
+ * @author Roy Ackerman
+ */
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "output.h"
+
+/**
+ * The bytes of the CSV buffer; it's written once fewer than MAX_CELL_LENGTH are left.
+ */
+#define CSV_BUFFER_SIZE (1 << 16)
+
+/**
+ * The longest "%2.4lf," a double can print (DBL_MAX has 309 digits).
+ */
+#define MAX_CELL_LENGTH 320
+
+/**
+ * Writes the digits of 'number' (at least 'width' of them, 0-padded) at 'out'.
+ * @param out
+ * @param number
+ * @param width
+ * @return the end of the digits.
+ */
+static char *formatDigits(char *out, unsigned long long number, const int width)
+{
+    char digits[24];
+    int length = 0;
+    do
+    {
+        digits[length++] = (char) ('0' + number % 10);
+        number /= 10;
+    } while (number > 0 || length < width);
+
+    while (length > 0)
+    {
+        *out++ = digits[--length];
+    }
+    return out;
+}
+
+/**
+ * Formats 'value' as printf's "%2.4lf," does, at 'out'. The value is scaled to
+ * ten thousandths & rounded to the nearest; the rare ones too close to a tie
+ * for the scaling's rounding error (or too large for it) are left to snprintf,
+ * which rounds the exact binary value.
+ * @param out
+ * @param value
+ * @return the end of the cell.
+ */
+static char *formatCell(char *out, const double value)
+{
+    const double SCALE = 10000; // 4 decimals
+    const double MAX_SCALED = 1e13; // whole numbers are still exact doubles
+    const double HALF = 0.5;
+    const double ERROR_ULPS = 4;
+
+    double scaled = fabs(value) * SCALE;
+    double whole = floor(scaled);
+    double fraction = scaled - whole;
+    if (!(scaled < MAX_SCALED) || fabs(fraction - HALF) <= ERROR_ULPS * DBL_EPSILON * scaled)
+    {
+        return out + snprintf(out, MAX_CELL_LENGTH, "%2.4lf,", value);
+    }
+
+    unsigned long long units = (unsigned long long) whole + (fraction > HALF);
+    if (signbit(value))
+    {
+        *out++ = '-';
+    }
+    out = formatDigits(out, units / (unsigned long long) SCALE, 1);
+    *out++ = '.';
+    out = formatDigits(out, units % (unsigned long long) SCALE, 4);
+    *out++ = ',';
+    return out;
+}
+
+/**
+ * Writes the grid & the calculation's result 'precision' in FORMAT_CSV.
+ * @param out
+ * @param grid
+ * @param precision
+ */
+void writeCsvGrid(FILE *out, const heat_grid *grid, const double precision)
+{
+    char buffer[CSV_BUFFER_SIZE];
+    char *end = buffer + snprintf(buffer, MAX_CELL_LENGTH, "%lf\n", precision);
+
+    for (size_t r = 0; r < grid->rows; ++r)
+    {
+        const double *cells = heatGridRow(grid, r);
+        for (size_t col = 0; col < grid->columns; ++col)
+        {
+            if (end + MAX_CELL_LENGTH > buffer + CSV_BUFFER_SIZE)
+            {
+                fwrite(buffer, 1, (size_t) (end - buffer), out);
+                end = buffer;
+            }
+            end = formatCell(end, cells[col]);
+        }
+        *end++ = '\n';
+    }
+    fwrite(buffer, 1, (size_t) (end - buffer), out);
+}
+
+/**
+ * Checks weather the doubles of this machine are little-endian.
+ */
+static bool isLittleEndian()
+{
+    const uint64_t ONE = 1;
+    unsigned char first;
+    memcpy(&first, &ONE, 1);
+    return first == 1;
+}
+
+/**
+ * Writes 'value' as 8 little-endian bytes at 'out'.
+ * @param out
+ * @param value
+ * @return the end of the bytes.
+ */
+static unsigned char *putLittleEndian(unsigned char *out, uint64_t value)
+{
+    const int BYTES = 8;
+    const int BITS_PER_BYTE = 8;
+
+    for (int i = 0; i < BYTES; ++i)
+    {
+        *out++ = (unsigned char) (value >> (i * BITS_PER_BYTE));
+    }
+    return out;
+}
+
+/**
+ * Writes 'value' as a little-endian double at 'out'.
+ * @param out
+ * @param value
+ * @return the end of the bytes.
+ */
+static unsigned char *putDouble(unsigned char *out, const double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return putLittleEndian(out, bits);
+}
+
+/**
+ * Writes the grid in FORMAT_BINARY: the header, then the rows (as they are on a
+ * little-endian machine, byte by byte otherwise).
+ * @param out
+ * @param grid
+ * @param precision the calculation's result
+ * @param iterations the parameter file's
+ * @param calculation the number of the grid in the run (from 1)
+ */
+void writeBinaryGrid(FILE *out, const heat_grid *grid, const double precision, const unsigned int iterations,
+                     const unsigned int calculation)
+{
+    unsigned char header[sizeof(binary_header)];
+    unsigned char *end = header;
+    memcpy(end, BINARY_MAGIC, BINARY_MAGIC_LENGTH);
+    end += BINARY_MAGIC_LENGTH;
+    end = putLittleEndian(end, grid->rows);
+    end = putLittleEndian(end, grid->columns);
+    end = putLittleEndian(end, iterations);
+    end = putLittleEndian(end, calculation);
+    end = putDouble(end, precision);
+    fwrite(header, 1, (size_t) (end - header), out);
+
+    bool isNative = isLittleEndian();
+    unsigned char bytes[sizeof(double)];
+    for (size_t r = 0; r < grid->rows; ++r)
+    {
+        const double *cells = heatGridRow(grid, r);
+        if (isNative)
+        {
+            fwrite(cells, sizeof(double), grid->columns, out);
+            continue;
+        }
+        for (size_t col = 0; col < grid->columns; ++col)
+        {
+            putDouble(bytes, cells[col]);
+            fwrite(bytes, 1, sizeof(bytes), out);
+        }
+    }
+}
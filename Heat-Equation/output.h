@@ -0,0 +1,59 @@
+/*
+ * output.h
+ *
+ *  Created on: Apr 27, 2018
+ *      Author: OWNER
+ */
+
+#ifndef OUTPUT_H_
+#define OUTPUT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "grid.h"
+
+/**
+ * How the grid is written after every calculation.
+ * FORMAT_TEXT - the precision ("%lf"), then a line per row of "%2.4lf," cells, by printf.
+ * FORMAT_CSV - the very same bytes, with the cells formatted in bulk (without stdio)
+ * into a large buffer which is written at once.
+ * FORMAT_BINARY - a header (see binary_header) followed by the rows x columns cells
+ * as little-endian doubles, row after row.
+ */
+typedef enum
+{
+	FORMAT_TEXT,
+	FORMAT_CSV,
+	FORMAT_BINARY
+} output_format;
+
+#define BINARY_MAGIC "HEATGRID"
+#define BINARY_MAGIC_LENGTH 8
+
+/**
+ * The header of a grid written in FORMAT_BINARY; every field is little-endian.
+ * 'iterations' is the parameter file's number of iterations of a calculation
+ * (0 - until the precision) and 'calculation' counts the grids written by the
+ * run from 1, so a fixed-iterations grid is after iterations * calculation passes.
+ */
+typedef struct
+{
+	char magic[BINARY_MAGIC_LENGTH]; // BINARY_MAGIC, without its '\0'
+	uint64_t rows, columns;
+	uint64_t iterations;
+	uint64_t calculation;
+	double precision; // the calculation's result
+} binary_header;
+
+/**
+ * Writes the grid & the calculation's result 'precision' in FORMAT_CSV.
+ */
+void writeCsvGrid(FILE *out, const heat_grid *grid, double precision);
+
+/**
+ * Writes the grid in FORMAT_BINARY.
+ */
+void writeBinaryGrid(FILE *out, const heat_grid *grid, double precision, unsigned int iterations,
+		unsigned int calculation);
+
+#endif /* OUTPUT_H_ */
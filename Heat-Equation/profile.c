@@ -0,0 +1,297 @@
+/**
+ * @author Roy Ackerman
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "profile.h"
+#include "timings.h"
+
+/**
+ * The hardware counters, in the order of their group (the first leads it).
+ */
+#define NUM_OF_COUNTERS 3
+
+static const uint64_t COUNTER_EVENTS[NUM_OF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                         PERF_COUNT_HW_CACHE_MISSES};
+static const char *const COUNTER_NAMES[NUM_OF_COUNTERS] = {"cycles", "instructions", "llc_misses"};
+static const char *const PHASE_NAMES[NUM_OF_PHASES] = {"parse", "start", "cycle", "tile", "sweep", "reduction",
+                                                        "output"};
+
+/**
+ * A checked pass of the convergence history.
+ */
+typedef struct
+{
+    unsigned int calculation;
+    unsigned int pass;
+    double monitor;
+} monitor_record;
+
+/**
+ * What a phase measured so far, & where its current occurrence began.
+ */
+typedef struct
+{
+    unsigned long long calls;
+    double seconds;
+    uint64_t counts[NUM_OF_COUNTERS];
+    double startSeconds;
+    uint64_t startCounts[NUM_OF_COUNTERS];
+} phase_measure;
+
+struct solver_profile
+{
+    int counters[NUM_OF_COUNTERS]; // the counters' descriptors (-1 - none)
+    bool hasCounters;
+    phase_measure phases[NUM_OF_PHASES];
+    monitor_record *history;
+    size_t historyLength;
+    size_t historyCapacity;
+};
+
+/**
+ * Opens the hardware counter 'event' of the calling thread (user space only)
+ * in the group 'leader' (-1 - it leads a new, disabled group).
+ * @return its descriptor, or -1 if it could not be opened.
+ */
+static int openCounter(const uint64_t event, const int leader)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = event;
+    attr.disabled = (leader == -1);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+/**
+ * Closes the profile's counters.
+ * @param profile
+ */
+static void closeCounters(solver_profile *profile)
+{
+    for (int i = 0; i < NUM_OF_COUNTERS; ++i)
+    {
+        if (profile->counters[i] != -1)
+        {
+            close(profile->counters[i]);
+            profile->counters[i] = -1;
+        }
+    }
+    profile->hasCounters = false;
+}
+
+/**
+ * Opens the counters as a single group & enables it; a counter which can't be
+ * opened (no permission, or no such event on the machine) closes them all.
+ * @param profile
+ */
+static void openCounters(solver_profile *profile)
+{
+    profile->hasCounters = true;
+    for (int i = 0; i < NUM_OF_COUNTERS && profile->hasCounters; ++i)
+    {
+        profile->counters[i] = openCounter(COUNTER_EVENTS[i], profile->counters[0]);
+        if (profile->counters[i] == -1)
+        {
+            closeCounters(profile);
+        }
+    }
+
+    if (profile->hasCounters && ioctl(profile->counters[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) == -1)
+    {
+        closeCounters(profile);
+    }
+}
+
+/**
+ * Reads the group of counters into 'counts' (zeros if the profile has none).
+ * @param profile
+ * @param counts
+ */
+static void readCounters(const solver_profile *profile, uint64_t counts[NUM_OF_COUNTERS])
+{
+    struct
+    {
+        uint64_t number;
+        uint64_t values[NUM_OF_COUNTERS];
+    } group = {0, {0}};
+
+    if (profile->hasCounters && read(profile->counters[0], &group, sizeof(group)) == (ssize_t) sizeof(group))
+    {
+        memcpy(counts, group.values, sizeof(group.values));
+        return;
+    }
+    memset(counts, 0, NUM_OF_COUNTERS * sizeof(uint64_t));
+}
+
+/**
+ * Creates an empty profile, with the hardware counters if they're asked for (& can be opened).
+ */
+solver_profile *createProfile(const bool use_counters)
+{
+    solver_profile *profile = (solver_profile *) calloc(1, sizeof(solver_profile));
+    if (profile == NULL)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < NUM_OF_COUNTERS; ++i)
+    {
+        profile->counters[i] = -1;
+    }
+    if (use_counters)
+    {
+        openCounters(profile);
+    }
+    return profile;
+}
+
+/**
+ * Keeps the time & the counts at the beginning of the phase's occurrence.
+ */
+void beginPhase(solver_profile *profile, const profile_phase phase)
+{
+    if (profile == NULL)
+    {
+        return;
+    }
+
+    phase_measure *measure = &profile->phases[phase];
+    readCounters(profile, measure->startCounts);
+    measure->startSeconds = monotonicSeconds();
+}
+
+/**
+ * Adds the time & the counts since the beginning of the phase's occurrence to it.
+ */
+void endPhase(solver_profile *profile, const profile_phase phase)
+{
+    if (profile == NULL)
+    {
+        return;
+    }
+
+    phase_measure *measure = &profile->phases[phase];
+    double now = monotonicSeconds();
+    uint64_t counts[NUM_OF_COUNTERS];
+    readCounters(profile, counts);
+
+    ++measure->calls;
+    measure->seconds += now - measure->startSeconds;
+    for (int i = 0; i < NUM_OF_COUNTERS; ++i)
+    {
+        measure->counts[i] += counts[i] - measure->startCounts[i];
+    }
+}
+
+/**
+ * Appends a checked pass to the history, which grows geometrically.
+ */
+bool recordMonitor(solver_profile *profile, const unsigned int calculation, const unsigned int pass,
+                   const double monitor)
+{
+    const size_t INITIAL_CAPACITY = 64;
+    const size_t GROWTH_FACTOR = 2;
+
+    if (profile == NULL)
+    {
+        return true;
+    }
+
+    if (profile->historyLength == profile->historyCapacity)
+    {
+        size_t capacity = (profile->historyCapacity == 0) ? INITIAL_CAPACITY
+                                                          : GROWTH_FACTOR * profile->historyCapacity;
+        monitor_record *grown = realloc(profile->history, capacity * sizeof(monitor_record));
+        if (grown == NULL)
+        {
+            return false;
+        }
+        profile->history = grown;
+        profile->historyCapacity = capacity;
+    }
+
+    monitor_record record = {calculation, pass, monitor};
+    profile->history[profile->historyLength++] = record;
+    return true;
+}
+
+/**
+ * Writes a phase's measures as a JSON object.
+ * @param out
+ * @param profile
+ * @param measure
+ */
+static void writePhase(FILE *out, const solver_profile *profile, const phase_measure *measure)
+{
+    fprintf(out, "{\"calls\": %llu, \"seconds\": %.9f", measure->calls, measure->seconds);
+    if (profile->hasCounters)
+    {
+        for (int i = 0; i < NUM_OF_COUNTERS; ++i)
+        {
+            fprintf(out, ", \"%s\": %llu", COUNTER_NAMES[i], (unsigned long long) measure->counts[i]);
+        }
+    }
+    fprintf(out, "}");
+}
+
+/**
+ * Writes the phases & the history as a single JSON object.
+ */
+bool writeProfile(const solver_profile *profile, const char *path)
+{
+    const char *STANDARD_ERROR = "-";
+
+    bool isStandardError = strcmp(path, STANDARD_ERROR) == 0;
+    FILE *out = isStandardError ? stderr : fopen(path, "w");
+    if (out == NULL)
+    {
+        return false;
+    }
+
+    fprintf(out, "{\"hardware_counters\": %s, \"phases\": {", profile->hasCounters ? "true" : "false");
+    for (int phase = 0; phase < NUM_OF_PHASES; ++phase)
+    {
+        fprintf(out, "%s\"%s\": ", (phase == 0) ? "" : ", ", PHASE_NAMES[phase]);
+        writePhase(out, profile, &profile->phases[phase]);
+    }
+    fprintf(out, "}, \"history\": [");
+    for (size_t i = 0; i < profile->historyLength; ++i)
+    {
+        const monitor_record *record = &profile->history[i];
+        fprintf(out, "%s{\"calculation\": %u, \"pass\": %u, \"monitor\": %.17g}", (i == 0) ? "" : ", ",
+                record->calculation, record->pass, record->monitor);
+    }
+    fprintf(out, "]}\n");
+
+    return isStandardError ? fflush(out) == 0 : fclose(out) == 0;
+}
+
+/**
+ * Closes the counters & frees the profile.
+ * @param profile
+ */
+void destroyProfile(solver_profile *profile)
+{
+    if (profile == NULL)
+    {
+        return;
+    }
+
+    closeCounters(profile);
+    free(profile->history);
+    free(profile);
+}
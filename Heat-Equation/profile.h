@@ -0,0 +1,82 @@
+/*
+ * profile.h
+ *
+ *  Created on: Apr 30, 2018
+ *      Author: OWNER
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdbool.h>
+
+/**
+ * The phases a profile times.
+ * PHASE_PARSE - reading the parameter file & creating the grid.
+ * PHASE_START - the solve which starts a calculation (multigrid's coarse levels,
+ * conjugate gradients or the mixed precision refinement).
+ * PHASE_CYCLE - multigrid's cycles, but for their counted passes.
+ * PHASE_TILE - the time tiles of Jacobi runs (each of which advances several passes).
+ * PHASE_SWEEP - the (counted) passes, with the row sums & norms fused into them.
+ * PHASE_REDUCTION - summing the grid & combining the rows' sums & norms.
+ * PHASE_OUTPUT - printing the grids.
+ */
+typedef enum
+{
+	PHASE_PARSE,
+	PHASE_START,
+	PHASE_CYCLE,
+	PHASE_TILE,
+	PHASE_SWEEP,
+	PHASE_REDUCTION,
+	PHASE_OUTPUT,
+	NUM_OF_PHASES
+} profile_phase;
+
+/**
+ * The instrumentation of a run: for every phase, its calls, wall seconds and
+ * (if the hardware counters could be opened) the cycles, instructions & last
+ * level cache misses of the thread which runs it, counted by perf_event_open -
+ * the pool's workers aren't counted. It also keeps the convergence history:
+ * the monitor of every checked pass.
+ * Every function takes a NULL profile and does nothing with it, so a run
+ * without a profile pays a single test per phase.
+ */
+typedef struct solver_profile solver_profile;
+
+/**
+ * Creates an empty profile, which reads the hardware counters if 'use_counters'
+ * and they can be opened.
+ * @return the profile, or NULL if it could not be allocated.
+ */
+solver_profile *createProfile(bool use_counters);
+
+/**
+ * Starts timing (& counting) an occurrence of 'phase'.
+ */
+void beginPhase(solver_profile *profile, profile_phase phase);
+
+/**
+ * Adds the time (& counts) since the phase's beginPhase to it.
+ */
+void endPhase(solver_profile *profile, profile_phase phase);
+
+/**
+ * Adds the monitor of the checked pass 'pass' of the calculation 'calculation'
+ * to the convergence history.
+ * @return true on success, false if the history could not grow (it stays as it was).
+ */
+bool recordMonitor(solver_profile *profile, unsigned int calculation, unsigned int pass, double monitor);
+
+/**
+ * Writes the profile as JSON into the file 'path' ("-" - the standard error).
+ * @return true on success, false if the file could not be written.
+ */
+bool writeProfile(const solver_profile *profile, const char *path);
+
+/**
+ * Closes the counters & frees the profile (NULL is allowed).
+ */
+void destroyProfile(solver_profile *profile);
+
+#endif /* PROFILE_H_ */
@@ -1,12 +1,29 @@
 /**
  * @author Roy Ackerman
  */
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
 #include <malloc.h>
 #include <memory.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include "calculator.h"
 #include "heat_eqn.h"
+#include "kernels.h"
+#include "output.h"
+#include "profile.h"
+#include "scanner.h"
+#include "threadpool.h"
+#include "timings.h"
+#include "volume.h"
+#include "warmstart.h"
+#ifdef HEAT_MPI
+#include <mpi.h>
+#include "distributed.h"
+#endif
 
 #define SUCCESS true;
 #define FAILURE false;
@@ -14,7 +31,39 @@
 // ........................................ Error messages ............................... //
 const char *READING_FILE_ERR = "Error while reading file.";
 const char *ALLOCATING_MEMORY_ERR = "Unable to allocate memory.";
-const char *SINGLE_ARG_MSG = "Usage: heatSolve <parameter file>.\n";
+const char *SINGLE_ARG_MSG = "Usage: heatSolve [options] <parameter file>...\n"
+                            "Options: --sweep=gauss-seidel|jacobi|red-black\n"
+                            "         --simd=auto|scalar|sse2|avx2|avx512\n"
+                            "         --threads=<n> (0 - all the processors, shared by a batch's jobs)\n"
+                            "         --time-tile=<passes> (Jacobi with a fixed number of iterations)\n"
+                            "         --active-tiles (skips the tiles of the grid which can't change)\n"
+                            "         --volume-block=<rows> (of the blocks of a 3D pass, 0 - sized to the cache)\n"
+                            "         --monitor=sum|l1|l2|max (what is compared with the precision)\n"
+                            "         --check-every=<passes> (how often it is compared)\n"
+                            "         --solver=passes|multigrid|cg|mixed (of a run until the precision)\n"
+                            "         --preconditioner=jacobi|ssor (of cg)\n"
+                            "         --relax=none|sor|chebyshev (over-relaxation of in-place sweeps)\n"
+                            "         --omega=grid|adaptive|<factor> (the factor of the over-relaxation)\n"
+                            "         --format=text|csv|binary (of the output)\n"
+                            "         --snapshot-every=<passes> --snapshot-file=<path> (frames written\n"
+                            "           in the background, binary if the format is, CSV otherwise)\n"
+                            "         --checkpoint-every=<passes> --checkpoint-file=<path> (the state of the\n"
+                            "           solve, mapped into the file)\n"
+                            "         --checkpoint-sync=<seconds> (how often the file is synced to the disk)\n"
+                            "         --resume=<path> (goes on from the latest checkpoint in the file, with\n"
+                            "           the same parameter file & solver options)\n"
+                            "         --manifest=<path> (a file listing parameter files, separated by white-space)\n"
+                            "         --jobs=<n> (the parameter files solved at once, 0 - one per processor)\n"
+                            "         --timings=<path> (appends the run's phase times & throughput as a JSON line)\n"
+                            "         --profile=<path> (writes the phases' times & the convergence history as JSON,\n"
+                            "           '-' - to the standard error; HEAT_PROFILE=<path> in the environment too)\n"
+                            "         --profile-counters (adds the cycles, instructions & LLC misses of the phases;\n"
+                            "           HEAT_PROFILE_COUNTERS=1 in the environment too)\n"
+                            "         --warm-cache=<directory> (a run until the precision starts from the solution\n"
+                            "           in the directory nearest to its sources, and keeps its own solution there)\n"
+                            "Given more than one parameter file (or a manifest), every one's grids are written\n"
+                            "to <parameter file>.out, in the order of the files (without snapshots, checkpoints, timings & profiles).\n"
+                            "A 3D file (\"n, m, k\" & \"x, y, z, value\" sources) prints its k planes one after the other.\n";
 const char *FILE_STRUCTURE_ERROR_MSG = "The file structure is invalid.\n";
 const char *CREATE_SOURCES_ERROR = "Error while creating sources.\n";
 const char *SEPARATOR_OR_CALC_AREA_ERROR = "Error while reading separator\\calculation-area coordinates from file.\n";
@@ -22,71 +71,380 @@ const char *SEPARATOR_OR_SOURCES_ERROR = "Error while reading separator\\sources
 const char *READ_PRECISION_ERROR = "Error while reading precision from file.\n";
 const char *READ_ITERATIONS_ERROR = "Error while reading number of iterations from file.\n";
 const char *IS_CYCLE_ERROR = "Error while reading is-cycle value from file.\n";
+const char *SNAPSHOT_FILE_ERR = "Unable to start writing the snapshots.";
+const char *CHECKPOINT_FILE_ERR = "Unable to map the checkpoint file.";
+const char *CHECKPOINT_SYNC_ERR = "Unable to sync the checkpoint file.";
+const char *RESUME_ERR = "The checkpoint file holds no checkpoint of this run.";
+const char *WRITING_FILE_ERR = "Error while writing file.";
+const char *BATCH_CASE_FAILED_MSG = "%s: failed (exit code %d).\n";
+const char *TIMINGS_FILE_ERR = "Unable to write the timings.";
+const char *PROFILE_FILE_ERR = "Unable to write the profile.";
+const char *WARM_CACHE_ERR = "Unable to open the warm start directory.";
+const char *VOLUME_OPTIONS_ERR = "A 3D file is solved by Gauss-Seidel or Jacobi passes only "
+                                 "(without snapshots, checkpoints, warm starts or processes).";
+const char *DROPPED_SNAPSHOTS_MSG = "%u snapshots were dropped (their writer fell behind).\n";
 
 
 // ........................................ Error handling ............................... //
+const int SUCCESSFULLY = 0;
 const int READING_FILE_ERROR = 1;
 const int FILE_STRUCTURE_ERROR = 2;
 const int MEMORY_ALLOCATION_ERROR = 3;
+const int WRITING_FILE_ERROR = 4;
 const int ILEGAL_NUMBER_ERROR = -1;
 const double CONVERSION_ERROR = 0.0;
 
 
+// ........................................ Options ............................... //
+const char *SWEEP_OPTION = "--sweep=";
+const char *const SWEEP_NAMES[] = {"gauss-seidel", "jacobi", "red-black"}; // by sweep_order
+const char *SIMD_OPTION = "--simd=";
+const char *const SIMD_NAMES[] = {"auto", "scalar", "sse2", "avx2", "avx512"}; // by simd_level
+const char *THREADS_OPTION = "--threads=";
+const char *TIME_TILE_OPTION = "--time-tile=";
+const char *ACTIVE_TILES_OPTION = "--active-tiles";
+const char *VOLUME_BLOCK_OPTION = "--volume-block=";
+const char *MONITOR_OPTION = "--monitor=";
+const char *const MONITOR_NAMES[] = {"sum", "l1", "l2", "max"}; // by convergence_monitor
+const char *CHECK_EVERY_OPTION = "--check-every=";
+const char *SOLVER_OPTION = "--solver=";
+const char *const SOLVER_NAMES[] = {"passes", "multigrid", "cg", "mixed"}; // by solver_method
+const char *PRECONDITIONER_OPTION = "--preconditioner=";
+const char *const PRECONDITIONER_NAMES[] = {"jacobi", "ssor"}; // by preconditioner_kind
+const char *RELAX_OPTION = "--relax=";
+const char *const RELAX_NAMES[] = {"none", "sor", "chebyshev"}; // by relaxation_method
+const char *OMEGA_OPTION = "--omega=";
+const char *const OMEGA_NAMES[] = {"grid", "adaptive"};
+const double OMEGA_VALUES[] = {OMEGA_FROM_GRID, OMEGA_ADAPTIVE}; // by OMEGA_NAMES
+const char *FORMAT_OPTION = "--format=";
+const char *const FORMAT_NAMES[] = {"text", "csv", "binary"}; // by output_format
+const char *SNAPSHOT_EVERY_OPTION = "--snapshot-every=";
+const char *SNAPSHOT_FILE_OPTION = "--snapshot-file=";
+const char *CHECKPOINT_EVERY_OPTION = "--checkpoint-every=";
+const char *CHECKPOINT_FILE_OPTION = "--checkpoint-file=";
+const char *CHECKPOINT_SYNC_OPTION = "--checkpoint-sync=";
+const char *RESUME_OPTION = "--resume=";
+const char *MANIFEST_OPTION = "--manifest=";
+const char *JOBS_OPTION = "--jobs=";
+const char *TIMINGS_OPTION = "--timings=";
+const char *PROFILE_OPTION = "--profile=";
+const char *PROFILE_COUNTERS_OPTION = "--profile-counters";
+const char *PROFILE_VARIABLE = "HEAT_PROFILE"; // the environment's --profile
+const char *WARM_CACHE_OPTION = "--warm-cache=";
+const char *PROFILE_COUNTERS_VARIABLE = "HEAT_PROFILE_COUNTERS"; // the environment's --profile-counters (if "1")
+const char *OPTION_PREFIX = "--";
+
+
 // ........................................ General constants ............................... //
 const char *SEPARATOR = "----\n";
 const int SEPARATOR_LENGTH = 4;
 const int MIN_MATRIX_INDEX = 0;
+const int PRINTING_RANK = 0; // the process which holds the whole grid & prints it
+const char *BATCH_OUTPUT_SUFFIX = ".out"; // of a batch's output files
+
+/**
+ * What a checkpoint belongs to: the parameter file & the options which change
+ * the passes (followed by the sources).
+ */
+typedef struct
+{
+    size_t rows, columns;
+    double terminate;
+    unsigned int iterations;
+    int isCyclic;
+    size_t numOfSources;
+    sweep_order order;
+    convergence_monitor monitor;
+    unsigned int checkInterval;
+    solver_method solver;
+    relaxation_method relaxation;
+    double omega;
+    preconditioner_kind preconditioner;
+} checkpoint_problem;
+
+/**
+ * A parameter file & its calculations: what's read from the file, the grid it
+ * heats & the grids printed so far (a batch holds one per parameter file).
+ */
+typedef struct
+{
+    size_t rows, columns; // the n,m of the matrix (accordingly)
+    double terminateValue;
+    unsigned int iterationNumber;
+    int isCyclic;
+    size_t planes; // the k of a 3D file (0 - a 2D one), whose planes are stacked in 'grid' (see heat_volume)
+    source_point *sources; // A source_pint array
+    volume_source *volumeSources; // instead of 'sources' in a 3D file
+    size_t numOfSources;
+    heat_grid grid; // one aligned block, see grid.h
+    unsigned int calculations; // the grids printed so far
+    unsigned long long passes; // of the calculations so far
+    double solveSeconds, outputSeconds; // of the calculations & printing their grids so far
+} heat_case;
 
 
 // ............................................. Fields .................................... //
-size_t gRows, gColumns; // the n,m of the matrix (accordingly)
-double gTerminateValue;
-unsigned int gIterationNumber;
-int gIsCyclic;
-source_point *gSources; // A source_pint array
-size_t gNumOfSources;
-double **grid;
+solver_options gOptions;
+int gRank; // of the process (0 unless distributed)
+output_format gFormat;
+const char *gSnapshotPath; // NULL unless given
+const char *gCheckpointPath; // NULL unless given
+unsigned int gCheckpointSync; // the seconds between syncs of the checkpoint file
+const char *gResumePath; // NULL unless given
+solver_state gResumeState;
+const char *gManifestPath; // NULL unless given
+unsigned int gJobs; // the parameter files of a batch solved at once (0 - one per processor)
+const char **gParameterFiles; // of the command line
+size_t gNumOfParameterFiles;
+const char *gTimingsPath; // NULL unless given
+const char *gProfilePath; // NULL unless given
+bool gUseProfileCounters;
+const char *gWarmCachePath; // NULL unless given
+
 
 /**
- * Free the source_point array: gSources.
+ * Free the source_point array: run->sources.
  */
-void freeSources()
+void freeSources(heat_case *run)
 {
-    if (gSources != NULL)
+    if (run->sources != NULL)
     {
-        free(gSources);
+        free(run->sources);
     }
+    free(run->volumeSources);
 }
 
 /**
  * Free the grid array.
  */
-void freeGrid()
+void freeGrid(heat_case *run)
+{
+    freeHeatGrid(&run->grid);
+}
+
+/**
+ * Starts the snapshot writer if the options ask for snapshots (only the printing
+ * process holds the whole grid, and only the calculator's passes are snapshotted).
+ * @return SUCCESS if succeed, otherwise (the file or the buffers) return FAILURE.
+ */
+bool startSnapshots(const heat_case *run)
 {
-    for (size_t i = 0; i < gRows; ++i)
+    const unsigned int NO_SNAPSHOTS = 0;
+
+    if (gOptions.snapshot_interval == NO_SNAPSHOTS || gRank != PRINTING_RANK)
     {
-        if (grid[i] != NULL)
-        {
-            free(grid[i]);
-        }
+        return SUCCESS;
+    }
+
+    gOptions.snapshots = createSnapshotWriter(gSnapshotPath, run->rows, run->columns, gFormat == FORMAT_BINARY);
+    if (gOptions.snapshots == NULL)
+    {
+        return FAILURE;
     }
 
-    if (grid != NULL)
+    return SUCCESS;
+}
+
+/**
+ * Finishes writing the snapshots, telling how many were dropped.
+ */
+void stopSnapshots()
+{
+    unsigned int dropped = closeSnapshotWriter(gOptions.snapshots);
+    gOptions.snapshots = NULL;
+    if (dropped > 0)
     {
-        free(grid);
+        fprintf(stderr, DROPPED_SNAPSHOTS_MSG, dropped);
     }
 }
 
 /**
- * Frees the whole memory.
+ * Describes the run for its checkpoints: a checkpoint_problem (with its padding
+ * cleared, since it's compared by its bytes) followed by the sources.
+ * @param size output parameter: the description's size.
+ * @return the description (which the caller frees), or NULL if it could not be allocated.
+ */
+void *describeProblem(const heat_case *run, size_t *size)
+{
+    *size = sizeof(checkpoint_problem) + run->numOfSources * sizeof(source_point);
+    unsigned char *problem = calloc(1, *size);
+    if (problem == NULL)
+    {
+        return NULL;
+    }
+
+    checkpoint_problem *header = (checkpoint_problem *) problem;
+    header->rows = run->rows;
+    header->columns = run->columns;
+    header->terminate = run->terminateValue;
+    header->iterations = run->iterationNumber;
+    header->isCyclic = run->isCyclic;
+    header->numOfSources = run->numOfSources;
+    header->order = gOptions.order;
+    header->monitor = gOptions.monitor;
+    header->checkInterval = gOptions.check_interval;
+    header->solver = gOptions.solver;
+    header->relaxation = gOptions.relaxation;
+    header->omega = gOptions.omega;
+    header->preconditioner = gOptions.preconditioner;
+    if (run->numOfSources > 0)
+    {
+        memcpy(problem + sizeof(checkpoint_problem), run->sources, run->numOfSources * sizeof(source_point));
+    }
+    return problem;
+}
+
+/**
+ * Loads the grid & the calculator's state from the latest checkpoint of the
+ * resumed file (if one is given), so the first calculation goes on from there.
+ * @return SUCCESS if succeed, otherwise (no checkpoint of this run) return FAILURE.
+ */
+bool resumeCheckpoint(heat_case *run)
+{
+    if (gResumePath == NULL)
+    {
+        return SUCCESS;
+    }
+
+    size_t size;
+    void *problem = describeProblem(run, &size);
+    bool isLoaded = problem != NULL &&
+                    loadCheckpoint(gResumePath, problem, size, &run->grid, &run->calculations, &gResumeState);
+    free(problem);
+    if (isLoaded == false)
+    {
+        return FAILURE;
+    }
+
+    gOptions.resume = &gResumeState;
+    return SUCCESS;
+}
+
+/**
+ * Maps the checkpoint file if the options ask for checkpoints.
+ * @return SUCCESS if succeed, otherwise (the file) return FAILURE.
+ */
+bool startCheckpoints(const heat_case *run)
+{
+    const unsigned int NO_CHECKPOINTS = 0;
+
+    if (gOptions.checkpoint_interval == NO_CHECKPOINTS)
+    {
+        return SUCCESS;
+    }
+
+    size_t size;
+    void *problem = describeProblem(run, &size);
+    if (problem != NULL)
+    {
+        gOptions.checkpoints = createCheckpointFile(gCheckpointPath, run->rows, run->columns, problem, size,
+                                                    gCheckpointSync);
+    }
+    free(problem);
+    if (gOptions.checkpoints == NULL)
+    {
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/**
+ * Syncs & closes the checkpoint file.
+ */
+void stopCheckpoints()
+{
+    if (closeCheckpointFile(gOptions.checkpoints) == false)
+    {
+        perror(CHECKPOINT_SYNC_ERR);
+    }
+    gOptions.checkpoints = NULL;
+}
+
+/**
+ * Creates the profile if one is asked for - by the options, or else by the
+ * environment (only the printing process profiles itself).
+ * @return SUCCESS if succeed, otherwise (out of memory) return FAILURE.
+ */
+bool startProfile()
+{
+    const char *COUNTERS_ON = "1";
+
+    if (gProfilePath == NULL)
+    {
+        gProfilePath = getenv(PROFILE_VARIABLE);
+    }
+    if (gProfilePath == NULL || *gProfilePath == '\0' || gRank != PRINTING_RANK)
+    {
+        return SUCCESS;
+    }
+
+    const char *counters = getenv(PROFILE_COUNTERS_VARIABLE);
+    gUseProfileCounters = gUseProfileCounters || (counters != NULL && strcmp(counters, COUNTERS_ON) == 0);
+    gOptions.profile = createProfile(gUseProfileCounters);
+    return gOptions.profile != NULL;
+}
+
+/**
+ * Frees the profile (if there is one).
+ */
+void stopProfile()
+{
+    destroyProfile(gOptions.profile);
+    gOptions.profile = NULL;
+}
+
+/**
+ * Creates the warm start cache if a directory is given (shared by the batch's workers).
+ * @return SUCCESS if succeed, otherwise (the directory or the memory) return FAILURE.
+ */
+bool startWarmCache()
+{
+    if (gWarmCachePath == NULL)
+    {
+        return SUCCESS;
+    }
+
+    gOptions.warm_cache = createSolutionCache(WARM_START_ENTRIES, gWarmCachePath);
+    return gOptions.warm_cache != NULL;
+}
+
+/**
+ * Frees the warm start cache (if there is one); its solutions stay in the directory.
+ */
+void stopWarmCache()
+{
+    destroySolutionCache(gOptions.warm_cache);
+    gOptions.warm_cache = NULL;
+}
+
+/**
+ * Frees the memory of a parameter file.
  */
-void freeMemory()
+void freeCase(heat_case *run)
 {
     // Free the source_point array
-    freeSources();
+    freeSources(run);
 
     // Free the grid array
-    freeGrid();
+    freeGrid(run);
+}
+
+/**
+ * Frees the whole memory.
+ */
+void freeMemory(heat_case *run)
+{
+    // Stop the snapshot writer (after it wrote what's queued)
+    stopSnapshots();
+
+    // Close the checkpoint file (after syncing the latest checkpoint)
+    stopCheckpoints();
+
+    // Free the profile
+    stopProfile();
+
+    freeCase(run);
 }
 
 /**
@@ -96,9 +454,9 @@ void freeMemory()
  * @param y coordinate
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool isInsideMatrix(const int x, const int y)
+bool isInsideMatrix(const heat_case *run, const int x, const int y)
 {
-    return (x >= MIN_MATRIX_INDEX) && (x < (int)gRows) && (y >= MIN_MATRIX_INDEX) && (y < (int)gColumns);
+    return (x >= MIN_MATRIX_INDEX) && (x < (int)run->rows) && (y >= MIN_MATRIX_INDEX) && (y < (int)run->columns);
 }
 
 /**
@@ -110,9 +468,9 @@ bool isInsideMatrix(const int x, const int y)
  * @param heatLevel
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool createSource(source_point *source, const int x, const int y, const float heatLevel)
+bool createSource(const heat_case *run, source_point *source, const int x, const int y, const float heatLevel)
 {
-    if (isInsideMatrix(x, y))
+    if (isInsideMatrix(run, x, y))
     {
         source->x = x;
         source->y = y;
@@ -124,42 +482,159 @@ bool createSource(source_point *source, const int x, const int y, const float he
     return FAILURE;
 }
 
+/**
+ * Reads a single source line: " %d, %d, %f " (the trailing white-space is only
+ * skipped after a whole source, like fscanf does).
+ * @param file
+ * @param x
+ * @param y
+ * @param heatLevel
+ * @return SUCCESS if a whole source was read, otherwise return FAILURE.
+ */
+bool scanSource(text_scanner *file, int *x, int *y, float *heatLevel)
+{
+    const char COMMA = ',';
+
+    skipWhitespace(file);
+    if (scanInt(file, x) && scanLiteral(file, COMMA) && scanInt(file, y) && scanLiteral(file, COMMA) &&
+        scanFloat(file, heatLevel))
+    {
+        skipWhitespace(file);
+        return SUCCESS;
+    }
+
+    return FAILURE;
+}
+
+/**
+ * checks weather the coordinate (x,y,z) is inside the volume bounds.
+ * @param x coordinate
+ * @param y coordinate
+ * @param z the plane
+ * @return SUCCESS if succeed, otherwise return FAILURE.
+ */
+bool isInsideVolume(const heat_case *run, const int x, const int y, const int z)
+{
+    return isInsideMatrix(run, x, y) && (z >= MIN_MATRIX_INDEX) && (z < (int) run->planes);
+}
+
+/**
+ * Reads a single source line of a 3D file: " %d, %d, %d, %f ".
+ * @param file
+ * @param x
+ * @param y
+ * @param z
+ * @param heatLevel
+ * @return SUCCESS if a whole source was read, otherwise return FAILURE.
+ */
+bool scanVolumeSource(text_scanner *file, int *x, int *y, int *z, float *heatLevel)
+{
+    const char COMMA = ',';
+
+    skipWhitespace(file);
+    if (scanInt(file, x) && scanLiteral(file, COMMA) && scanInt(file, y) && scanLiteral(file, COMMA) &&
+        scanInt(file, z) && scanLiteral(file, COMMA) && scanFloat(file, heatLevel))
+    {
+        skipWhitespace(file);
+        return SUCCESS;
+    }
+
+    return FAILURE;
+}
+
+/**
+ * Creates and initializes the sources array of a 3D file, like getSources.
+ * @param file
+ * @return SUCCESS if succeed, otherwise return FAILURE.
+ */
+bool getVolumeSources(heat_case *run, text_scanner *file)
+{
+    const size_t INITIAL_CAPACITY = 64;
+    const size_t GROWTH_FACTOR = 2;
+
+    int x, y, z; // coordinates
+    float heatLevel;
+    size_t capacity = INITIAL_CAPACITY;
+
+    run->numOfSources = 0;
+    run->volumeSources = (volume_source *) malloc(capacity * sizeof(volume_source));
+    if (run->volumeSources == NULL)
+    {
+        perror(ALLOCATING_MEMORY_ERR);
+        return FAILURE;
+    }
+
+    while (scanVolumeSource(file, &x, &y, &z, &heatLevel))
+    {
+        if (run->numOfSources == capacity)
+        {
+            volume_source *grown = realloc(run->volumeSources, GROWTH_FACTOR * capacity * sizeof(volume_source));
+            if (grown == NULL)
+            {
+                perror(ALLOCATING_MEMORY_ERR);
+                return FAILURE;
+            }
+            run->volumeSources = grown;
+            capacity *= GROWTH_FACTOR;
+        }
+
+        if (isInsideVolume(run, x, y, z) == false)
+        {
+            perror(CREATE_SOURCES_ERROR);
+            return FAILURE;
+        }
+        volume_source source = {x, y, z, heatLevel};
+        run->volumeSources[run->numOfSources++] = source;
+    }
+
+    return SUCCESS;
+}
+
 /**
  * Creates and initializes the sources array acoording to the input file.
+ * The array grows geometrically, so the sources are copied a constant number
+ * of times on average.
  * @param file
  * @param numOfSources
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool getSources(FILE *file, size_t *numOfSources)
+bool getSources(heat_case *run, text_scanner *file)
 {
-    const int NUM_OF_INPUTS_IN_SOURCE = 3;
+    const size_t INITIAL_CAPACITY = 64;
+    const size_t GROWTH_FACTOR = 2;
 
     int x, y; // coordinates
     float heatLevel;
     size_t sources_counter = 0;
+    size_t capacity = INITIAL_CAPACITY;
 
-    gSources = (source_point *) malloc(1); // just for realloc
-    if (gSources == NULL)
+    run->sources = (source_point *) malloc(capacity * sizeof(source_point));
+    if (run->sources == NULL)
     {
         perror(ALLOCATING_MEMORY_ERR);
         return FAILURE;
     }
 
-    while (fscanf(file, " %d, %d, %f ", &x, &y, &heatLevel) == NUM_OF_INPUTS_IN_SOURCE)
+    while (scanSource(file, &x, &y, &heatLevel))
     {
-        gSources = realloc(gSources, (sources_counter + 1) * sizeof(source_point));
-        if (gSources == NULL)
+        if (sources_counter == capacity)
         {
-            perror(ALLOCATING_MEMORY_ERR);
-            return FAILURE;
+            source_point *grown = realloc(run->sources, GROWTH_FACTOR * capacity * sizeof(source_point));
+            if (grown == NULL)
+            {
+                perror(ALLOCATING_MEMORY_ERR);
+                return FAILURE;
+            }
+            run->sources = grown;
+            capacity *= GROWTH_FACTOR;
         }
 
-        if (createSource(&gSources[sources_counter++], x, y, heatLevel) == false)
+        if (createSource(run, &run->sources[sources_counter++], x, y, heatLevel) == false)
         {
             return FAILURE;
         }
 
-        *numOfSources = sources_counter;
+        run->numOfSources = sources_counter;
     }
 
     return SUCCESS;
@@ -180,7 +655,7 @@ bool isSeparator(char *string)
  * @param file
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool getSeparator(FILE *file)
+bool getSeparator(text_scanner *file)
 {
     const int EXTRA = 2; // will read extra for 'null-terminator' and '\n'.
 
@@ -191,8 +666,7 @@ bool getSeparator(FILE *file)
         return FAILURE;
     }
 
-    fgets(line, SEPARATOR_LENGTH + EXTRA, file);
-    if (isSeparator(line))
+    if (scanLine(file, line, SEPARATOR_LENGTH + EXTRA) && isSeparator(line))
     {
         free(line);
         return SUCCESS;
@@ -220,11 +694,11 @@ bool isSpace(const char c)
  * @param file
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool nextLine(FILE *file)
+bool nextLine(text_scanner *file)
 {
     char NEW_LINE = '\n';
 
-    int nextChar = fgetc(file);
+    int nextChar = scanChar(file);
     while (nextChar != NEW_LINE)
     {
         if (!isSpace((char) nextChar))
@@ -232,7 +706,7 @@ bool nextLine(FILE *file)
             return FAILURE;
         }
 
-        nextChar = fgetc(file);
+        nextChar = scanChar(file);
     }
 
     return SUCCESS;
@@ -252,29 +726,46 @@ bool validatesArea(int n, int m)
 
 /**
  * Reads the number of the rows & columns from the file
- * by reading the first 2 integers.
+ * by reading the first 2 integers, and the number of the planes of a 3D file
+ * by a third one.
  * @param file
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool getCalcArea(FILE *file)
+bool getCalcArea(heat_case *run, text_scanner *file)
 {
-    const int ROWS_AND_COLS_NUMBERS = 2;
+    const char COMMA = ',';
+    const char NEW_LINE = '\n';
 
-    int n, m; // Rows and columns
+    int n, m, k; // Rows, columns and planes
 
-    if (fscanf(file, "%d , %d", &n, &m) == ROWS_AND_COLS_NUMBERS && validatesArea(n, m))
+    // "%d , %d"
+    bool isScanned = scanInt(file, &n);
+    skipWhitespace(file);
+    isScanned = isScanned && scanLiteral(file, COMMA) && scanInt(file, &m);
+    if (!isScanned || !validatesArea(n, m))
     {
-        gRows = (size_t) n;
-        gColumns = (size_t) m;
-        if (nextLine(file) == false)
-        {
-            return FAILURE;
-        }
+        return FAILURE;
+    }
+    run->rows = (size_t) n;
+    run->columns = (size_t) m;
 
+    // The rest of the line, or ", %d" & then the rest of the line
+    int nextChar = scanChar(file);
+    while (isSpace((char) nextChar))
+    {
+        nextChar = scanChar(file);
+    }
+    if (nextChar == NEW_LINE)
+    {
         return SUCCESS;
     }
+    if (nextChar != COMMA || !scanInt(file, &k) || k <= MIN_MATRIX_INDEX)
+    {
+        return FAILURE;
+    }
+    run->planes = (size_t) k;
 
-    return FAILURE;
+    return nextLine(file);
 }
 
 /**
@@ -283,20 +774,25 @@ bool getCalcArea(FILE *file)
  * @return return the number if the file is in the correct format,
  * otherwise return 0.0 .
  */
-double readDouble( FILE *file)
+double readDouble(text_scanner *file)
 {
-    const int PRECISION_INPUT_SIZE = 1;
-    const int DOUBLE_PRECISION = 15;
-    const int MAX_PRECISION = DOUBLE_PRECISION;
-
-    char *terminateValue = (char *)malloc(MAX_PRECISION * sizeof(char));
-    if (fscanf(file, "%s", terminateValue) != PRECISION_INPUT_SIZE)
+    const char *word;
+    size_t length = scanWord(file, &word);
+    if (length == 0)
     {
-        free(terminateValue);
         perror(READING_FILE_ERR);
         return FAILURE;
     }
 
+    char *terminateValue = (char *)malloc((length + 1) * sizeof(char));
+    if (terminateValue == NULL)
+    {
+        perror(ALLOCATING_MEMORY_ERR);
+        return FAILURE;
+    }
+    memcpy(terminateValue, word, length);
+    terminateValue[length] = '\0';
+
     double value = strtod(terminateValue, NULL); // String to double
     free(terminateValue);
     return value;
@@ -307,10 +803,10 @@ double readDouble( FILE *file)
  * @param file
  * @return true on success, false otherwise.
  */
-bool getPrecision(FILE *file)
+bool getPrecision(heat_case *run, text_scanner *file)
 {
-    gTerminateValue = readDouble(file);  // Reads the next double from file
-    if (gTerminateValue == CONVERSION_ERROR)
+    run->terminateValue = readDouble(file);  // Reads the next double from file
+    if (run->terminateValue == CONVERSION_ERROR)
     {
         perror(READ_PRECISION_ERROR);
         return FAILURE;
@@ -331,12 +827,10 @@ bool getPrecision(FILE *file)
  * @return return the number if the file is in the correct format,
  * otherwise return 0.0 .
  */
-int readInt(FILE *file)
+int readInt(text_scanner *file)
 {
-    const int PRECISION_INPUT_SIZE = 1;
-
     int integer;
-    if (fscanf(file, "%d", &integer) != PRECISION_INPUT_SIZE)
+    if (scanInt(file, &integer) == false)
     {
         return ILEGAL_NUMBER_ERROR;
     }
@@ -349,7 +843,7 @@ int readInt(FILE *file)
  * @param file
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool getIteration(FILE *file)
+bool getIteration(heat_case *run, text_scanner *file)
 {
     const int MIN_ITERATIONS_NUMBER = 0;
 
@@ -359,7 +853,7 @@ bool getIteration(FILE *file)
         perror(READ_ITERATIONS_ERROR);
         return FAILURE;
     }
-    gIterationNumber = (unsigned int) iterations;
+    run->iterationNumber = (unsigned int) iterations;
 
     if (nextLine(file) == false)
     {
@@ -374,11 +868,11 @@ bool getIteration(FILE *file)
  * @param file
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool validateRest(FILE *file)
+bool validateRest(text_scanner *file)
 {
     char NEW_LINE = '\n';
 
-    int nextChar = fgetc(file);
+    int nextChar = scanChar(file);
     while (nextChar != NEW_LINE && nextChar != EOF)
     {
         if (!isSpace((char) nextChar))
@@ -387,7 +881,7 @@ bool validateRest(FILE *file)
             return FAILURE;
         }
 
-        nextChar = fgetc(file);
+        nextChar = scanChar(file);
     }
 
     return SUCCESS;
@@ -398,7 +892,7 @@ bool validateRest(FILE *file)
  * @param file
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool getIsCyclic(FILE *file)
+bool getIsCyclic(heat_case *run, text_scanner *file)
 {
     int isCyclic = readInt(file); // Reads the next int from file
     if (isCyclic != true && isCyclic != false)
@@ -406,7 +900,7 @@ bool getIsCyclic(FILE *file)
         perror(IS_CYCLE_ERROR);
         return FAILURE;
     }
-    gIsCyclic = isCyclic;
+    run->isCyclic = isCyclic;
 
     // Validates there is no more characters in the file
     if (validateRest(file) == false)
@@ -423,10 +917,10 @@ bool getIsCyclic(FILE *file)
  * @param file
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool parseFile(FILE *file)
+bool parseFile(heat_case *run, text_scanner *file)
 {
     // Reads the size of the calculation area into m,n
-    if (getCalcArea(file) == false)
+    if (getCalcArea(run, file) == false)
     {
         return FAILURE;
     }
@@ -439,9 +933,9 @@ bool parseFile(FILE *file)
     }
 
     // Reads the source points from file
-    if (getSources(file, &gNumOfSources) == false)
+    if (((run->planes > 0) ? getVolumeSources(run, file) : getSources(run, file)) == false)
     {
-        freeSources();
+        freeSources(run);
         return FAILURE;
     }
 
@@ -449,28 +943,28 @@ bool parseFile(FILE *file)
     if (getSeparator(file) == false)
     {
         perror(SEPARATOR_OR_SOURCES_ERROR);
-        freeSources();
+        freeSources(run);
         return FAILURE;
     }
 
-    // Reads the precision to gTerminateValue
-    if (getPrecision(file) == false)
+    // Reads the precision to run->terminateValue
+    if (getPrecision(run, file) == false)
     {
-        freeSources();
+        freeSources(run);
         return FAILURE;
     }
 
     // Reads the iteration number for n_iter
-    if (getIteration(file) == false)
+    if (getIteration(run, file) == false)
     {
-        freeSources();
+        freeSources(run);
         return FAILURE;
     }
 
-    // Reads the is_cyclic to gTerminateValue
-    if (getIsCyclic(file) == false)
+    // Reads the is_cyclic to run->terminateValue
+    if (getIsCyclic(run, file) == false)
     {
-        freeSources();
+        freeSources(run);
         return FAILURE;
     }
 
@@ -482,32 +976,19 @@ bool parseFile(FILE *file)
  * @param file
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-bool createGrid()
+bool createGrid(heat_case *run)
 {
-    const int NO_HEAT = 0;
-
-    grid = malloc(gRows * sizeof(double *));
-    if (grid == NULL)
-    {
-        return FAILURE;
-    }
-
-    for (size_t i = 0; i < gRows; ++i)
+    // The other processes of a distributed run only hold their blocks
+    if (gRank != PRINTING_RANK)
     {
-        grid[i] = malloc(gColumns * sizeof(double));
-        if (grid[i] == NULL)
-        {
-            return FAILURE;
-        }
+        return SUCCESS;
     }
 
-    // Initializing the matrix to 0 heat
-    for (size_t j = 0; j < gRows; ++j)
+    // A single aligned block, already initialized to 0 heat (a volume's planes one after the other)
+    size_t planes = (run->planes > 0) ? run->planes : 1;
+    if (createHeatGrid(&run->grid, planes * run->rows, run->columns) == false)
     {
-        for (size_t i = 0; i < gColumns; ++i)
-        {
-            grid[j][i] = NO_HEAT;
-        }
+        return FAILURE;
     }
 
     return SUCCESS;
@@ -519,111 +1000,1038 @@ bool createGrid()
  * @param file
  * @return SUCCESS if succeed, otherwise return FAILURE.
  */
-void initializeGrid()
+void initializeGrid(heat_case *run)
 {
-    for (size_t i = 0; i < gNumOfSources; ++i)
+    if (run->grid.data == NULL)
+    {
+        return;
+    }
+
+    if (run->planes > 0)
+    {
+        heat_volume volume = {run->grid, run->planes, run->rows, run->columns};
+        for (size_t i = 0; i < run->numOfSources; ++i)
+        {
+            const volume_source *source = &run->volumeSources[i];
+            heatVolumeRow(&volume, (size_t) source->z, (size_t) source->x)[source->y] = source->value;
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < run->numOfSources; ++i)
     {
-        grid[gSources[i].x][gSources[i].y] = gSources[i].value;
+        heatGridRow(&run->grid, (size_t) run->sources[i].x)[run->sources[i].y] = run->sources[i].value;
     }
 }
 
 /**
- * Prints the grid array.
+ * Prints the grid array in the format of the options.
+ * @param run
+ * @param out the file it's printed to
  * @param precisionResult
  */
-void printGrid(const double precisionResult)
+void printGrid(heat_case *run, FILE *out, const double precisionResult)
 {
     const char *NEW_LINE = "\n";
-    printf("%lf\n", precisionResult);
 
-    for (size_t i = 0; i < gRows; ++i)
+    ++run->calculations;
+    if (gFormat == FORMAT_CSV)
+    {
+        writeCsvGrid(out, &run->grid, precisionResult);
+        return;
+    }
+    if (gFormat == FORMAT_BINARY)
+    {
+        writeBinaryGrid(out, &run->grid, precisionResult, run->iterationNumber, run->calculations);
+        return;
+    }
+
+    fprintf(out, "%lf\n", precisionResult);
+
+    for (size_t i = 0; i < run->grid.rows; ++i) // all the planes of a volume
     {
-        for (size_t j = 0; j < gColumns; ++j)
+        const double *row = heatGridRow(&run->grid, i);
+        for (size_t j = 0; j < run->columns; ++j)
         {
-            printf("%2.4lf,", grid[i][j]); // 2.4 stands for the correct precision
+            fprintf(out, "%2.4lf,", row[j]); // 2.4 stands for the correct precision
         }
 
-        printf("%s", NEW_LINE);
+        fprintf(out, "%s", NEW_LINE);
     }
 }
 
 /**
  * Calculates the heat and its dissipation inside the grid array,
  * it is done by using the calculator and the function heat_eqn.
+ * @param run
+ * @param solver whose buffers the calculations reuse (unused by the distributed build)
+ * @param options of the calculator (of this run only, it tells the calculations apart)
+ * @param out the file the grids are printed to
+ * @return SUCCESS if succeed, otherwise (out of memory) return FAILURE.
  */
-void calculateHeat()
+bool calculateHeat(heat_case *run, heat_solver *solver, solver_options *options, FILE *out)
 {
     double precisionResult;
+    unsigned int passes = 0;
+    options->passes = &passes;
 
     do
     {
-        precisionResult = calculate(heat_eqn, grid, gRows, gColumns,
-                                    gSources, gNumOfSources, gTerminateValue,
-                                                        gIterationNumber, gIsCyclic);
-        printGrid(precisionResult);
-    } while (precisionResult >= gTerminateValue);
+        double start = monotonicSeconds();
+        options->calculation = run->calculations;
+#ifdef HEAT_MPI
+        precisionResult = calculateDistributed(heat_eqn, &run->grid, run->rows, run->columns,
+                                               run->sources, run->numOfSources, run->terminateValue,
+                                               run->iterationNumber, run->isCyclic, options, MPI_COMM_WORLD);
+#else
+        if (run->planes > 0)
+        {
+            heat_volume volume = {run->grid, run->planes, run->rows, run->columns};
+            precisionResult = calculateVolume(heat_eqn3, &volume, run->volumeSources, run->numOfSources,
+                                              run->terminateValue, run->iterationNumber, run->isCyclic, options);
+        }
+        else
+        {
+            precisionResult = solveHeat(solver, heat_eqn, &run->grid,
+                                        run->sources, run->numOfSources, run->terminateValue,
+                                        run->iterationNumber, run->isCyclic, options);
+        }
+        options->resume = NULL; // only the first calculation goes on from the checkpoint
+#endif
+        double solved = monotonicSeconds();
+        run->solveSeconds += solved - start;
+        run->passes += passes;
+        if (precisionResult == CALCULATION_FAILED)
+        {
+            options->passes = NULL;
+            return FAILURE;
+        }
+
+        if (gRank == PRINTING_RANK)
+        {
+            beginPhase(options->profile, PHASE_OUTPUT);
+            printGrid(run, out, precisionResult);
+            fflush(out);
+            endPhase(options->profile, PHASE_OUTPUT);
+        }
+        run->outputSeconds += monotonicSeconds() - solved;
+    } while (precisionResult >= run->terminateValue);
+
+    options->passes = NULL;
+    return SUCCESS;
 }
 
 /**
- * Validates the number of arguments we've got.
- * @param args
- * @return SUCCESS if succeed, otherwise return FAILURE.
+ * Returns the value of the option 'name' if 'arg' is it.
+ * @param arg the argument, e.g. "--sweep=jacobi"
+ * @param name the option with its '=', e.g. "--sweep="
+ * @return the value ("jacobi"), or NULL if 'arg' is another argument.
  */
-bool validateArgs(int args)
+const char *optionValue(const char *arg, const char *name)
 {
-    const int NUM_OF_ARGS = 2;
+    size_t length = strlen(name);
+    return strncmp(arg, name, length) == 0 ? arg + length : NULL;
+}
 
-    if (args == NUM_OF_ARGS)
+/**
+ * Finds 'value' inside 'names'.
+ * @param value
+ * @param names
+ * @param count the number of names
+ * @param choice output parameter: the index of 'value'.
+ * @return SUCCESS if found, otherwise return FAILURE.
+ */
+bool parseChoice(const char *value, const char *const names[], const int count, int *choice)
+{
+    for (int i = 0; i < count; ++i)
     {
-        return SUCCESS;
+        if (strcmp(value, names[i]) == 0)
+        {
+            *choice = i;
+            return SUCCESS;
+        }
     }
 
-    perror(SINGLE_ARG_MSG);
     return FAILURE;
 }
 
-int main(int argc, char *argv[])
+/**
+ * Reads a non-negative number (an option's value).
+ * @param value
+ * @param count output parameter: the number.
+ * @return SUCCESS if 'value' is a whole non-negative number, otherwise return FAILURE.
+ */
+bool parseCount(const char *value, unsigned int *count)
 {
-    const int SUCCESSFULLY = 0;
-    const int FILE_PATH = 1;
-
-    if (!validateArgs(argc))
+    char *end;
+    long number = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || number < 0 || number > (long) UINT_MAX)
     {
-        perror(READING_FILE_ERR);
-        return (READING_FILE_ERROR);
+        return FAILURE;
     }
 
-    char *filePath = argv[FILE_PATH];
-    FILE *file = fopen(filePath, "r");
-    if (file == NULL)
-    {
-        perror(READING_FILE_ERR);
-        return READING_FILE_ERROR;
+    *count = (unsigned int) number;
+    return SUCCESS;
+}
+
+/**
+ * Reads the over-relaxation factor (an option's value).
+ * @param value
+ * @param omega output parameter: the factor.
+ * @return SUCCESS if 'value' is a number in (0, 2), otherwise return FAILURE.
+ */
+bool parseOmega(const char *value, double *omega)
+{
+    const double MAX_OMEGA = 2; // SOR diverges from it on
+
+    char *end;
+    double number = strtod(value, &end);
+    if (*value == '\0' || *end != '\0' || !(number > 0 && number < MAX_OMEGA))
+    {
+        return FAILURE;
+    }
+
+    *omega = number;
+    return SUCCESS;
+}
+
+/**
+ * Reads a single option into gOptions.
+ * @param arg
+ * @return SUCCESS if succeed, otherwise (unknown option or value) return FAILURE.
+ */
+bool parseOption(const char *arg)
+{
+    const int NUM_OF_SWEEPS = sizeof(SWEEP_NAMES) / sizeof(SWEEP_NAMES[0]);
+    const int NUM_OF_SIMD_LEVELS = sizeof(SIMD_NAMES) / sizeof(SIMD_NAMES[0]);
+    const int NUM_OF_MONITORS = sizeof(MONITOR_NAMES) / sizeof(MONITOR_NAMES[0]);
+    const int NUM_OF_SOLVERS = sizeof(SOLVER_NAMES) / sizeof(SOLVER_NAMES[0]);
+    const int NUM_OF_RELAXATIONS = sizeof(RELAX_NAMES) / sizeof(RELAX_NAMES[0]);
+    const int NUM_OF_OMEGAS = sizeof(OMEGA_NAMES) / sizeof(OMEGA_NAMES[0]);
+    const int NUM_OF_PRECONDITIONERS = sizeof(PRECONDITIONER_NAMES) / sizeof(PRECONDITIONER_NAMES[0]);
+    const int NUM_OF_FORMATS = sizeof(FORMAT_NAMES) / sizeof(FORMAT_NAMES[0]);
+
+    const char *value;
+    int choice;
+
+    if ((value = optionValue(arg, SWEEP_OPTION)) != NULL)
+    {
+        if (parseChoice(value, SWEEP_NAMES, NUM_OF_SWEEPS, &choice))
+        {
+            gOptions.order = (sweep_order) choice;
+            return SUCCESS;
+        }
+    }
+    else if ((value = optionValue(arg, SIMD_OPTION)) != NULL)
+    {
+        if (parseChoice(value, SIMD_NAMES, NUM_OF_SIMD_LEVELS, &choice))
+        {
+            gOptions.simd = (simd_level) choice;
+            return SUCCESS;
+        }
+    }
+    else if ((value = optionValue(arg, THREADS_OPTION)) != NULL)
+    {
+        return parseCount(value, &gOptions.threads);
+    }
+    else if ((value = optionValue(arg, TIME_TILE_OPTION)) != NULL)
+    {
+        return parseCount(value, &gOptions.time_tile);
+    }
+    else if (strcmp(arg, ACTIVE_TILES_OPTION) == 0)
+    {
+        gOptions.active_tiles = true;
+        return SUCCESS;
+    }
+    else if ((value = optionValue(arg, VOLUME_BLOCK_OPTION)) != NULL)
+    {
+        return parseCount(value, &gOptions.volume_block);
+    }
+    else if ((value = optionValue(arg, MONITOR_OPTION)) != NULL)
+    {
+        if (parseChoice(value, MONITOR_NAMES, NUM_OF_MONITORS, &choice))
+        {
+            gOptions.monitor = (convergence_monitor) choice;
+            return SUCCESS;
+        }
+    }
+    else if ((value = optionValue(arg, CHECK_EVERY_OPTION)) != NULL)
+    {
+        return parseCount(value, &gOptions.check_interval) && gOptions.check_interval > 0;
+    }
+    else if ((value = optionValue(arg, SOLVER_OPTION)) != NULL)
+    {
+        if (parseChoice(value, SOLVER_NAMES, NUM_OF_SOLVERS, &choice))
+        {
+            gOptions.solver = (solver_method) choice;
+            return SUCCESS;
+        }
+    }
+    else if ((value = optionValue(arg, RELAX_OPTION)) != NULL)
+    {
+        if (parseChoice(value, RELAX_NAMES, NUM_OF_RELAXATIONS, &choice))
+        {
+            gOptions.relaxation = (relaxation_method) choice;
+            return SUCCESS;
+        }
+    }
+    else if ((value = optionValue(arg, OMEGA_OPTION)) != NULL)
+    {
+        if (parseChoice(value, OMEGA_NAMES, NUM_OF_OMEGAS, &choice))
+        {
+            gOptions.omega = OMEGA_VALUES[choice];
+            return SUCCESS;
+        }
+        return parseOmega(value, &gOptions.omega);
+    }
+    else if ((value = optionValue(arg, PRECONDITIONER_OPTION)) != NULL)
+    {
+        if (parseChoice(value, PRECONDITIONER_NAMES, NUM_OF_PRECONDITIONERS, &choice))
+        {
+            gOptions.preconditioner = (preconditioner_kind) choice;
+            return SUCCESS;
+        }
+    }
+    else if ((value = optionValue(arg, SNAPSHOT_EVERY_OPTION)) != NULL)
+    {
+        return parseCount(value, &gOptions.snapshot_interval);
+    }
+    else if ((value = optionValue(arg, SNAPSHOT_FILE_OPTION)) != NULL)
+    {
+        gSnapshotPath = value;
+        return *value != '\0';
+    }
+    else if ((value = optionValue(arg, CHECKPOINT_EVERY_OPTION)) != NULL)
+    {
+        return parseCount(value, &gOptions.checkpoint_interval);
+    }
+    else if ((value = optionValue(arg, CHECKPOINT_FILE_OPTION)) != NULL)
+    {
+        gCheckpointPath = value;
+        return *value != '\0';
+    }
+    else if ((value = optionValue(arg, CHECKPOINT_SYNC_OPTION)) != NULL)
+    {
+        return parseCount(value, &gCheckpointSync);
+    }
+    else if ((value = optionValue(arg, RESUME_OPTION)) != NULL)
+    {
+        gResumePath = value;
+        return *value != '\0';
+    }
+    else if ((value = optionValue(arg, MANIFEST_OPTION)) != NULL)
+    {
+        gManifestPath = value;
+        return *value != '\0';
+    }
+    else if ((value = optionValue(arg, JOBS_OPTION)) != NULL)
+    {
+        return parseCount(value, &gJobs);
+    }
+    else if ((value = optionValue(arg, TIMINGS_OPTION)) != NULL)
+    {
+        gTimingsPath = value;
+        return *value != '\0';
+    }
+    else if ((value = optionValue(arg, PROFILE_OPTION)) != NULL)
+    {
+        gProfilePath = value;
+        return *value != '\0';
+    }
+    else if (strcmp(arg, PROFILE_COUNTERS_OPTION) == 0)
+    {
+        gUseProfileCounters = true;
+        return SUCCESS;
+    }
+    else if ((value = optionValue(arg, WARM_CACHE_OPTION)) != NULL)
+    {
+        gWarmCachePath = value;
+        return *value != '\0';
+    }
+    else if ((value = optionValue(arg, FORMAT_OPTION)) != NULL)
+    {
+        if (parseChoice(value, FORMAT_NAMES, NUM_OF_FORMATS, &choice))
+        {
+            gFormat = (output_format) choice;
+            return SUCCESS;
+        }
+    }
+
+    return FAILURE;
+}
+
+/**
+ * Checks weather every process succeeded (in a distributed run; otherwise weather this one did).
+ * @param isSucceeded of this process
+ * @return SUCCESS if all did, otherwise return FAILURE.
+ */
+bool isSucceededByAll(const bool isSucceeded)
+{
+#ifdef HEAT_MPI
+    int isFailed = !isSucceeded;
+    MPI_Allreduce(MPI_IN_PLACE, &isFailed, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    return !isFailed;
+#else
+    return isSucceeded;
+#endif
+}
+
+/**
+ * Checks weather the run is a batch: any number of parameter files but one, or a manifest.
+ * @return true if it is, otherwise false.
+ */
+bool isBatch()
+{
+    const size_t SINGLE_FILE = 1;
+
+    return gNumOfParameterFiles != SINGLE_FILE || gManifestPath != NULL;
+}
+
+/**
+ * Validates the arguments we've got: options (which start with "--"), and the
+ * parameter files - a single one, or a batch of them.
+ * @param argc
+ * @param argv
+ * @return SUCCESS if succeed, otherwise return FAILURE.
+ */
+bool validateArgs(int argc, char *argv[])
+{
+    const int MIN_NUM_OF_ARGS = 2;
+    const unsigned int CHECKPOINT_SYNC_SECONDS = 10;
+    const unsigned int JOB_PER_PROCESSOR = 0;
+
+    gOptions = defaultSolverOptions();
+    gCheckpointSync = CHECKPOINT_SYNC_SECONDS;
+    gJobs = JOB_PER_PROCESSOR;
+    if (argc < MIN_NUM_OF_ARGS)
+    {
+        perror(SINGLE_ARG_MSG);
+        return FAILURE;
+    }
+
+    gParameterFiles = (const char **) malloc(argc * sizeof(const char *));
+    if (gParameterFiles == NULL)
+    {
+        perror(ALLOCATING_MEMORY_ERR);
+        return FAILURE;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strncmp(argv[i], OPTION_PREFIX, strlen(OPTION_PREFIX)) != 0)
+        {
+            gParameterFiles[gNumOfParameterFiles++] = argv[i];
+        }
+        else if (parseOption(argv[i]) == false)
+        {
+            perror(SINGLE_ARG_MSG);
+            return FAILURE;
+        }
+    }
+
+    if (gNumOfParameterFiles == 0 && gManifestPath == NULL)
+    {
+        perror(SINGLE_ARG_MSG);
+        return FAILURE;
+    }
+
+    // Snapshots & checkpoints need a file
+    if ((gOptions.snapshot_interval > 0 && gSnapshotPath == NULL) ||
+        (gOptions.checkpoint_interval > 0 && gCheckpointPath == NULL))
+    {
+        perror(SINGLE_ARG_MSG);
+        return FAILURE;
+    }
+
+    // ... and are of a single run
+    if (isBatch() && (gOptions.snapshot_interval > 0 || gOptions.checkpoint_interval > 0 || gResumePath != NULL ||
+                      gTimingsPath != NULL || gProfilePath != NULL))
+    {
+        perror(SINGLE_ARG_MSG);
+        return FAILURE;
+    }
+
+#ifdef HEAT_MPI
+    // The snapshots, checkpoints & warm starts are of a single process's calculator, and the processes share a single grid
+    if (gOptions.snapshot_interval > 0 || gOptions.checkpoint_interval > 0 || gResumePath != NULL ||
+        gWarmCachePath != NULL || isBatch())
+    {
+        perror(SINGLE_ARG_MSG);
+        return FAILURE;
+    }
+#endif
+
+    return SUCCESS;
+}
+
+/**
+ * checks weather the options can solve a 3D file: Gauss-Seidel or Jacobi passes
+ * in a single process, without anything but the plain passes (see volume.h).
+ * @return true if they can, otherwise false.
+ */
+bool isVolumeSupported()
+{
+#ifdef HEAT_MPI
+    return false;
+#else
+    const unsigned int TILE_OF_A_PASS = 1;
+
+    return gOptions.order != SWEEP_RED_BLACK && gOptions.time_tile <= TILE_OF_A_PASS && !gOptions.active_tiles &&
+           gOptions.solver == SOLVER_PASSES && gOptions.relaxation == RELAXATION_NONE &&
+           gOptions.snapshot_interval == 0 && gOptions.checkpoint_interval == 0 && gResumePath == NULL &&
+           gWarmCachePath == NULL;
+#endif
+}
+
+/**
+ * Reads the parameter file 'path' into 'run', creates its grid & initializes
+ * it with the sources.
+ * @param run
+ * @param path
+ * @return the exit code (SUCCESSFULLY, or the error's after telling it).
+ */
+int readCase(heat_case *run, const char *path)
+{
+    text_scanner file;
+    if (openScanner(&file, path) == false)
+    {
+        perror(READING_FILE_ERR);
+        return READING_FILE_ERROR;
     }
 
     // ................... Parsing file ...................... //
-    if (parseFile(file) == false)
+    bool isParsed = parseFile(run, &file);
+    closeScanner(&file);
+    if (isParsed == false)
     {
-        fclose(file);
         perror(FILE_STRUCTURE_ERROR_MSG);
         return FILE_STRUCTURE_ERROR;
     }
 
+    // ....... A 3D file is solved by the plain passes ........ //
+    if (run->planes > 0 && isVolumeSupported() == false)
+    {
+        freeSources(run);
+        perror(VOLUME_OPTIONS_ERR);
+        return FILE_STRUCTURE_ERROR;
+    }
+
     // ................ Creates the grid matrix .............. //
-    if (createGrid() == false)
+    if (isSucceededByAll(createGrid(run)) == false)
     {
-        fclose(file);
+        freeCase(run);
         perror(ALLOCATING_MEMORY_ERR);
         return MEMORY_ALLOCATION_ERROR;
     }
 
     // ........ Initializing with the sources's values ....... //
-    initializeGrid();
+    initializeGrid(run);
+
+    return SUCCESSFULLY;
+}
+
+/**
+ * Appends the timings of the run to the timings file (if one is given).
+ * @param run
+ * @param path the parameter file
+ * @param parseSeconds the seconds of reading the parameter file & creating the grid
+ * @return SUCCESS if succeed, otherwise (the file) return FAILURE.
+ */
+bool writeTimings(const heat_case *run, const char *path, const double parseSeconds)
+{
+    const unsigned int THREAD_PER_PROCESSOR = 0;
+
+    if (gTimingsPath == NULL || gRank != PRINTING_RANK)
+    {
+        return SUCCESS;
+    }
+
+    size_t planes = (run->planes > 0) ? run->planes : 1; // a volume's updates are of all its planes
+#ifdef HEAT_MPI
+    bool isPassesOnly = true; // the processes' calculation always solves by passes
+#else
+    // the other solvers do more than passes, but runs with a fixed n_iter always use passes
+    bool isPassesOnly = gOptions.solver == SOLVER_PASSES || run->iterationNumber > 0;
+#endif
+    run_timings timings = {path, planes * run->rows, run->columns, SWEEP_NAMES[gOptions.order],
+                           SOLVER_NAMES[gOptions.solver],
+                           (gOptions.threads == THREAD_PER_PROCESSOR) ? numOfProcessors() : gOptions.threads,
+                           run->calculations, run->passes, isPassesOnly, parseSeconds, run->solveSeconds,
+                           run->outputSeconds};
+    return appendTimings(gTimingsPath, &timings);
+}
+
+/**
+ * Solves a single parameter file, printing its grids to the standard output.
+ * @param path
+ * @return the exit code.
+ */
+int solveSingle(const char *path)
+{
+    heat_case run = {0};
+
+    // ............... Creates the profile .................. //
+    if (startProfile() == false)
+    {
+        perror(ALLOCATING_MEMORY_ERR);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    double start = monotonicSeconds();
+    beginPhase(gOptions.profile, PHASE_PARSE);
+    int exitCode = readCase(&run, path);
+    if (exitCode != SUCCESSFULLY)
+    {
+        stopProfile();
+        return exitCode;
+    }
+    endPhase(gOptions.profile, PHASE_PARSE);
+    double parseSeconds = monotonicSeconds() - start;
+
+    // ....... Goes on from the checkpoint to resume ........ //
+    if (resumeCheckpoint(&run) == false)
+    {
+        freeMemory(&run);
+        perror(RESUME_ERR);
+        return READING_FILE_ERROR;
+    }
+
+    // ........... Maps the checkpoint file ................. //
+    if (startCheckpoints(&run) == false)
+    {
+        freeMemory(&run);
+        perror(CHECKPOINT_FILE_ERR);
+        return WRITING_FILE_ERROR;
+    }
+
+    // ........... Starts the snapshot writer ............... //
+    if (startSnapshots(&run) == false)
+    {
+        freeMemory(&run);
+        perror(SNAPSHOT_FILE_ERR);
+        return WRITING_FILE_ERROR;
+    }
 
     // ...Calculates the heat points using the calculator ... //
-    calculateHeat();
+    heat_solver *solver = createHeatSolver();
+    bool isCalculated = solver != NULL && calculateHeat(&run, solver, &gOptions, stdout);
+    destroyHeatSolver(solver);
+    if (isCalculated == false)
+    {
+        freeMemory(&run);
+        perror(ALLOCATING_MEMORY_ERR);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    // ............ Appends the run's timings ............... //
+    if (writeTimings(&run, path, parseSeconds) == false)
+    {
+        freeMemory(&run);
+        perror(TIMINGS_FILE_ERR);
+        return WRITING_FILE_ERROR;
+    }
+
+    // .................. Writes the profile .................. //
+    if (gOptions.profile != NULL && writeProfile(gOptions.profile, gProfilePath) == false)
+    {
+        freeMemory(&run);
+        perror(PROFILE_FILE_ERR);
+        return WRITING_FILE_ERROR;
+    }
+
+    freeMemory(&run);
+    return SUCCESSFULLY;
+}
+
+
+// ........................................ Batch ............................... //
+
+/**
+ * A parameter file of a batch & its grids, printed into memory until they're written.
+ */
+typedef struct
+{
+    char *path;
+    char *output;
+    size_t outputSize;
+    int exitCode;
+    bool isSolved;
+} batch_case;
+
+/**
+ * The parameter files of a batch. The workers solve them in any order, and the
+ * one which solves the next case to be written writes it & every solved case
+ * after it (outside of the lock), so the output files are written in the
+ * batch's order, with no worker waiting for another.
+ */
+typedef struct
+{
+    batch_case *cases;
+    size_t count;
+    size_t capacity;
+    size_t nextToWrite;
+    bool isWriting;
+    pthread_mutex_t lock;
+    heat_solver **solvers; // a solver per worker, whose buffers its cases reuse
+    unsigned int numOfSolvers;
+} heat_batch;
+
+/**
+ * Adds a copy of the first 'length' characters of 'path' to the batch's cases.
+ * The cases grow geometrically.
+ * @param batch
+ * @param path
+ * @param length
+ * @return SUCCESS if succeed, otherwise return FAILURE.
+ */
+bool addCase(heat_batch *batch, const char *path, const size_t length)
+{
+    const size_t INITIAL_CAPACITY = 16;
+    const size_t GROWTH_FACTOR = 2;
+
+    if (batch->count == batch->capacity)
+    {
+        size_t capacity = (batch->capacity == 0) ? INITIAL_CAPACITY : GROWTH_FACTOR * batch->capacity;
+        batch_case *grown = realloc(batch->cases, capacity * sizeof(batch_case));
+        if (grown == NULL)
+        {
+            perror(ALLOCATING_MEMORY_ERR);
+            return FAILURE;
+        }
+        batch->cases = grown;
+        batch->capacity = capacity;
+    }
+
+    batch_case *item = &batch->cases[batch->count];
+    memset(item, 0, sizeof(batch_case));
+    item->path = (char *) malloc((length + 1) * sizeof(char));
+    if (item->path == NULL)
+    {
+        perror(ALLOCATING_MEMORY_ERR);
+        return FAILURE;
+    }
+    memcpy(item->path, path, length);
+    item->path[length] = '\0';
+
+    ++batch->count;
+    return SUCCESS;
+}
+
+/**
+ * Adds the parameter files of the manifest (if one is given) to the batch.
+ * @param batch
+ * @return SUCCESS if succeed, otherwise return FAILURE.
+ */
+bool readManifest(heat_batch *batch)
+{
+    if (gManifestPath == NULL)
+    {
+        return SUCCESS;
+    }
+
+    text_scanner manifest;
+    if (openScanner(&manifest, gManifestPath) == false)
+    {
+        perror(READING_FILE_ERR);
+        return FAILURE;
+    }
+
+    const char *path;
+    size_t length;
+    while ((length = scanWord(&manifest, &path)) > 0)
+    {
+        if (addCase(batch, path, length) == false)
+        {
+            closeScanner(&manifest);
+            return FAILURE;
+        }
+    }
+
+    closeScanner(&manifest);
+    return SUCCESS;
+}
+
+/**
+ * Solves a case of a batch, printing its grids into its output.
+ * @param item
+ * @param solver the worker's
+ * @return the exit code.
+ */
+int solveCase(batch_case *item, heat_solver *solver)
+{
+    heat_case run = {0};
+    solver_options options = gOptions;
+
+    int exitCode = readCase(&run, item->path);
+    if (exitCode != SUCCESSFULLY)
+    {
+        return exitCode;
+    }
+
+    FILE *out = open_memstream(&item->output, &item->outputSize);
+    if (out == NULL)
+    {
+        freeCase(&run);
+        perror(ALLOCATING_MEMORY_ERR);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    bool isCalculated = calculateHeat(&run, solver, &options, out);
+    isCalculated = (fclose(out) == 0) && isCalculated;
+    freeCase(&run);
+    if (isCalculated == false)
+    {
+        perror(ALLOCATING_MEMORY_ERR);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+
+    return SUCCESSFULLY;
+}
+
+/**
+ * Writes the output of a solved case to its output file: <parameter file>.out.
+ * @param item
+ * @return the exit code.
+ */
+int writeCase(const batch_case *item)
+{
+    char *outputPath = (char *) malloc((strlen(item->path) + strlen(BATCH_OUTPUT_SUFFIX) + 1) * sizeof(char));
+    if (outputPath == NULL)
+    {
+        perror(ALLOCATING_MEMORY_ERR);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+    strcpy(outputPath, item->path);
+    strcat(outputPath, BATCH_OUTPUT_SUFFIX);
+
+    FILE *file = fopen(outputPath, "wb");
+    free(outputPath);
+    if (file == NULL)
+    {
+        perror(WRITING_FILE_ERR);
+        return WRITING_FILE_ERROR;
+    }
+
+    bool isWritten = fwrite(item->output, sizeof(char), item->outputSize, file) == item->outputSize;
+    isWritten = (fclose(file) == 0) && isWritten;
+    if (isWritten == false)
+    {
+        perror(WRITING_FILE_ERR);
+        return WRITING_FILE_ERROR;
+    }
+
+    return SUCCESSFULLY;
+}
+
+/**
+ * Marks the case 'index' solved, and writes the cases which are next in order
+ * (unless another worker is writing them).
+ * @param batch
+ * @param index
+ */
+void finishCase(heat_batch *batch, const size_t index)
+{
+    pthread_mutex_lock(&batch->lock);
+    batch->cases[index].isSolved = true;
+    if (batch->isWriting)
+    {
+        pthread_mutex_unlock(&batch->lock); // the writer will get to it
+        return;
+    }
 
-    fclose(file);
-    freeMemory();
-    return (SUCCESSFULLY);
+    batch->isWriting = true;
+    while (batch->nextToWrite < batch->count && batch->cases[batch->nextToWrite].isSolved)
+    {
+        batch_case *item = &batch->cases[batch->nextToWrite];
+        pthread_mutex_unlock(&batch->lock);
+
+        if (item->exitCode == SUCCESSFULLY)
+        {
+            item->exitCode = writeCase(item);
+        }
+        free(item->output);
+        item->output = NULL;
+        if (item->exitCode != SUCCESSFULLY)
+        {
+            fprintf(stderr, BATCH_CASE_FAILED_MSG, item->path, item->exitCode);
+        }
+
+        pthread_mutex_lock(&batch->lock);
+        ++batch->nextToWrite;
+    }
+    batch->isWriting = false;
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/**
+ * Solves the cases [from, to) of the batch 'context' (a worker's task).
+ */
+void solveCases(const size_t from, const size_t to, const unsigned int thread, void *context)
+{
+    heat_batch *batch = (heat_batch *) context;
+
+    for (size_t i = from; i < to; ++i)
+    {
+        batch->cases[i].exitCode = solveCase(&batch->cases[i], batch->solvers[thread]);
+        finishCase(batch, i);
+    }
+}
+
+/**
+ * Creates a solver for every worker of 'pool'.
+ * @param batch
+ * @param pool
+ * @return SUCCESS if succeed, otherwise (out of memory) return FAILURE.
+ */
+bool createSolvers(heat_batch *batch, const thread_pool *pool)
+{
+    batch->solvers = (heat_solver **) calloc(poolThreads(pool), sizeof(heat_solver *));
+    if (batch->solvers == NULL)
+    {
+        return FAILURE;
+    }
+
+    for (; batch->numOfSolvers < poolThreads(pool); ++batch->numOfSolvers)
+    {
+        batch->solvers[batch->numOfSolvers] = createHeatSolver();
+        if (batch->solvers[batch->numOfSolvers] == NULL)
+        {
+            return FAILURE;
+        }
+    }
+    return SUCCESS;
+}
+
+/**
+ * Shares the processors between the workers of 'pool' when the calculators
+ * run on all of them, so that the jobs at once don't oversubscribe them.
+ * @param pool
+ */
+void shareProcessors(const thread_pool *pool)
+{
+    const unsigned int THREAD_PER_PROCESSOR = 0;
+
+    if (gOptions.threads == THREAD_PER_PROCESSOR)
+    {
+        unsigned int share = numOfProcessors() / poolThreads(pool);
+        gOptions.threads = (share > 0) ? share : 1;
+    }
+}
+
+/**
+ * Frees the cases & the solvers of the batch.
+ * @param batch
+ */
+void freeBatch(heat_batch *batch)
+{
+    for (size_t i = 0; i < batch->count; ++i)
+    {
+        free(batch->cases[i].path);
+        free(batch->cases[i].output);
+    }
+    free(batch->cases);
+
+    for (unsigned int i = 0; i < batch->numOfSolvers; ++i)
+    {
+        destroyHeatSolver(batch->solvers[i]);
+    }
+    free(batch->solvers);
+}
+
+/**
+ * Solves the parameter files of the command line & of the manifest, 'gJobs' at
+ * once, writing each one's grids to its output file.
+ * @return the exit code (of the first case which failed, if one did).
+ */
+int solveBatch()
+{
+    heat_batch batch = {0};
+
+    for (size_t i = 0; i < gNumOfParameterFiles; ++i)
+    {
+        if (addCase(&batch, gParameterFiles[i], strlen(gParameterFiles[i])) == false)
+        {
+            freeBatch(&batch);
+            return MEMORY_ALLOCATION_ERROR;
+        }
+    }
+    if (readManifest(&batch) == false)
+    {
+        freeBatch(&batch);
+        return READING_FILE_ERROR;
+    }
+
+    // The workers' calculators pick their kernels at once
+    detectSimdLevel();
+
+    thread_pool *pool = createThreadPool(gJobs);
+    if (pool == NULL || createSolvers(&batch, pool) == false)
+    {
+        destroyThreadPool(pool);
+        freeBatch(&batch);
+        perror(ALLOCATING_MEMORY_ERR);
+        return MEMORY_ALLOCATION_ERROR;
+    }
+    shareProcessors(pool);
+    pthread_mutex_init(&batch.lock, NULL);
+
+    runDynamic(pool, batch.count, solveCases, &batch);
+
+    destroyThreadPool(pool);
+    pthread_mutex_destroy(&batch.lock);
+
+    int exitCode = SUCCESSFULLY;
+    for (size_t i = 0; i < batch.count && exitCode == SUCCESSFULLY; ++i)
+    {
+        exitCode = batch.cases[i].exitCode;
+    }
+    freeBatch(&batch);
+    return exitCode;
+}
+
+/**
+ * Reads the parameter files, calculates & prints the heat.
+ * @param argc
+ * @param argv
+ * @return the exit code.
+ */
+int heatSolve(int argc, char *argv[])
+{
+    int exitCode;
+
+    if (!validateArgs(argc, argv))
+    {
+        perror(READING_FILE_ERR);
+        exitCode = READING_FILE_ERROR;
+    }
+    else if (startWarmCache() == false)
+    {
+        perror(WARM_CACHE_ERR);
+        exitCode = READING_FILE_ERROR;
+    }
+    else if (isBatch())
+    {
+        exitCode = solveBatch();
+    }
+    else
+    {
+        exitCode = solveSingle(gParameterFiles[0]);
+    }
+
+    stopWarmCache();
+    free(gParameterFiles);
+    return exitCode;
+}
+
+int main(int argc, char *argv[])
+{
+#ifdef HEAT_MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &gRank);
+    int exitCode = heatSolve(argc, argv);
+    MPI_Finalize();
+    return exitCode;
+#else
+    return heatSolve(argc, argv);
+#endif
 }
@@ -0,0 +1,388 @@
+/**
+ * @author Roy Ackerman
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <float.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "scanner.h"
+
+/**
+ * The largest power of 10 which is exact as a double, and the largest
+ * mantissa which is (2 ^ 53): their product or quotient is rounded once.
+ */
+#define MAX_EXACT_POWER 22
+#define MAX_EXACT_MANTISSA (1ULL << 53)
+
+/**
+ * The most digits the mantissa of the hand conversion takes (without overflowing 64 bits).
+ */
+#define MAX_MANTISSA_DIGITS 19
+
+/**
+ * The bytes of a read (not mapped) file's buffer to begin with; it doubles as it fills.
+ */
+#define READ_BUFFER_SIZE (1 << 16)
+
+/**
+ * The longest number strtof converts from the stack (longer ones are copied to the heap).
+ */
+#define MAX_STACK_NUMBER 64
+
+static const double POWERS_OF_TEN[MAX_EXACT_POWER + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/**
+ * Reads the open file 'descriptor' to its end into the scanner's buffer.
+ * @return true on success, false if it could not be read or the buffer allocated.
+ */
+static bool readWhole(text_scanner *scanner, const int descriptor)
+{
+    size_t capacity = READ_BUFFER_SIZE;
+    scanner->data = malloc(capacity);
+    scanner->size = 0;
+    if (scanner->data == NULL)
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        if (scanner->size == capacity)
+        {
+            char *bigger = realloc(scanner->data, 2 * capacity);
+            if (bigger == NULL)
+            {
+                return false;
+            }
+            scanner->data = bigger;
+            capacity *= 2;
+        }
+
+        ssize_t count = read(descriptor, scanner->data + scanner->size, capacity - scanner->size);
+        if (count < 0)
+        {
+            return false;
+        }
+        if (count == 0)
+        {
+            return true;
+        }
+        scanner->size += (size_t) count;
+    }
+}
+
+bool openScanner(text_scanner *scanner, const char *path)
+{
+    scanner->data = NULL;
+    scanner->size = 0;
+    scanner->isMapped = false;
+
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat status;
+    bool isOpened = fstat(descriptor, &status) == 0;
+    if (isOpened && S_ISREG(status.st_mode) && status.st_size > 0)
+    {
+        void *map = mmap(NULL, (size_t) status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (map != MAP_FAILED)
+        {
+            posix_madvise(map, (size_t) status.st_size, POSIX_MADV_SEQUENTIAL);
+            scanner->data = map;
+            scanner->size = (size_t) status.st_size;
+            scanner->isMapped = true;
+        }
+    }
+    if (isOpened && !scanner->isMapped)
+    {
+        isOpened = readWhole(scanner, descriptor);
+    }
+    close(descriptor);
+
+    if (!isOpened)
+    {
+        closeScanner(scanner);
+        return false;
+    }
+
+    scanner->next = scanner->data;
+    scanner->end = scanner->data + scanner->size;
+    return true;
+}
+
+void closeScanner(text_scanner *scanner)
+{
+    if (scanner->isMapped)
+    {
+        munmap(scanner->data, scanner->size);
+    }
+    else
+    {
+        free(scanner->data);
+    }
+    scanner->data = NULL;
+    scanner->next = scanner->end = NULL;
+    scanner->size = 0;
+    scanner->isMapped = false;
+}
+
+int scanChar(text_scanner *scanner)
+{
+    return (scanner->next < scanner->end) ? (unsigned char) *scanner->next++ : EOF;
+}
+
+bool scanLine(text_scanner *scanner, char *line, const size_t size)
+{
+    if (scanner->next == scanner->end)
+    {
+        return false;
+    }
+
+    size_t length = 0;
+    while (length + 1 < size && scanner->next < scanner->end)
+    {
+        char c = *scanner->next++;
+        line[length++] = c;
+        if (c == '\n')
+        {
+            break;
+        }
+    }
+    line[length] = '\0';
+    return true;
+}
+
+void skipWhitespace(text_scanner *scanner)
+{
+    while (scanner->next < scanner->end && isspace((unsigned char) *scanner->next))
+    {
+        ++scanner->next;
+    }
+}
+
+bool scanLiteral(text_scanner *scanner, const char c)
+{
+    if (scanner->next < scanner->end && *scanner->next == c)
+    {
+        ++scanner->next;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Checks weather the next character is a decimal digit.
+ * @return true if it is, otherwise false (also at the end).
+ */
+static bool isDigitNext(const text_scanner *scanner)
+{
+    return scanner->next < scanner->end && isdigit((unsigned char) *scanner->next);
+}
+
+/**
+ * Consumes a '+' or a '-' if it's next.
+ * @return true if it was a '-', otherwise false.
+ */
+static bool scanSign(text_scanner *scanner)
+{
+    bool isNegative = scanner->next < scanner->end && *scanner->next == '-';
+    if (isNegative || (scanner->next < scanner->end && *scanner->next == '+'))
+    {
+        ++scanner->next;
+    }
+    return isNegative;
+}
+
+bool scanInt(text_scanner *scanner, int *value)
+{
+    skipWhitespace(scanner);
+    bool isNegative = scanSign(scanner);
+    if (!isDigitNext(scanner))
+    {
+        return false;
+    }
+
+    // Like strtol, which scanf uses: saturated at the long's range, then cut to an int
+    const unsigned long long LIMIT = isNegative ? (unsigned long long) LONG_MAX + 1 : (unsigned long long) LONG_MAX;
+    unsigned long long number = 0;
+    for (; isDigitNext(scanner); ++scanner->next)
+    {
+        unsigned int digit = (unsigned int) (*scanner->next - '0');
+        number = (number > (LIMIT - digit) / 10) ? LIMIT : number * 10 + digit;
+    }
+
+    long result = isNegative ? (long) (0 - number) : (long) number;
+    *value = (int) result;
+    return true;
+}
+
+/**
+ * Converts the number at the scanner's position (after its white-space) by strtof,
+ * for what the hand conversion doesn't take.
+ * @return true on success, false if no number is next.
+ */
+static bool scanFloatByLibrary(text_scanner *scanner, float *value)
+{
+    const char *last = scanner->next;
+    while (last < scanner->end && !isspace((unsigned char) *last) && *last != ',')
+    {
+        ++last;
+    }
+
+    size_t length = (size_t) (last - scanner->next);
+    char stackCopy[MAX_STACK_NUMBER];
+    char *copy = (length < MAX_STACK_NUMBER) ? stackCopy : malloc(length + 1);
+    if (copy == NULL)
+    {
+        return false;
+    }
+    memcpy(copy, scanner->next, length);
+    copy[length] = '\0';
+
+    char *numberEnd;
+    *value = strtof(copy, &numberEnd);
+    size_t consumed = (size_t) (numberEnd - copy);
+    if (copy != stackCopy)
+    {
+        free(copy);
+    }
+
+    scanner->next += consumed;
+    return consumed > 0;
+}
+
+bool scanFloat(text_scanner *scanner, float *value)
+{
+    skipWhitespace(scanner);
+    const char *start = scanner->next;
+    const char *p = start;
+    const char *end = scanner->end;
+
+    bool isNegative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        ++p;
+    }
+
+    // [digits][.digits] into mantissa * 10 ^ exponent
+    uint64_t mantissa = 0;
+    int digits = 0; // significant ones
+    int exponent = 0;
+    bool hasDigits = false;
+    for (; p < end && isdigit((unsigned char) *p); ++p)
+    {
+        hasDigits = true;
+        if (mantissa > 0 || *p != '0')
+        {
+            mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+            ++digits;
+        }
+        if (digits > MAX_MANTISSA_DIGITS)
+        {
+            return scanFloatByLibrary(scanner, value);
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        for (++p; p < end && isdigit((unsigned char) *p); ++p)
+        {
+            hasDigits = true;
+            if (mantissa > 0 || *p != '0')
+            {
+                mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+                ++digits;
+            }
+            --exponent;
+            if (digits > MAX_MANTISSA_DIGITS)
+            {
+                return scanFloatByLibrary(scanner, value);
+            }
+        }
+    }
+    if (!hasDigits)
+    {
+        return scanFloatByLibrary(scanner, value); // inf, nan - or no number at all
+    }
+
+    // [(e|E)[sign]digits]
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char *q = p + 1;
+        bool isNegativeExponent = q < end && *q == '-';
+        if (q < end && (*q == '-' || *q == '+'))
+        {
+            ++q;
+        }
+        if (q == end || !isdigit((unsigned char) *q))
+        {
+            return scanFloatByLibrary(scanner, value);
+        }
+
+        int power = 0;
+        for (; q < end && isdigit((unsigned char) *q); ++q)
+        {
+            if (power <= 2 * MAX_EXACT_POWER)
+            {
+                power = power * 10 + (*q - '0');
+            }
+        }
+        exponent += isNegativeExponent ? -power : power;
+        p = q;
+    }
+    if (p < end && (isalpha((unsigned char) *p) || *p == '.'))
+    {
+        return scanFloatByLibrary(scanner, value); // hexadecimal, or what strtof reads on
+    }
+
+    double number = 0;
+    if (mantissa > 0)
+    {
+        if (mantissa > MAX_EXACT_MANTISSA || exponent < -MAX_EXACT_POWER || exponent > MAX_EXACT_POWER)
+        {
+            return scanFloatByLibrary(scanner, value);
+        }
+        number = (exponent < 0) ? (double) mantissa / POWERS_OF_TEN[-exponent]
+                                : (double) mantissa * POWERS_OF_TEN[exponent];
+
+        // A double halfway between 2 floats may round to the wrong one of them
+        // (twice rounded); so may one out of the floats' normal range
+        const uint64_t LOW_BITS = (1ULL << (DBL_MANT_DIG - FLT_MANT_DIG)) - 1; // dropped by the float
+        const uint64_t HALFWAY = 1ULL << (DBL_MANT_DIG - FLT_MANT_DIG - 1);
+        uint64_t bits;
+        memcpy(&bits, &number, sizeof(bits));
+        if ((bits & LOW_BITS) == HALFWAY || number < FLT_MIN || number > FLT_MAX)
+        {
+            return scanFloatByLibrary(scanner, value);
+        }
+    }
+
+    *value = (float) (isNegative ? -number : number);
+    scanner->next = p;
+    return true;
+}
+
+size_t scanWord(text_scanner *scanner, const char **word)
+{
+    skipWhitespace(scanner);
+    *word = scanner->next;
+    while (scanner->next < scanner->end && !isspace((unsigned char) *scanner->next))
+    {
+        ++scanner->next;
+    }
+    return (size_t) (scanner->next - *word);
+}
@@ -0,0 +1,83 @@
+/*
+ * scanner.h
+ *
+ *  Created on: Apr 29, 2018
+ *      Author: OWNER
+ */
+
+#ifndef SCANNER_H_
+#define SCANNER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A text file read in place: mapped into memory (or, when it can't be mapped -
+ * a pipe - read into a buffer), and scanned by hand instead of by stdio.
+ * Every function reads what the scanf directive (or stdio function) it names would,
+ * and leaves 'next' where that one would leave the file's position, failures
+ * included (e.g. a failed "%d" keeps its sign consumed).
+ */
+typedef struct
+{
+	const char *next;
+	const char *end;
+	char *data; // the mapping or the buffer
+	size_t size;
+	bool isMapped;
+} text_scanner;
+
+/**
+ * Opens the file 'path' for scanning from its start.
+ * @return true on success, false if it could not be opened or read.
+ */
+bool openScanner(text_scanner *scanner, const char *path);
+
+/**
+ * Releases the file (safe to call on a scanner which was never opened).
+ */
+void closeScanner(text_scanner *scanner);
+
+/**
+ * fgetc: returns the next character (as an unsigned char), or EOF at the end.
+ */
+int scanChar(text_scanner *scanner);
+
+/**
+ * fgets: copies the rest of the line (with its '\n') into 'line', at most size - 1 characters.
+ * @return true on success, false at the end.
+ */
+bool scanLine(text_scanner *scanner, char *line, size_t size);
+
+/**
+ * A white-space directive: skips any white-space.
+ */
+void skipWhitespace(text_scanner *scanner);
+
+/**
+ * An ordinary character directive: consumes 'c' if it's next.
+ * @return true if it was, otherwise false.
+ */
+bool scanLiteral(text_scanner *scanner, char c);
+
+/**
+ * "%d" (an int out of range is cut like scanf's).
+ * @return true on success, false if no number is next.
+ */
+bool scanInt(text_scanner *scanner, int *value);
+
+/**
+ * "%f": decimal numbers of up to 19 digits (with an exponent of up to 22) are
+ * converted by hand, the others (and inf, nan & hexadecimal ones) by strtof;
+ * both round correctly, so it's the very same float.
+ * @return true on success, false if no number is next.
+ */
+bool scanFloat(text_scanner *scanner, float *value);
+
+/**
+ * "%s": skips white-space & returns the word which follows (not terminated) in 'word'.
+ * @return its length (0 at the end).
+ */
+size_t scanWord(text_scanner *scanner, const char **word);
+
+#endif /* SCANNER_H_ */
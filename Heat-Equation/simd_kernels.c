@@ -0,0 +1,134 @@
+/**
+ * @author Roy Ackerman
+ *
+ * The vectorized Jacobi kernels of heat_eqn. Every kernel is compiled for its
+ * own instruction set (with the target attribute), so the same binary carries
+ * all of them and heatJacobiKernel() picks one by the CPU it runs on.
+ * They compute HEAT_EQN in the very same order as the scalar kernel, so all
+ * the levels give bit-identical passes.
+ */
+#include "kernels.h"
+#include "heat_eqn.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef HAVE_X86_SIMD
+
+/**
+ * The scalar tail of the vectorized kernels.
+ */
+static void heatJacobiTail(double *next, const double *cells, const double *up, const double *down,
+                           size_t from, const size_t to)
+{
+    for (; from < to; ++from)
+    {
+        next[from] = HEAT_EQN(cells[from], cells[from + 1], up[from], cells[from - 1], down[from]);
+    }
+}
+
+/**
+ * Defines the Jacobi kernel 'name' for the instruction set 'ISA', which
+ * works on 'WIDTH' doubles at a time of the vector type 'vector', using the
+ * LOAD, STORE, ADD & MUL intrinsics & SET1 (a broadcast).
+ */
+#define DEFINE_JACOBI_KERNEL(name, ISA, vector, WIDTH, LOAD, STORE, ADD, MUL, SET1) \
+__attribute__((target(ISA))) \
+static void name(double *next, const double *cells, const double *up, const double *down, \
+                 size_t from, const size_t to, const kernel_params *params) \
+{ \
+    const vector QUARTER = SET1(0.25); /* x / 4 == x * 0.25 exactly */ \
+    (void) params; \
+    for (; from + WIDTH <= to; from += WIDTH) \
+    { \
+        vector horizontal = ADD(LOAD(cells + from + 1), LOAD(cells + from - 1)); \
+        vector vertical = ADD(LOAD(up + from), LOAD(down + from)); \
+        STORE(next + from, MUL(ADD(horizontal, vertical), QUARTER)); \
+    } \
+    heatJacobiTail(next, cells, up, down, from, to); \
+}
+
+DEFINE_JACOBI_KERNEL(heatJacobiRowSse2, "sse2", __m128d, 2,
+                     _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, _mm_mul_pd, _mm_set1_pd)
+DEFINE_JACOBI_KERNEL(heatJacobiRowAvx2, "avx2", __m256d, 4,
+                     _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, _mm256_mul_pd, _mm256_set1_pd)
+DEFINE_JACOBI_KERNEL(heatJacobiRowAvx512, "avx512f", __m512d, 8,
+                     _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, _mm512_mul_pd, _mm512_set1_pd)
+
+/**
+ * Detects the CPU's SIMD level with cpuid.
+ * @return the best level the CPU supports.
+ */
+simd_level detectSimdLevel()
+{
+    static simd_level detected = SIMD_AUTO;
+
+    if (detected == SIMD_AUTO)
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+        {
+            detected = SIMD_AVX512;
+        }
+        else if (__builtin_cpu_supports("avx2"))
+        {
+            detected = SIMD_AVX2;
+        }
+        else if (__builtin_cpu_supports("sse2"))
+        {
+            detected = SIMD_SSE2;
+        }
+        else
+        {
+            detected = SIMD_SCALAR;
+        }
+    }
+
+    return detected;
+}
+
+/**
+ * Returns the vectorized Jacobi kernel for 'level'.
+ * @param level
+ * @return the kernel, or NULL for the scalar level.
+ */
+row_kernel heatJacobiKernel(simd_level level)
+{
+    simd_level cpu = detectSimdLevel();
+    if (level == SIMD_AUTO || level > cpu)
+    {
+        level = cpu;
+    }
+
+    switch (level)
+    {
+        case SIMD_AVX512:
+            return heatJacobiRowAvx512;
+        case SIMD_AVX2:
+            return heatJacobiRowAvx2;
+        case SIMD_SSE2:
+            return heatJacobiRowSse2;
+        default:
+            return NULL;
+    }
+}
+
+#else
+
+/**
+ * No vectorized kernels on this architecture.
+ */
+simd_level detectSimdLevel()
+{
+    return SIMD_SCALAR;
+}
+
+row_kernel heatJacobiKernel(simd_level level)
+{
+    (void) level;
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,214 @@
+/**
+ * @author Roy Ackerman
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "snapshot.h"
+#include "output.h"
+
+/**
+ * A queued frame: the copy of the grid & what its header tells.
+ */
+typedef struct
+{
+    heat_grid grid;
+    unsigned int pass;
+    double monitor;
+} snapshot_frame;
+
+struct snapshot_writer
+{
+    FILE *file;
+    bool isBinary;
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t queued; // signaled when a frame is queued (or on close)
+
+    // the ring of frames: 'count' queued ones from 'first'
+    snapshot_frame frames[SNAPSHOT_FRAMES];
+    size_t first;
+    size_t count;
+    unsigned int written;
+    unsigned int dropped;
+    bool isClosing;
+};
+
+/**
+ * Writes a frame into the writer's file.
+ * @param writer
+ * @param frame
+ */
+static void writeFrame(snapshot_writer *writer, const snapshot_frame *frame)
+{
+    ++writer->written;
+    if (writer->isBinary)
+    {
+        writeBinaryGrid(writer->file, &frame->grid, frame->monitor, frame->pass, writer->written);
+    }
+    else
+    {
+        fprintf(writer->file, "pass %u\n", frame->pass);
+        writeCsvGrid(writer->file, &frame->grid, frame->monitor);
+    }
+}
+
+/**
+ * The writer's loop: waits for a queued frame, writes it & frees its buffer,
+ * until it's closed & nothing is queued.
+ * @param arg the writer
+ * @return NULL
+ */
+static void *writerLoop(void *arg)
+{
+    snapshot_writer *writer = arg;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&writer->lock);
+        while (writer->count == 0 && !writer->isClosing)
+        {
+            pthread_cond_wait(&writer->queued, &writer->lock);
+        }
+        if (writer->count == 0)
+        {
+            pthread_mutex_unlock(&writer->lock);
+            return NULL;
+        }
+        const snapshot_frame *frame = &writer->frames[writer->first];
+        pthread_mutex_unlock(&writer->lock);
+
+        writeFrame(writer, frame); // the passes don't touch a queued frame
+
+        pthread_mutex_lock(&writer->lock);
+        writer->first = (writer->first + 1) % SNAPSHOT_FRAMES;
+        writer->count--;
+        pthread_mutex_unlock(&writer->lock);
+    }
+}
+
+/**
+ * Frees the writer's buffers & closes its file.
+ * @param writer
+ */
+static void freeSnapshotWriter(snapshot_writer *writer)
+{
+    for (size_t i = 0; i < SNAPSHOT_FRAMES; ++i)
+    {
+        freeHeatGrid(&writer->frames[i].grid);
+    }
+    if (writer->file != NULL)
+    {
+        fclose(writer->file);
+    }
+    free(writer);
+}
+
+/**
+ * Opens the file & starts the writer.
+ * @param path
+ * @param rows
+ * @param columns
+ * @param is_binary binary frames, otherwise CSV ones
+ * @return the writer, or NULL on failure.
+ */
+snapshot_writer *createSnapshotWriter(const char *path, const size_t rows, const size_t columns,
+                                      const bool is_binary)
+{
+    snapshot_writer *writer = calloc(1, sizeof(snapshot_writer));
+    if (writer == NULL)
+    {
+        return NULL;
+    }
+
+    writer->isBinary = is_binary;
+    writer->file = fopen(path, is_binary ? "wb" : "w");
+    bool isCreated = writer->file != NULL;
+    for (size_t i = 0; i < SNAPSHOT_FRAMES && isCreated; ++i)
+    {
+        isCreated = createHeatGrid(&writer->frames[i].grid, rows, columns);
+    }
+    if (!isCreated)
+    {
+        freeSnapshotWriter(writer);
+        return NULL;
+    }
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->queued, NULL);
+    if (pthread_create(&writer->thread, NULL, writerLoop, writer) != 0)
+    {
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->queued);
+        freeSnapshotWriter(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+/**
+ * Queues a copy of the grid, unless all the buffers are queued.
+ * @param writer
+ * @param grid
+ * @param pass
+ * @param monitor
+ * @return true if queued, false if dropped.
+ */
+bool offerSnapshot(snapshot_writer *writer, const heat_grid *grid, const unsigned int pass, const double monitor)
+{
+    pthread_mutex_lock(&writer->lock);
+    bool isFull = writer->count == SNAPSHOT_FRAMES;
+    snapshot_frame *frame = &writer->frames[(writer->first + writer->count) % SNAPSHOT_FRAMES];
+    if (isFull)
+    {
+        writer->dropped++;
+    }
+    pthread_mutex_unlock(&writer->lock);
+    if (isFull)
+    {
+        return false;
+    }
+
+    // The free buffer is the caller's until it's queued
+    for (size_t r = 0; r < grid->rows; ++r)
+    {
+        memcpy(heatGridRow(&frame->grid, r), heatGridRow(grid, r), grid->columns * sizeof(double));
+    }
+    frame->pass = pass;
+    frame->monitor = monitor;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->count++;
+    pthread_cond_signal(&writer->queued);
+    pthread_mutex_unlock(&writer->lock);
+    return true;
+}
+
+/**
+ * Lets the thread write what's queued, joins it & frees the writer.
+ * @param writer
+ * @return the number of dropped frames.
+ */
+unsigned int closeSnapshotWriter(snapshot_writer *writer)
+{
+    if (writer == NULL)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->isClosing = true;
+    pthread_cond_signal(&writer->queued);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    unsigned int dropped = writer->dropped;
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->queued);
+    freeSnapshotWriter(writer);
+    return dropped;
+}
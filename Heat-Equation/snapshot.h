@@ -0,0 +1,54 @@
+/*
+ * snapshot.h
+ *
+ *  Created on: Apr 27, 2018
+ *      Author: OWNER
+ */
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include <stdbool.h>
+#include "grid.h"
+
+/**
+ * A background thread writing frames (copies of the grid taken between passes)
+ * into a file, so the passes don't wait for the writing. The frames go through
+ * SNAPSHOT_FRAMES spare buffers: a frame is copied into a free one and queued,
+ * and when all of them are still queued (the writer fell behind) the frame is
+ * dropped instead of stalling the passes.
+ *
+ * A binary frame is a binary_header (see output.h) whose 'iterations' is the pass
+ * of the frame in its calculation, whose 'calculation' counts the frames from 1 and
+ * whose precision is the monitor of the latest checked pass (0 before the first),
+ * followed by the cells. A CSV frame is a "pass <pass>" line followed by the
+ * output of FORMAT_CSV (with that monitor as the precision).
+ */
+typedef struct snapshot_writer snapshot_writer;
+
+/**
+ * The spare buffers of a writer: one being written while the next is filled.
+ */
+#define SNAPSHOT_FRAMES 2
+
+/**
+ * Opens the file 'path' & starts the writer of rows x columns frames.
+ * @return the writer, or NULL if the file could not be opened or the buffers allocated.
+ */
+snapshot_writer *createSnapshotWriter(const char *path, size_t rows, size_t columns, bool is_binary);
+
+/**
+ * Copies 'grid' (of the writer's size) into a free buffer & queues it as the
+ * frame of the pass 'pass'.
+ * @return true if queued, false if dropped (no buffer is free).
+ */
+bool offerSnapshot(snapshot_writer *writer, const heat_grid *grid, unsigned int pass, double monitor);
+
+/**
+ * Writes the queued frames, stops the thread, closes the file & frees the writer
+ * (NULL is allowed).
+ * @return the number of frames which were dropped.
+ */
+unsigned int closeSnapshotWriter(snapshot_writer *writer);
+
+#endif /* SNAPSHOT_H_ */
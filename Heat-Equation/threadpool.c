@@ -0,0 +1,280 @@
+/**
+ * @author Roy Ackerman
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "threadpool.h"
+
+struct thread_pool
+{
+    unsigned int threads;
+    pthread_t *workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start; // signaled when a new job is posted (or on stop)
+    pthread_cond_t done; // signaled when the last thread finished the job
+
+    // the current job
+    unsigned long generation;
+    range_task task;
+    void *context;
+    size_t count;
+    bool isDynamic; // the items are taken one at a time (from nextItem) instead of in chunks
+    size_t nextItem;
+    unsigned int running; // threads which didn't finish the job yet
+    bool stop;
+};
+
+/**
+ * The worker's index & pool.
+ */
+typedef struct
+{
+    thread_pool *pool;
+    unsigned int index;
+} worker_args;
+
+/**
+ * Returns the number of the online processors.
+ */
+unsigned int numOfProcessors()
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 0 ? (unsigned int) processors : 1;
+}
+
+/**
+ * Takes the next item of a dynamic job.
+ * @param pool
+ * @param item output parameter: the item.
+ * @return true if one was left, otherwise false.
+ */
+static bool takeItem(thread_pool *pool, size_t *item)
+{
+    pthread_mutex_lock(&pool->lock);
+    *item = pool->nextItem;
+    bool isLeft = *item < pool->count;
+    if (isLeft)
+    {
+        pool->nextItem++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return isLeft;
+}
+
+/**
+ * Runs the thread 'index''s share of the current job: its chunk, or the items
+ * it takes until none is left.
+ * @param pool
+ * @param index
+ */
+static void runShare(thread_pool *pool, const unsigned int index)
+{
+    if (pool->isDynamic)
+    {
+        size_t item;
+        while (takeItem(pool, &item))
+        {
+            pool->task(item, item + 1, index, pool->context);
+        }
+        return;
+    }
+
+    size_t from = pool->count * index / pool->threads;
+    size_t to = pool->count * (index + 1) / pool->threads;
+    if (from < to)
+    {
+        pool->task(from, to, index, pool->context);
+    }
+}
+
+/**
+ * Marks the calling thread as done with the current job.
+ * @param pool
+ */
+static void finishShare(thread_pool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->running == 0)
+    {
+        pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * A worker's loop: waits for a job, runs its share & waits for the next one.
+ * @param arg the worker_args
+ * @return NULL
+ */
+static void *workerLoop(void *arg)
+{
+    worker_args args = *(worker_args *) arg;
+    thread_pool *pool = args.pool;
+    unsigned long seen = 0;
+
+    free(arg);
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->stop)
+        {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stop)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        runShare(pool, args.index);
+        finishShare(pool);
+    }
+}
+
+/**
+ * Creates the pool & starts its threads.
+ * @param threads the number of threads (0 - one per processor)
+ * @return the pool, or NULL on failure.
+ */
+thread_pool *createThreadPool(unsigned int threads)
+{
+    thread_pool *pool = calloc(1, sizeof(thread_pool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+
+    pool->threads = (threads == 0) ? numOfProcessors() : threads;
+    pool->workers = calloc(pool->threads, sizeof(pthread_t));
+    if (pool->workers == NULL)
+    {
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // The caller is thread 0
+    for (unsigned int i = 1; i < pool->threads; ++i)
+    {
+        worker_args *args = malloc(sizeof(worker_args));
+        if (args == NULL)
+        {
+            pool->threads = i;
+            destroyThreadPool(pool);
+            return NULL;
+        }
+        args->pool = pool;
+        args->index = i;
+        if (pthread_create(&pool->workers[i], NULL, workerLoop, args) != 0)
+        {
+            free(args);
+            pool->threads = i;
+            destroyThreadPool(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+/**
+ * Returns the number of threads of the pool.
+ */
+unsigned int poolThreads(const thread_pool *pool)
+{
+    return pool == NULL ? 1 : pool->threads;
+}
+
+/**
+ * Posts a job to all the threads, runs the caller's share and waits for the rest.
+ * @param pool
+ * @param count
+ * @param task
+ * @param context
+ * @param isDynamic whether the items are taken one at a time
+ */
+static void runJob(thread_pool *pool, const size_t count, const range_task task, void *context,
+                   const bool isDynamic)
+{
+    if (pool == NULL || pool->threads == 1)
+    {
+        if (count > 0)
+        {
+            task(0, count, 0, context);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->count = count;
+    pool->isDynamic = isDynamic;
+    pool->nextItem = 0;
+    pool->running = pool->threads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    runShare(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->running--;
+    while (pool->running > 0)
+    {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Runs 'task' over [0, count) in one static chunk per thread.
+ */
+void runParallel(thread_pool *pool, const size_t count, const range_task task, void *context)
+{
+    runJob(pool, count, task, context, false);
+}
+
+/**
+ * Runs 'task' over [0, count) an item at a time.
+ */
+void runDynamic(thread_pool *pool, const size_t count, const range_task task, void *context)
+{
+    runJob(pool, count, task, context, true);
+}
+
+/**
+ * Stops & joins the threads, and frees the pool.
+ * @param pool
+ */
+void destroyThreadPool(thread_pool *pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned int i = 1; i < pool->threads; ++i)
+    {
+        pthread_join(pool->workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->workers);
+    free(pool);
+}
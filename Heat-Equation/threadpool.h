@@ -0,0 +1,61 @@
+/*
+ * threadpool.h
+ *
+ *  Created on: Apr 20, 2018
+ *      Author: OWNER
+ */
+
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <stdlib.h>
+
+/**
+ * A fixed set of threads which run fork-join range tasks.
+ */
+typedef struct thread_pool thread_pool;
+
+/**
+ * A task over the items [from, to) of a range, run by the pool's thread 'thread'
+ * (0 .. threads - 1, 0 being the caller).
+ */
+typedef void (*range_task)(size_t from, size_t to, unsigned int thread, void *context);
+
+/**
+ * Returns the number of the online processors.
+ */
+unsigned int numOfProcessors();
+
+/**
+ * Creates a pool running tasks on 'threads' threads (the caller being one of
+ * them, so threads - 1 are started). 0 means one thread per processor.
+ * @return the pool, or NULL on failure.
+ */
+thread_pool *createThreadPool(unsigned int threads);
+
+/**
+ * Returns the number of threads running the pool's tasks.
+ */
+unsigned int poolThreads(const thread_pool *pool);
+
+/**
+ * Runs 'task' over [0, count), split into one contiguous chunk per thread
+ * (always the same chunks for the same count), and waits for all of them.
+ * A NULL pool runs the whole range on the caller.
+ */
+void runParallel(thread_pool *pool, size_t count, range_task task, void *context);
+
+/**
+ * Runs 'task' over [0, count) one item at a time: every thread takes the next
+ * item no thread took yet, so items of uneven cost keep all the threads busy
+ * (in no particular order), and waits for all of them. A NULL pool runs the
+ * whole range on the caller.
+ */
+void runDynamic(thread_pool *pool, size_t count, range_task task, void *context);
+
+/**
+ * Stops the threads & frees the pool (NULL is allowed).
+ */
+void destroyThreadPool(thread_pool *pool);
+
+#endif /* THREADPOOL_H_ */
@@ -0,0 +1,99 @@
+/**
+ * @author Roy Ackerman
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <time.h>
+#include "timings.h"
+
+/**
+ * The bytes an update moves: its cell's double, read & written.
+ */
+#define BYTES_PER_UPDATE (2 * sizeof(double))
+
+/**
+ * Returns the seconds of CLOCK_MONOTONIC.
+ */
+double monotonicSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+/**
+ * Writes 'text' as a JSON string (quoted, with '"', '\' & control characters escaped).
+ * @param out
+ * @param text
+ */
+static void writeJsonString(FILE *out, const char *text)
+{
+    fputc('"', out);
+    for (; *text != '\0'; ++text)
+    {
+        unsigned char c = (unsigned char) *text;
+        if (c == '"' || c == '\\')
+        {
+            fputc('\\', out);
+            fputc(c, out);
+        }
+        else if (c < ' ')
+        {
+            fprintf(out, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/**
+ * Returns 'amount' per second of 'seconds' (0 for no time at all).
+ */
+static double perSecond(const double amount, const double seconds)
+{
+    return (seconds > 0) ? amount / seconds : 0;
+}
+
+/**
+ * Appends the timings to 'path' as a single line of JSON.
+ * @param path
+ * @param timings
+ * @return true on success, false if the file could not be written.
+ */
+bool appendTimings(const char *path, const run_timings *timings)
+{
+    FILE *out = fopen(path, "a");
+    if (out == NULL)
+    {
+        return false;
+    }
+
+    double updates = (double) timings->rows * (double) timings->columns * (double) timings->passes;
+
+    fprintf(out, "{\"parameter_file\": ");
+    writeJsonString(out, timings->parameterFile);
+    fprintf(out, ", \"rows\": %zu, \"columns\": %zu, \"sweep\": ", timings->rows, timings->columns);
+    writeJsonString(out, timings->sweep);
+    fprintf(out, ", \"solver\": ");
+    writeJsonString(out, timings->solver);
+    fprintf(out, ", \"threads\": %u, \"calculations\": %u, \"passes\": %llu",
+            timings->threads, timings->calculations, timings->passes);
+    fprintf(out, ", \"parse_seconds\": %.9f, \"solve_seconds\": %.9f, \"output_seconds\": %.9f",
+            timings->parseSeconds, timings->solveSeconds, timings->outputSeconds);
+    if (!timings->isPassesOnly)
+    {
+        fprintf(out, ", \"cell_updates_per_second\": null, \"effective_bandwidth_bytes_per_second\": null}\n");
+    }
+    else
+    {
+        fprintf(out, ", \"cell_updates_per_second\": %.6e, \"effective_bandwidth_bytes_per_second\": %.6e}\n",
+                perSecond(updates, timings->solveSeconds),
+                perSecond(updates * BYTES_PER_UPDATE, timings->solveSeconds));
+    }
+
+    return fclose(out) == 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * timings.h
+ *
+ *  Created on: Apr 29, 2018
+ *      Author: OWNER
+ */
+
+#ifndef TIMINGS_H_
+#define TIMINGS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * What a run measured of itself: the seconds of its phases - parsing the
+ * parameter file (with creating & initializing the grid), the calculations and
+ * writing the grids - and the passes of all its calculations. When the
+ * calculations did more than their passes (a multigrid, CG or mixed precision
+ * solve), the passes don't measure their work, and the throughput is unknown.
+ */
+typedef struct
+{
+	const char *parameterFile;
+	size_t rows, columns;
+	const char *sweep, *solver;
+	unsigned int threads;
+	unsigned int calculations;
+	unsigned long long passes;
+	bool isPassesOnly; // the calculations' work is their passes
+	double parseSeconds, solveSeconds, outputSeconds;
+} run_timings;
+
+/**
+ * Returns the seconds of a monotonic clock (from an arbitrary start).
+ */
+double monotonicSeconds();
+
+/**
+ * Appends the timings to the file 'path' as a line of JSON, with the cell updates
+ * per second of the calculations and their effective memory bandwidth (as if every
+ * update read & wrote its cell's double from memory once), or null ones unless
+ * timings->isPassesOnly.
+ * @return true on success, false if the file could not be written.
+ */
+bool appendTimings(const char *path, const run_timings *timings);
+
+#endif /* TIMINGS_H_ */
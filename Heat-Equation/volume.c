@@ -0,0 +1,437 @@
+/**
+ * @author Roy Ackerman
+ */
+#include <stdbool.h>
+#include <string.h>
+#include "volume.h"
+#include "heat_eqn.h"
+#include "measures.h"
+#include "threadpool.h"
+
+/**
+ * The planes' rows a block keeps in cache (see VOLUME_BLOCK_BYTES).
+ */
+#define VOLUME_BLOCK_PLANES 4
+
+/**
+ * The state of a calculation on a volume.
+ */
+typedef struct
+{
+    volume_func function;
+    bool isHeatEqn; // the function is heat_eqn3, whose expression is inlined
+    bool isCyclic;
+    solver_options options;
+    heat_volume *volume; // the caller's
+    heat_volume scratch; // the Jacobi passes' second buffer
+    heat_volume *current; // the latest pass (the volume itself, or the scratch)
+    heat_volume *next; // the one a Jacobi pass writes
+    double *zeros; // the neighbours out of a non-cyclic volume
+    double *oldRow; // a row before its Gauss-Seidel update
+    size_t *rowStart, *sourceColumns; // the source index of the volume's grid rows
+    compensated_sum *rowSums; // by the volume's grid rows
+    update_norms *rowNorms;
+    bool trackSum, trackNorms;
+    size_t blockRows;
+    thread_pool *pool; // of the Jacobi passes
+} volume_calculation;
+
+/**
+ * Returns the row of 'cells' which is the neighbour of the row 'row' of the
+ * plane 'plane' by 'planeStep' planes & 'rowStep' rows: wrapped around in a
+ * cyclic volume, the zeros out of any other.
+ */
+static const double *neighbourRow(const volume_calculation *calc, const heat_volume *cells, const size_t plane,
+                                  const size_t row, const int planeStep, const int rowStep)
+{
+    ptrdiff_t planes = (ptrdiff_t) cells->planes;
+    ptrdiff_t rows = (ptrdiff_t) cells->rows;
+    ptrdiff_t z = (ptrdiff_t) plane + planeStep;
+    ptrdiff_t x = (ptrdiff_t) row + rowStep;
+    if ((z < 0 || z >= planes || x < 0 || x >= rows) && !calc->isCyclic)
+    {
+        return calc->zeros;
+    }
+    return heatVolumeRow(cells, (size_t) ((z + planes) % planes), (size_t) ((x + rows) % rows));
+}
+
+/**
+ * Updates the cells [from, to) of a row into 'out' (the row itself in place).
+ * @param cells the row (with its halo cells)
+ * @param out
+ * @param top the row before it in its plane
+ * @param bottom the row after it
+ * @param front the row in the previous plane
+ * @param back the row in the next plane
+ */
+static void updateCells(const volume_calculation *calc, const double *cells, double *out, const double *top,
+                        const double *bottom, const double *front, const double *back, const size_t from,
+                        const size_t to)
+{
+    if (calc->isHeatEqn)
+    {
+        for (size_t col = from; col < to; ++col)
+        {
+            out[col] = HEAT_EQN3(cells[col], cells[col + 1], top[col], cells[col - 1], bottom[col], front[col],
+                                 back[col]);
+        }
+        return;
+    }
+
+    for (size_t col = from; col < to; ++col)
+    {
+        out[col] = calc->function(cells[col], cells[col + 1], top[col], cells[col - 1], bottom[col], front[col],
+                                  back[col]);
+    }
+}
+
+/**
+ * Updates the cells [from, to) of the row 'row' of the plane 'plane' from
+ * 'cells' into 'next' (which is 'cells' itself for an in-place pass), skipping
+ * the row's sources.
+ */
+static void activateRow(const volume_calculation *calc, const heat_volume *cells, heat_volume *next,
+                        const size_t plane, const size_t row, const size_t from, const size_t to)
+{
+    size_t gridRow = plane * cells->rows + row;
+    const size_t *source = calc->sourceColumns + calc->rowStart[gridRow];
+    const size_t *sourcesEnd = calc->sourceColumns + calc->rowStart[gridRow + 1];
+    const double *top = neighbourRow(calc, cells, plane, row, 0, -1);
+    const double *bottom = neighbourRow(calc, cells, plane, row, 0, 1);
+    const double *front = neighbourRow(calc, cells, plane, row, -1, 0);
+    const double *back = neighbourRow(calc, cells, plane, row, 1, 0);
+    const double *in = heatVolumeRow(cells, plane, row);
+    double *out = heatVolumeRow(next, plane, row);
+
+    while (source < sourcesEnd && *source < from)
+    {
+        ++source;
+    }
+    for (size_t col = from; col < to;)
+    {
+        size_t stop = (source < sourcesEnd && *source < to) ? *source : to;
+        updateCells(calc, in, out, top, bottom, front, back, col, stop);
+        if (stop == to)
+        {
+            break;
+        }
+        col = stop + 1; // past the source
+        ++source;
+    }
+}
+
+/**
+ * Sums the row into calc->rowSums & measures its changes from 'old' into
+ * calc->rowNorms, as far as the pass needs them.
+ * @param updated the row after the pass
+ * @param old the row before it
+ * @param gridRow the row's index in the volume's grid
+ */
+static void finishRow(volume_calculation *calc, const double *updated, const double *old, const size_t gridRow)
+{
+    const size_t columns = calc->volume->columns;
+
+    if (calc->trackSum)
+    {
+        calc->rowSums[gridRow] = sumCells(updated, columns);
+    }
+    if (calc->trackNorms)
+    {
+        update_norms norms = {0, 0, 0};
+        measureChanges(&norms, updated, old, 0, columns);
+        calc->rowNorms[gridRow] = norms;
+    }
+}
+
+/**
+ * Updates the row 'row' of the plane 'plane' in place, refreshing its halo
+ * cells right before they're read when cyclic (like the 2D Gauss-Seidel pass):
+ * the first cell sees the last one's old value, the last cell the first one's new value.
+ */
+static void heatRow(volume_calculation *calc, const size_t plane, const size_t row)
+{
+    const size_t FIRST = 0;
+    const size_t columns = calc->volume->columns;
+
+    if (!calc->isCyclic)
+    {
+        activateRow(calc, calc->volume, calc->volume, plane, row, FIRST, columns);
+        return;
+    }
+
+    double *cells = heatVolumeRow(calc->volume, plane, row);
+    cells[-1] = cells[columns - 1];
+    cells[columns] = cells[FIRST];
+    activateRow(calc, calc->volume, calc->volume, plane, row, FIRST, FIRST + 1);
+    cells[columns] = cells[FIRST];
+    activateRow(calc, calc->volume, calc->volume, plane, row, FIRST + 1, columns);
+}
+
+/**
+ * A Gauss-Seidel pass over the volume, in place: block of rows after block, each
+ * one through all the planes. Every cell sees the same updated neighbours as in
+ * the plane order - the ones before it in its row, in its plane & in its column
+ * of planes - since the rows a block reads of the other blocks are either
+ * updated through all the planes already or not at all.
+ */
+static void gaussSeidelPass(volume_calculation *calc)
+{
+    const heat_volume *volume = calc->volume;
+
+    for (size_t first = 0; first < volume->rows; first += calc->blockRows)
+    {
+        size_t last = (first + calc->blockRows < volume->rows) ? first + calc->blockRows : volume->rows;
+        for (size_t plane = 0; plane < volume->planes; ++plane)
+        {
+            for (size_t row = first; row < last; ++row)
+            {
+                double *cells = heatVolumeRow(volume, plane, row);
+                if (calc->trackNorms)
+                {
+                    memcpy(calc->oldRow, cells, volume->columns * sizeof(double));
+                }
+                heatRow(calc, plane, row);
+                finishRow(calc, cells, calc->oldRow, plane * volume->rows + row);
+            }
+        }
+    }
+}
+
+/**
+ * The range task of a Jacobi pass: calculates the blocks of rows [from, to)
+ * of the calculation's 'next' volume from its current one, through all the planes.
+ */
+static void jacobiBlocks(const size_t from, const size_t to, const unsigned int thread, void *context)
+{
+    volume_calculation *calc = context;
+    const heat_volume *volume = calc->volume;
+
+    (void) thread;
+    for (size_t block = from; block < to; ++block)
+    {
+        size_t first = block * calc->blockRows;
+        size_t last = (first + calc->blockRows < volume->rows) ? first + calc->blockRows : volume->rows;
+        for (size_t plane = 0; plane < volume->planes; ++plane)
+        {
+            for (size_t row = first; row < last; ++row)
+            {
+                activateRow(calc, calc->current, calc->next, plane, row, 0, volume->columns);
+                finishRow(calc, heatVolumeRow(calc->next, plane, row), heatVolumeRow(calc->current, plane, row),
+                          plane * volume->rows + row);
+            }
+        }
+    }
+}
+
+/**
+ * A Jacobi pass over the volume, on the pool's threads: every cell of the next
+ * pass from the current one only. Swaps calc->current to the next pass.
+ */
+static void jacobiPass(volume_calculation *calc)
+{
+    calc->next = (calc->current == calc->volume) ? &calc->scratch : calc->volume;
+    if (calc->isCyclic)
+    {
+        wrapHeatGridHalo(&calc->current->grid);
+    }
+
+    size_t blocks = (calc->volume->rows + calc->blockRows - 1) / calc->blockRows;
+    runParallel(calc->pool, blocks, jacobiBlocks, calc);
+    calc->current = calc->next;
+}
+
+/**
+ * Returns the rows of a block: options->volume_block, or as many as keep
+ * VOLUME_BLOCK_PLANES planes' rows within VOLUME_BLOCK_BYTES; a Jacobi pass
+ * has a block per thread at least.
+ */
+static size_t blockRows(const volume_calculation *calc)
+{
+    const heat_volume *volume = calc->volume;
+    size_t rows = calc->options.volume_block;
+    if (rows == 0)
+    {
+        rows = VOLUME_BLOCK_BYTES / (VOLUME_BLOCK_PLANES * volume->grid.stride * sizeof(double));
+    }
+    if (calc->pool != NULL)
+    {
+        size_t threads = poolThreads(calc->pool);
+        size_t rowsPerThread = (volume->rows + threads - 1) / threads;
+        rows = (rows < rowsPerThread) ? rows : rowsPerThread;
+    }
+    return (rows > 0) ? rows : 1;
+}
+
+/**
+ * Allocates the calculation's buffers: the source index, the row measures, the
+ * zeros, the Gauss-Seidel pass's old row or the Jacobi pass's second volume
+ * (with the sources in it) & pool.
+ * @return true if succeed, otherwise false.
+ */
+static bool acquireBuffers(volume_calculation *calc, const volume_source *sources, const size_t num_sources)
+{
+    const heat_volume *volume = calc->volume;
+
+    source_point *gridSources = malloc((num_sources + 1) * sizeof(source_point)); // at the volume's grid rows
+    if (gridSources == NULL)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < num_sources; ++i)
+    {
+        gridSources[i].x = sources[i].z * (int) volume->rows + sources[i].x;
+        gridSources[i].y = sources[i].y;
+        gridSources[i].value = sources[i].value;
+    }
+    bool isIndexed = indexSources(gridSources, num_sources, 0, 0, volume->grid.rows, volume->columns,
+                                  &calc->rowStart, &calc->sourceColumns);
+    free(gridSources);
+
+    calc->rowSums = malloc(volume->grid.rows * sizeof(compensated_sum));
+    calc->rowNorms = malloc(volume->grid.rows * sizeof(update_norms));
+    calc->zeros = calloc(volume->columns, sizeof(double));
+    if (!isIndexed || calc->rowSums == NULL || calc->rowNorms == NULL || calc->zeros == NULL)
+    {
+        return false;
+    }
+
+    if (calc->options.order != SWEEP_JACOBI)
+    {
+        calc->oldRow = malloc(volume->columns * sizeof(double));
+        return calc->oldRow != NULL;
+    }
+
+    calc->pool = createThreadPool(calc->options.threads);
+    if (calc->pool == NULL || !createHeatVolume(&calc->scratch, volume->planes, volume->rows, volume->columns))
+    {
+        return false;
+    }
+    for (size_t row = 0; row < volume->grid.rows; ++row)
+    {
+        memcpy(heatGridRow(&calc->scratch.grid, (ptrdiff_t) row), heatGridRow(&volume->grid, (ptrdiff_t) row),
+               volume->columns * sizeof(double));
+    }
+    return true;
+}
+
+/**
+ * Frees the calculation's buffers.
+ */
+static void releaseBuffers(volume_calculation *calc)
+{
+    free(calc->rowStart);
+    free(calc->sourceColumns);
+    free(calc->rowSums);
+    free(calc->rowNorms);
+    free(calc->zeros);
+    free(calc->oldRow);
+    freeHeatVolume(&calc->scratch);
+    destroyThreadPool(calc->pool);
+}
+
+/**
+ * Calculator function on a volume (see volume.h).
+ * @param function
+ * @param volume
+ * @param sources
+ * @param num_sources
+ * @param terminate
+ * @param n_iter
+ * @param is_cyclic
+ * @param options (NULL - the default ones)
+ * @return the options' monitor at the last checked pass, or CALCULATION_FAILED.
+ */
+double calculateVolume(volume_func function, heat_volume *volume, const volume_source *sources,
+                       const size_t num_sources, const double terminate, const unsigned int n_iter,
+                       const int is_cyclic, const solver_options *options)
+{
+    volume_calculation calc = {0};
+    calc.function = function;
+    calc.isHeatEqn = function == heat_eqn3;
+    calc.isCyclic = is_cyclic;
+    calc.options = (options != NULL) ? *options : defaultSolverOptions();
+    calc.volume = volume;
+    calc.current = volume;
+
+    if (calc.options.order != SWEEP_GAUSS_SEIDEL && calc.options.order != SWEEP_JACOBI)
+    {
+        return CALCULATION_FAILED; // a volume has no red-black passes
+    }
+    if (!calc.isCyclic)
+    {
+        clearHeatGridHalo(&volume->grid);
+    }
+    if (!acquireBuffers(&calc, sources, num_sources))
+    {
+        releaseBuffers(&calc);
+        return CALCULATION_FAILED;
+    }
+    calc.blockRows = blockRows(&calc);
+
+    beginPhase(calc.options.profile, PHASE_REDUCTION);
+    calc.trackSum = true;
+    for (size_t row = 0; row < volume->grid.rows; ++row)
+    {
+        finishRow(&calc, heatGridRow(&volume->grid, (ptrdiff_t) row), NULL, row);
+    }
+    double currSum = totalOfRowSums(calc.rowSums, volume->grid.rows);
+    endPhase(calc.options.profile, PHASE_REDUCTION);
+
+    double monitor = 0;
+    unsigned int i = 0;
+    for (;;)
+    {
+        ++i;
+        bool isChecked = isCheckedPass(i, n_iter, calc.options.check_interval);
+        // measure only what the checked passes need (the sum monitor needs the sum before them too)
+        calc.trackNorms = calc.options.monitor != MONITOR_SUM_DELTA && isChecked;
+        calc.trackSum = calc.options.monitor == MONITOR_SUM_DELTA &&
+                        (isChecked || isCheckedPass(i + 1, n_iter, calc.options.check_interval));
+        double prevSum = currSum;
+
+        beginPhase(calc.options.profile, PHASE_SWEEP);
+        if (calc.options.order == SWEEP_JACOBI)
+        {
+            jacobiPass(&calc);
+        }
+        else
+        {
+            gaussSeidelPass(&calc);
+        }
+        endPhase(calc.options.profile, PHASE_SWEEP);
+
+        if (calc.trackSum)
+        {
+            beginPhase(calc.options.profile, PHASE_REDUCTION);
+            currSum = totalOfRowSums(calc.rowSums, volume->grid.rows);
+            endPhase(calc.options.profile, PHASE_REDUCTION);
+        }
+        if (isChecked)
+        {
+            update_norms norms = calc.trackNorms ? totalOfRowNorms(calc.rowNorms, volume->grid.rows)
+                                                 : (update_norms) {0, 0, 0};
+            monitor = monitorOfPass(calc.options.monitor, prevSum, currSum, &norms);
+            recordMonitor(calc.options.profile, calc.options.calculation, i, monitor);
+            if (n_iter > 0 || monitor < terminate)
+            {
+                break;
+            }
+        }
+    }
+
+    if (calc.options.passes != NULL)
+    {
+        *calc.options.passes = i;
+    }
+
+    if (calc.current != volume)
+    {
+        for (size_t row = 0; row < volume->grid.rows; ++row)
+        {
+            memcpy(heatGridRow(&volume->grid, (ptrdiff_t) row), heatGridRow(&calc.current->grid, (ptrdiff_t) row),
+                   volume->columns * sizeof(double));
+        }
+    }
+    releaseBuffers(&calc);
+    return monitor;
+}
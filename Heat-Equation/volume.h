@@ -0,0 +1,57 @@
+/*
+ * volume.h
+ *
+ *  Created on: May 4, 2018
+ *      Author: OWNER
+ */
+
+#ifndef VOLUME_H_
+#define VOLUME_H_
+
+#include <stdlib.h>
+#include "calculator.h"
+#include "grid.h"
+
+/**
+ * A heat source of a volume: the row x & column y of the plane z.
+ */
+typedef struct
+{
+	int x, y, z;
+	double value;
+} volume_source;
+
+/**
+ * The 3D diff_func: 'front' & 'back' are the cell's neighbours in the previous
+ * & the next planes.
+ */
+typedef double (*volume_func)(double cell, double right, double top, double left, double bottom, double front,
+		double back);
+
+/**
+ * The bytes of the planes' rows a block of a 3D pass keeps in cache: the rows
+ * of the block in the plane it updates, in the planes before & after it & (in
+ * a Jacobi pass) in the plane it writes. A pass of a volume goes over its blocks
+ * of rows, each one through all the planes (2.5D blocking), instead of plane
+ * after plane - whose every row is reused only a whole plane later, out of
+ * cache once the planes are large. Gives the very same result as the plane
+ * order (the neighbours of every cell which were already updated are the same).
+ */
+#define VOLUME_BLOCK_BYTES (256 * 1024)
+
+/**
+ * Calculator function on a volume: applies the given function to every cell of
+ * the volume iteratively for n_iter loops, or until the options' monitor is below
+ * terminate (if n_iter is 0). When cyclic, the volume wraps around in every axis.
+ * The passes are Gauss-Seidel or Jacobi (on the options' threads), by rows of
+ * options->volume_block; the SIMD level, the time & active tiles, the solver,
+ * the over-relaxation, the snapshots, the checkpoints & the warm start of the
+ * options aren't used.
+ * options may be NULL for the default options.
+ * Returns the options' monitor at the last checked pass, or CALCULATION_FAILED
+ * if the order is red-black or the buffers could not be allocated.
+ */
+double calculateVolume(volume_func function, heat_volume *volume, const volume_source *sources, size_t num_sources,
+		double terminate, unsigned int n_iter, int is_cyclic, const solver_options *options);
+
+#endif /* VOLUME_H_ */
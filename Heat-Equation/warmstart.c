@@ -0,0 +1,568 @@
+/**
+ * @author Roy Ackerman
+ */
+#define _POSIX_C_SOURCE 200112L
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "warmstart.h"
+
+#define WARM_MAGIC "HEATWARM"
+#define WARM_MAGIC_LENGTH 8
+
+/**
+ * The start of a solution's file; the sources (sorted) & the cells (row by row,
+ * without the halo) follow it.
+ */
+typedef struct
+{
+    char magic[WARM_MAGIC_LENGTH];
+    uint64_t rows, columns;
+    uint64_t isCyclic;
+    uint64_t numOfSources;
+    uint64_t hash;
+} warm_header;
+
+/**
+ * A solution in memory; a free entry has no grid.
+ */
+typedef struct
+{
+    size_t rows, columns;
+    int isCyclic;
+    uint64_t hash;
+    source_point *sources; // sorted by their cells
+    size_t numOfSources;
+    heat_grid grid;
+    unsigned long long lastUse;
+} cached_solution;
+
+struct solution_cache
+{
+    char *directory; // NULL - in memory only
+    cached_solution *entries;
+    unsigned int capacity;
+    unsigned long long uses;
+    pthread_mutex_t lock;
+};
+
+/**
+ * A problem: the grid's size & cyclic flag, and its sources (sorted) & their hash.
+ */
+typedef struct
+{
+    size_t rows, columns;
+    int isCyclic;
+    source_point *sources;
+    size_t numOfSources;
+    uint64_t hash;
+} warm_problem;
+
+/**
+ * Orders the sources by their cells (row, then column).
+ */
+static int compareSources(const void *first, const void *second)
+{
+    const source_point *a = first;
+    const source_point *b = second;
+    if (a->x != b->x)
+    {
+        return (a->x < b->x) ? -1 : 1;
+    }
+    return (a->y > b->y) - (a->y < b->y);
+}
+
+/**
+ * Hashes the (sorted) sources by FNV-1a over their cells & values.
+ */
+static uint64_t hashSources(const source_point *sources, const size_t num_sources)
+{
+    const uint64_t OFFSET_BASIS = 14695981039346656037ULL;
+    const uint64_t PRIME = 1099511628211ULL;
+
+    uint64_t hash = OFFSET_BASIS;
+    for (size_t i = 0; i < num_sources; ++i)
+    {
+        unsigned char bytes[2 * sizeof(int) + sizeof(double)];
+        memcpy(bytes, &sources[i].x, sizeof(int));
+        memcpy(bytes + sizeof(int), &sources[i].y, sizeof(int));
+        memcpy(bytes + 2 * sizeof(int), &sources[i].value, sizeof(double));
+        for (size_t b = 0; b < sizeof(bytes); ++b)
+        {
+            hash = (hash ^ bytes[b]) * PRIME;
+        }
+    }
+    return hash;
+}
+
+/**
+ * Describes the problem of a grid & its sources.
+ * @param problem
+ * @param grid
+ * @param sources
+ * @param num_sources
+ * @param is_cyclic
+ * @return true if succeed, otherwise (the sorted copy of the sources) false.
+ */
+static bool describeProblem(warm_problem *problem, const heat_grid *grid, const source_point *sources,
+                            const size_t num_sources, const int is_cyclic)
+{
+    problem->rows = grid->rows;
+    problem->columns = grid->columns;
+    problem->isCyclic = is_cyclic != 0;
+    problem->numOfSources = num_sources;
+    problem->sources = (source_point *) malloc((num_sources + 1) * sizeof(source_point));
+    if (problem->sources == NULL)
+    {
+        return false;
+    }
+    memcpy(problem->sources, sources, num_sources * sizeof(source_point));
+    qsort(problem->sources, num_sources, sizeof(source_point), compareSources);
+    problem->hash = hashSources(problem->sources, num_sources);
+    return true;
+}
+
+/**
+ * Counts the sources which differ between two sorted lists of them: the ones
+ * which aren't in the other list at the same cell with the same value.
+ * @param common set to the number of the sources which are in both
+ * @return the number of the differing sources.
+ */
+static size_t countDifferences(const source_point *first, const size_t numOfFirst, const source_point *second,
+                               const size_t numOfSecond, size_t *common)
+{
+    size_t i = 0, j = 0;
+    *common = 0;
+    while (i < numOfFirst && j < numOfSecond)
+    {
+        int order = compareSources(&first[i], &second[j]);
+        if (order == 0)
+        {
+            *common += first[i].value == second[j].value;
+            ++i;
+            ++j;
+        }
+        else if (order < 0)
+        {
+            ++i;
+        }
+        else
+        {
+            ++j;
+        }
+    }
+    return numOfFirst + numOfSecond - 2 * *common;
+}
+
+/**
+ * checks weather a solution of the problem's size & flag is near it: it has a
+ * source in common with the problem (or neither has sources).
+ * @param common the sources they have in common
+ * @param numOfSources of the solution
+ */
+static bool isNear(const warm_problem *problem, const size_t common, const size_t numOfSources)
+{
+    return common > 0 || (problem->numOfSources == 0 && numOfSources == 0);
+}
+
+/**
+ * Finds the nearest solution of the problem in memory.
+ * @param distance set to its number of differing sources
+ * @return the entry, or NULL if none is near.
+ */
+static cached_solution *findInMemory(solution_cache *cache, const warm_problem *problem, size_t *distance)
+{
+    cached_solution *nearest = NULL;
+    for (unsigned int i = 0; i < cache->capacity; ++i)
+    {
+        cached_solution *entry = &cache->entries[i];
+        if (entry->grid.data == NULL || entry->rows != problem->rows || entry->columns != problem->columns ||
+            entry->isCyclic != problem->isCyclic)
+        {
+            continue;
+        }
+
+        size_t common;
+        size_t differences = countDifferences(problem->sources, problem->numOfSources, entry->sources,
+                                              entry->numOfSources, &common);
+        if (isNear(problem, common, entry->numOfSources) && (nearest == NULL || differences < *distance))
+        {
+            nearest = entry;
+            *distance = differences;
+        }
+    }
+    return nearest;
+}
+
+/**
+ * Writes the file name of the problem's solutions (all of them if 'hash' is
+ * NULL - then it's the names' prefix) into 'name'.
+ * @return the length of the name.
+ */
+static int solutionName(char *name, const size_t size, const warm_problem *problem, const uint64_t *hash)
+{
+    if (hash == NULL)
+    {
+        return snprintf(name, size, "%zux%zu-%d-", problem->rows, problem->columns, problem->isCyclic);
+    }
+    return snprintf(name, size, "%zux%zu-%d-%016llx.warm", problem->rows, problem->columns, problem->isCyclic,
+                    (unsigned long long) *hash);
+}
+
+/**
+ * Reads the header & the sources of a solution's file, and checks that it's
+ * of the problem's size & flag.
+ * @param file
+ * @param header
+ * @param sources set to the sources (to be freed by the caller)
+ * @return true if succeed, otherwise (another file, or the memory) false.
+ */
+static bool readSolutionHeader(FILE *file, const warm_problem *problem, warm_header *header,
+                               source_point **sources)
+{
+    if (fread(header, sizeof(warm_header), 1, file) != 1 || memcmp(header->magic, WARM_MAGIC, WARM_MAGIC_LENGTH) != 0 ||
+        header->rows != problem->rows || header->columns != problem->columns ||
+        header->isCyclic != (uint64_t) problem->isCyclic || header->numOfSources > SIZE_MAX / sizeof(source_point))
+    {
+        return false;
+    }
+
+    *sources = (source_point *) malloc((header->numOfSources + 1) * sizeof(source_point));
+    if (*sources == NULL)
+    {
+        return false;
+    }
+    if (fread(*sources, sizeof(source_point), header->numOfSources, file) != header->numOfSources)
+    {
+        free(*sources);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Frees the grid & the sources of an entry.
+ */
+static void freeEntry(cached_solution *entry)
+{
+    freeHeatGrid(&entry->grid);
+    free(entry->sources);
+    entry->sources = NULL;
+}
+
+/**
+ * Returns the entry for a new solution: the least recently used one (a free one first).
+ */
+static cached_solution *leastRecentlyUsed(solution_cache *cache)
+{
+    cached_solution *oldest = &cache->entries[0];
+    for (unsigned int i = 0; i < cache->capacity; ++i)
+    {
+        cached_solution *entry = &cache->entries[i];
+        if (entry->grid.data == NULL)
+        {
+            return entry;
+        }
+        oldest = (entry->lastUse < oldest->lastUse) ? entry : oldest;
+    }
+    return oldest;
+}
+
+/**
+ * Takes 'grid' & 'sources' into an entry for a solution of the problem.
+ * @return the entry.
+ */
+static cached_solution *keepEntry(solution_cache *cache, const warm_problem *problem, heat_grid *grid,
+                                  source_point *sources, const size_t num_sources, const uint64_t hash)
+{
+    cached_solution *entry = leastRecentlyUsed(cache);
+    freeEntry(entry);
+    entry->rows = problem->rows;
+    entry->columns = problem->columns;
+    entry->isCyclic = problem->isCyclic;
+    entry->hash = hash;
+    entry->sources = sources;
+    entry->numOfSources = num_sources;
+    entry->grid = *grid;
+    entry->lastUse = ++cache->uses;
+    return entry;
+}
+
+/**
+ * Loads the nearest solution of the problem in the directory, if it's nearer
+ * than 'distance', into an entry.
+ * @param distance the differing sources of the nearest solution in memory (if any)
+ * @param isInMemory whether there's a near solution in memory
+ * @return the entry, or NULL if no file is nearer (or it could not be read).
+ */
+static cached_solution *loadNearest(solution_cache *cache, const warm_problem *problem, const size_t distance,
+                                    const bool isInMemory)
+{
+    DIR *directory = (cache->directory != NULL) ? opendir(cache->directory) : NULL;
+    if (directory == NULL)
+    {
+        return NULL;
+    }
+
+    char prefix[FILENAME_MAX];
+    size_t prefixLength = (size_t) solutionName(prefix, sizeof(prefix), problem, NULL);
+    char nearestPath[FILENAME_MAX] = "";
+    size_t nearestDistance = distance;
+    bool isFound = isInMemory;
+
+    for (struct dirent *item = readdir(directory); item != NULL; item = readdir(directory))
+    {
+        char path[FILENAME_MAX];
+        if (strncmp(item->d_name, prefix, prefixLength) != 0 ||
+            snprintf(path, sizeof(path), "%s/%s", cache->directory, item->d_name) >= (int) sizeof(path))
+        {
+            continue;
+        }
+
+        FILE *file = fopen(path, "rb");
+        warm_header header;
+        source_point *sources;
+        if (file == NULL)
+        {
+            continue;
+        }
+        if (readSolutionHeader(file, problem, &header, &sources))
+        {
+            size_t common;
+            size_t differences = countDifferences(problem->sources, problem->numOfSources, sources,
+                                                  header.numOfSources, &common);
+            if (isNear(problem, common, header.numOfSources) && (!isFound || differences < nearestDistance))
+            {
+                strcpy(nearestPath, path);
+                nearestDistance = differences;
+                isFound = true;
+            }
+            free(sources);
+        }
+        fclose(file);
+    }
+    closedir(directory);
+
+    // Reads the nearest file's solution
+    FILE *file = (*nearestPath != '\0') ? fopen(nearestPath, "rb") : NULL;
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    warm_header header;
+    source_point *sources = NULL;
+    heat_grid grid = {0};
+    bool isRead = readSolutionHeader(file, problem, &header, &sources) &&
+                  createHeatGrid(&grid, problem->rows, problem->columns);
+    for (size_t r = 0; r < problem->rows && isRead; ++r)
+    {
+        isRead = fread(heatGridRow(&grid, r), sizeof(double), problem->columns, file) == problem->columns;
+    }
+    fclose(file);
+    if (!isRead)
+    {
+        freeHeatGrid(&grid);
+        free(sources);
+        return NULL;
+    }
+    return keepEntry(cache, problem, &grid, sources, header.numOfSources, header.hash);
+}
+
+/**
+ * Writes a solution into the directory: into a temporary file which then
+ * replaces the solution's file, so a reader never sees half of it.
+ * @return true if succeed, otherwise false.
+ */
+static bool writeSolution(const solution_cache *cache, const warm_problem *problem, const heat_grid *grid)
+{
+    const char *TEMPORARY_SUFFIX = ".tmp";
+
+    char name[FILENAME_MAX];
+    char path[FILENAME_MAX];
+    char temporaryPath[FILENAME_MAX];
+    solutionName(name, sizeof(name), problem, &problem->hash);
+    if (snprintf(path, sizeof(path), "%s/%s", cache->directory, name) >= (int) sizeof(path) ||
+        snprintf(temporaryPath, sizeof(temporaryPath), "%s%s", path, TEMPORARY_SUFFIX) >= (int) sizeof(temporaryPath))
+    {
+        return false;
+    }
+
+    FILE *file = fopen(temporaryPath, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    warm_header header = {WARM_MAGIC, problem->rows, problem->columns, (uint64_t) problem->isCyclic,
+                          problem->numOfSources, problem->hash};
+    bool isWritten = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                     fwrite(problem->sources, sizeof(source_point), problem->numOfSources, file) == problem->numOfSources;
+    for (size_t r = 0; r < problem->rows && isWritten; ++r)
+    {
+        isWritten = fwrite(heatGridRow(grid, r), sizeof(double), problem->columns, file) == problem->columns;
+    }
+    isWritten = (fclose(file) == 0) && isWritten && rename(temporaryPath, path) == 0;
+    if (!isWritten)
+    {
+        remove(temporaryPath);
+    }
+    return isWritten;
+}
+
+/**
+ * Creates a cache of up to 'capacity' solutions in memory, kept in 'directory'
+ * too unless it's NULL.
+ * @param capacity (0 counts as 1)
+ * @param directory
+ * @return the cache, or NULL if it could not be allocated or the directory opened.
+ */
+solution_cache *createSolutionCache(unsigned int capacity, const char *directory)
+{
+    solution_cache *cache = (solution_cache *) calloc(1, sizeof(solution_cache));
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+
+    DIR *opened = (directory != NULL) ? opendir(directory) : NULL;
+    bool isOpened = directory == NULL || opened != NULL;
+    if (opened != NULL)
+    {
+        closedir(opened);
+    }
+
+    cache->capacity = (capacity > 0) ? capacity : 1;
+    cache->entries = (cached_solution *) calloc(cache->capacity, sizeof(cached_solution));
+    cache->directory = (directory != NULL) ? (char *) malloc(strlen(directory) + 1) : NULL;
+    if (!isOpened || cache->entries == NULL || (directory != NULL && cache->directory == NULL))
+    {
+        free(cache->entries);
+        free(cache->directory);
+        free(cache);
+        return NULL;
+    }
+
+    if (directory != NULL)
+    {
+        strcpy(cache->directory, directory);
+    }
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+/**
+ * Copies the nearest solution to the problem (in memory, or in the directory)
+ * into 'grid' & sets the problem's sources into it.
+ * @param cache
+ * @param grid
+ * @param sources
+ * @param num_sources
+ * @param is_cyclic
+ * @return true if the grid was warm started, false if no solution is near (the grid is as it was).
+ */
+bool warmStart(solution_cache *cache, heat_grid *grid, const source_point *sources, const size_t num_sources,
+               const int is_cyclic)
+{
+    warm_problem problem;
+    if (!describeProblem(&problem, grid, sources, num_sources, is_cyclic))
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    size_t distance = 0;
+    cached_solution *nearest = findInMemory(cache, &problem, &distance);
+    cached_solution *loaded = (nearest == NULL || distance > 0) ? loadNearest(cache, &problem, distance, nearest != NULL)
+                                                               : NULL;
+    nearest = (loaded != NULL) ? loaded : nearest;
+    if (nearest != NULL)
+    {
+        nearest->lastUse = ++cache->uses;
+        for (size_t r = 0; r < grid->rows; ++r)
+        {
+            memcpy(heatGridRow(grid, r), heatGridRow(&nearest->grid, r), grid->columns * sizeof(double));
+        }
+        for (size_t i = 0; i < num_sources; ++i)
+        {
+            heatGridRow(grid, (size_t) sources[i].x)[sources[i].y] = sources[i].value;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    free(problem.sources);
+    return nearest != NULL;
+}
+
+/**
+ * Keeps 'grid' as the solution of the problem, in memory (replacing its previous
+ * one, or else the least recently used solution) & in the directory.
+ * @param cache
+ * @param grid
+ * @param sources
+ * @param num_sources
+ * @param is_cyclic
+ * @return true if kept, false if it could not be allocated or written into the directory.
+ */
+bool storeSolution(solution_cache *cache, const heat_grid *grid, const source_point *sources,
+                   const size_t num_sources, const int is_cyclic)
+{
+    warm_problem problem;
+    if (!describeProblem(&problem, grid, sources, num_sources, is_cyclic))
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    size_t distance = 0;
+    cached_solution *entry = findInMemory(cache, &problem, &distance);
+    bool isKept = true;
+    bool isTaken = false; // whether the entry took the problem's sources
+    if (entry == NULL || distance > 0)
+    {
+        heat_grid copy = {0};
+        isKept = createHeatGrid(&copy, grid->rows, grid->columns);
+        entry = isKept ? keepEntry(cache, &problem, &copy, problem.sources, problem.numOfSources, problem.hash) : NULL;
+        isTaken = isKept;
+    }
+    if (entry != NULL)
+    {
+        entry->lastUse = ++cache->uses;
+        for (size_t r = 0; r < grid->rows; ++r)
+        {
+            memcpy(heatGridRow(&entry->grid, r), heatGridRow(grid, r), grid->columns * sizeof(double));
+        }
+        isKept = (cache->directory == NULL) || writeSolution(cache, &problem, &entry->grid);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    if (!isTaken)
+    {
+        free(problem.sources);
+    }
+    return isKept;
+}
+
+/**
+ * Frees the cache (NULL is allowed); its files stay in the directory.
+ * @param cache
+ */
+void destroySolutionCache(solution_cache *cache)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    for (unsigned int i = 0; i < cache->capacity; ++i)
+    {
+        freeEntry(&cache->entries[i]);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->entries);
+    free(cache->directory);
+    free(cache);
+}
@@ -0,0 +1,64 @@
+/*
+ * warmstart.h
+ *
+ *  Created on: May 2, 2018
+ *      Author: OWNER
+ */
+
+#ifndef WARMSTART_H_
+#define WARMSTART_H_
+
+#include <stdbool.h>
+#include "calculator.h"
+#include "grid.h"
+
+/**
+ * A cache of converged grids, for starting a calculation until the precision
+ * from the solution of a problem close to it instead of from 0 heat. A solution
+ * is kept by its grid's size, its cyclic flag & a hash of its sources (their
+ * cells & values); a calculation starts from the nearest one of its size & flag -
+ * the one whose sources differ from its own in the fewest sources (moved, added,
+ * removed or of another value) - as long as they have a source in common.
+ *
+ * The cache holds up to 'capacity' solutions in memory (replacing the least
+ * recently used one), and given a directory, it keeps every solution in it too
+ * (as <rows>x<columns>-<cyclic>-<hash>.warm), so the next runs start from them.
+ * A file is a header (the size, the flag, the number of sources & their hash)
+ * followed by the sources & the cells, in the machine's byte order. A cache
+ * may be shared by the threads.
+ */
+typedef struct solution_cache solution_cache;
+
+/**
+ * The solutions a cache holds in memory by default.
+ */
+#define WARM_START_ENTRIES 8
+
+/**
+ * Creates a cache of up to 'capacity' solutions in memory, kept in 'directory'
+ * too unless it's NULL.
+ * @return the cache, or NULL if it could not be allocated or the directory opened.
+ */
+solution_cache *createSolutionCache(unsigned int capacity, const char *directory);
+
+/**
+ * Copies the nearest solution to the problem (see solution_cache) into 'grid' &
+ * sets the problem's sources into it.
+ * @return true if the grid was warm started, false if no solution is near (the grid is as it was).
+ */
+bool warmStart(solution_cache *cache, heat_grid *grid, const source_point *sources, size_t num_sources,
+		int is_cyclic);
+
+/**
+ * Keeps 'grid' as the solution of the problem (replacing its previous one).
+ * @return true if kept, false if it could not be allocated or written into the directory.
+ */
+bool storeSolution(solution_cache *cache, const heat_grid *grid, const source_point *sources,
+		size_t num_sources, int is_cyclic);
+
+/**
+ * Frees the cache (NULL is allowed); its files stay in the directory.
+ */
+void destroySolutionCache(solution_cache *cache);
+
+#endif /* WARMSTART_H_ */